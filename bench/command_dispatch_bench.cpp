@@ -0,0 +1,250 @@
+/**
+ * @file    command_dispatch_bench.cpp
+ * @brief   SmartIOManager控制指令分发的主机端对比测试
+ *
+ * @details 同一组控制指令分别走两种分发流程，输出每条指令从开始分发到写出输出电平/角度的平均耗时：
+ *          - 旧：遍历每个IO口，sprintf拼 "p%d"/"P%d"，containsKey各查一次，
+ *                值经 std::to_string/snprintf 转为 std::string 并打印两次，
+ *                再调用 callback(const char*) 重新解析
+ *          - 新：遍历一次指令对象，_portIndex按键换算IO口编号查表，按值类型调用setInt/setFloat/setBytes
+ *          两种流程对每条指令写出的输出必须相同。主机上没有ArduinoJson，指令对象以
+ *          (键, 值) 列表表示，containsKey与ArduinoJson对象一样线性查找；旧流程的两次printf
+ *          写到/dev/null，只计格式化开销，不含设备上串口发送的时间，设备上的差距更大。
+ *
+ *          编译运行（仓库根目录）：
+ *          g++ -O2 -std=c++17 bench/command_dispatch_bench.cpp -o /tmp/command_dispatch_bench && \
+ *              /tmp/command_dispatch_bench
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+#define IO_PORT_NUM 6
+#define ROUNDS 200000
+
+/** @brief 指令中的一个值，对应JSON中的整数、浮点数或字符串 */
+struct Value {
+  enum Type { INT, FLOAT, STR } type;
+  int32_t i;
+  float f;
+  const char *s;
+};
+
+struct Pair {
+  const char *key;
+  Value value;
+};
+
+typedef std::vector<Pair> Command;
+
+static const Pair *findKey(const Command &cmd, const char *key) {
+  for (const Pair &p : cmd) {
+    if (strcmp(p.key, key) == 0) {
+      return &p;
+    }
+  }
+  return nullptr;
+}
+
+static Value intValue(int32_t v) { return {Value::INT, v, 0, nullptr}; }
+static Value floatValue(float v) { return {Value::FLOAT, 0, v, nullptr}; }
+static Value strValue(const char *v) { return {Value::STR, 0, 0, v}; }
+
+enum HubKind { HUB_NONE, HUB_DIGITAL_OUT, HUB_SERVO180 };
+
+/** @brief 模拟IO口，output记录写出的电平或角度 */
+struct MockHub {
+  HubKind kind;
+  uint8_t ioIdx;
+  int output;
+
+  // 旧接口：字符串指令，解析同基线的DigitalOutIOHub/Servo180IOHub::callback
+  void callback(const char *arg) {
+    if (arg == nullptr) {
+      return;
+    }
+    if (kind == HUB_DIGITAL_OUT) {
+      char lowerVal[16];
+      strncpy(lowerVal, arg, sizeof(lowerVal) - 1);
+      lowerVal[sizeof(lowerVal) - 1] = '\0';
+      for (char *ch = lowerVal; *ch != '\0'; ch++) {
+        *ch = tolower(*ch);
+      }
+      if (strcmp(lowerVal, "on") == 0) {
+        output = 1;
+      } else if (strcmp(lowerVal, "off") == 0) {
+        output = 0;
+      } else {
+        output = atof(lowerVal) == 1.0f ? 1 : 0;
+      }
+    } else if (kind == HUB_SERVO180) {
+      output = std::min(std::max(atoi(arg), 0), 180);
+    }
+  }
+
+  // 新接口：类型化设置，同现在的DigitalOutIOHub/Servo180IOHub
+  bool setFloat(float value) {
+    if (kind == HUB_DIGITAL_OUT) {
+      output = value == 1.0f ? 1 : 0;
+    } else if (kind == HUB_SERVO180) {
+      output = std::min(std::max((int)value, 0), 180);
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  bool setInt(int32_t value) { return setFloat((float)value); }
+
+  bool setBytes(const char *data, size_t len) {
+    if (kind == HUB_DIGITAL_OUT) {
+      if (len == 2 && strncasecmp(data, "on", 2) == 0) {
+        output = 1;
+        return true;
+      } else if (len == 3 && strncasecmp(data, "off", 3) == 0) {
+        output = 0;
+        return true;
+      }
+      return setFloat(atof(data));
+    } else if (kind == HUB_SERVO180) {
+      return setFloat((float)atoi(data));
+    }
+    return false;
+  }
+};
+
+/** @brief 旧流程：SmartIOManager::_handleMQTTMessage 改动前的逻辑 */
+static void dispatchOld(std::vector<MockHub> &iohubs, const Command &doc, FILE *log) {
+  for (auto &iohub : iohubs) {
+    char key[8];
+    uint8_t io_idx = iohub.ioIdx;
+    sprintf(key, "p%d", io_idx);
+    if (findKey(doc, key) == nullptr) {
+      sprintf(key, "P%d", io_idx);
+      if (findKey(doc, key) == nullptr) {
+        continue;
+      }
+    }
+    const Value &value = findKey(doc, key)->value;
+    std::string valueStr;
+    if (value.type == Value::STR) {
+      fprintf(log, "tests %s\n", value.s);
+      valueStr = value.s;
+    } else if (value.type == Value::INT) {
+      fprintf(log, "tests %d\n", value.i);
+      valueStr = std::to_string(value.i);
+    } else {
+      fprintf(log, "tests %f\n", (double)value.f);
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.2f", (double)findKey(doc, key)->value.f);
+      valueStr = buf;
+    }
+    const char *valCStr = valueStr.c_str();
+    fprintf(log, "str: %s\n", valCStr);
+    switch (iohub.kind) {
+    case HUB_SERVO180:
+    case HUB_DIGITAL_OUT:
+      iohub.callback(valCStr);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/** @brief 同SmartIOManager::_portIndex */
+static int portIndex(const char *key) {
+  if ((key[0] != 'p' && key[0] != 'P') || key[1] < '1' || key[1] > '0' + IO_PORT_NUM || key[2] != '\0') {
+    return -1;
+  }
+  return key[1] - '0';
+}
+
+/** @brief 新流程：一次遍历，键换算IO口编号查表，按类型调用设置接口 */
+static void dispatchNew(MockHub *const *ports, const Command &doc) {
+  for (const Pair &kv : doc) {
+    int io_idx = portIndex(kv.key);
+    if (io_idx < 0 || ports[io_idx] == nullptr) {
+      continue;
+    }
+    MockHub *iohub = ports[io_idx];
+    if (kv.value.type == Value::INT) {
+      iohub->setInt(kv.value.i);
+    } else if (kv.value.type == Value::FLOAT) {
+      iohub->setFloat(kv.value.f);
+    } else {
+      iohub->setBytes(kv.value.s, strlen(kv.value.s));
+    }
+  }
+}
+
+static std::vector<MockHub> makeHubs() {
+  const HubKind kinds[IO_PORT_NUM] = {HUB_DIGITAL_OUT, HUB_DIGITAL_OUT, HUB_SERVO180,
+                                      HUB_SERVO180,    HUB_NONE,        HUB_DIGITAL_OUT};
+  std::vector<MockHub> hubs;
+  for (uint8_t i = 0; i < IO_PORT_NUM; i++) {
+    hubs.push_back({kinds[i], (uint8_t)(i + 1), -1});
+  }
+  return hubs;
+}
+
+static std::vector<Command> makeCommands() {
+  return {
+      {{"p1", intValue(1)}},
+      {{"P2", strValue("on")}},
+      {{"p3", intValue(90)}},
+      {{"p4", floatValue(45.5f)}},
+      {{"p1", intValue(0)}, {"p3", intValue(120)}},
+      {{"p6", strValue("OFF")}},
+      {{"p2", floatValue(1.0f)}, {"P4", strValue("200")}},
+      {{"temp", intValue(1)}, {"p5", intValue(1)}, {"p6", strValue("1")}},
+  };
+}
+
+int main() {
+  std::vector<Command> commands = makeCommands();
+  std::vector<MockHub> oldHubs = makeHubs();
+  std::vector<MockHub> newHubs = makeHubs();
+  MockHub *ports[IO_PORT_NUM + 1] = {nullptr};
+  for (MockHub &hub : newHubs) {
+    ports[hub.ioIdx] = &hub;
+  }
+  FILE *log = fopen("/dev/null", "w");
+  if (log == nullptr) {
+    return 1;
+  }
+
+  for (size_t c = 0; c < commands.size(); c++) {
+    dispatchOld(oldHubs, commands[c], log);
+    dispatchNew(ports, commands[c]);
+    for (int i = 0; i < IO_PORT_NUM; i++) {
+      if (oldHubs[i].output != newHubs[i].output) {
+        printf("mismatch command %zu p%d: old %d, new %d\n", c, i + 1, oldHubs[i].output, newHubs[i].output);
+        return 1;
+      }
+    }
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUNDS; i++) {
+    dispatchOld(oldHubs, commands[i % commands.size()], log);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUNDS; i++) {
+    dispatchNew(ports, commands[i % commands.size()]);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  fclose(log);
+
+  double oldNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / ROUNDS;
+  double newNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / ROUNDS;
+  printf("%zu commands, %d ports, outputs identical\n", commands.size(), IO_PORT_NUM);
+  printf("old dispatch: %7.1f ns/command\n", oldNs);
+  printf("new dispatch: %7.1f ns/command\n", newNs);
+  return 0;
+}
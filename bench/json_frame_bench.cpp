@@ -0,0 +1,87 @@
+/**
+ * @file    json_frame_bench.cpp
+ * @brief   JsonFrame浮点字段与snprintf的主机端对比测试
+ *
+ * @details 1. 正确性：随机生成各数量级的单精度值（含恰好一半的舍入边界，如0.125、2.5），
+ *             按0~6位小数分别用JsonFrame::real和snprintf("%.*f")格式化，输出必须逐字节相同
+ *          2. 速度：同一组数值分别用两种方式格式化，输出每个字段的平均耗时
+ *          主机上的snprintf走glibc，设备上为newlib的双精度软件浮点，速度差距在设备上更大。
+ *
+ *          编译运行（仓库根目录）：
+ *          g++ -O2 -std=c++17 -Ilib/I2cHUB bench/json_frame_bench.cpp lib/I2cHUB/JsonFrame.cpp \
+ *              -o /tmp/json_frame_bench && /tmp/json_frame_bench
+ */
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "JsonFrame.h"
+
+#define VALUE_COUNT 200000
+
+static std::vector<float> makeValues() {
+  std::mt19937 rng(12345);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_int_distribution<int> exp10(-4, 8);
+  std::uniform_int_distribution<int> half(-4000, 4000);
+  std::vector<float> values;
+  for (int i = 0; i < VALUE_COUNT; i++) {
+    switch (i % 4) {
+    case 0:
+      // 恰好落在舍入边界上的二进制小数
+      values.push_back(half(rng) / 8.0f);
+      break;
+    case 1:
+      values.push_back(unit(rng) * 100.0f);
+      break;
+    default: {
+      float scale = 1.0f;
+      for (int e = exp10(rng); e > 0; e--) {
+        scale *= 10.0f;
+      }
+      for (int e = exp10(rng); e < 0; e++) {
+        scale /= 10.0f;
+      }
+      values.push_back(unit(rng) * scale);
+    }
+    }
+  }
+  return values;
+}
+
+int main() {
+  std::vector<float> values = makeValues();
+  char a[64], b[64];
+  size_t mismatches = 0;
+  for (uint8_t d = 0; d <= JSON_FRAME_MAX_DECIMALS; d++) {
+    for (float v : values) {
+      JsonFrame f(a, sizeof(a));
+      f.real(JSON_KEY("v"), v, d);
+      snprintf(b, sizeof(b), "\"v\":%.*f", d, (double)v);
+      if (strcmp(a, b) != 0 && mismatches++ < 10) {
+        printf("mismatch %.9g d=%u: %s vs %s\n", (double)v, d, a, b);
+      }
+    }
+  }
+  printf("checked %zu values x %d decimals, %zu mismatches\n", values.size(), JSON_FRAME_MAX_DECIMALS + 1,
+         mismatches);
+
+  volatile size_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (float v : values) {
+    JsonFrame f(a, sizeof(a));
+    f.real(JSON_KEY("Temperature"), v, 2);
+    sink += f.size();
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (float v : values) {
+    sink += snprintf(b, sizeof(b), "\"Temperature\":%.2f", (double)v);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+
+  double frameNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / values.size();
+  double printfNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / values.size();
+  printf("JsonFrame::real: %6.1f ns/field\n", frameNs);
+  printf("snprintf:        %6.1f ns/field\n", printfNs);
+  return mismatches != 0;
+}
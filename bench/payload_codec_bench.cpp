@@ -0,0 +1,239 @@
+/**
+ * @file    payload_codec_bench.cpp
+ * @brief   JSON / MessagePack / CBOR 负载大小与编码速度的主机端对比测试
+ *
+ * @details 同一帧传感器数据（BMX160三轴 + BME280 + VEML7700 + IO口字段 + 时间戳）分别编码为：
+ *          - JSON：与设备相同，字段片段由JsonFrame写入（保留2位小数），外加花括号和ts
+ *          - MessagePack / CBOR：PayloadWriter写入 {字段ID: 值}，字段ID由PayloadFieldIndex
+ *            按设备使用的同一份字段表查找，嵌套路径在栈上拼接，数值规则同PayloadCodec::_writeValue
+ *          输出每种格式的帧长度、每帧耗时和吞吐。主机上没有ArduinoJson，不含ArduinoJson
+ *          解析/遍历文档的开销，只比较编码本身。
+ *
+ *          编译运行（仓库根目录）：
+ *          g++ -O2 -std=c++17 -Ilib/PayloadCodec -Ilib/I2cHUB bench/payload_codec_bench.cpp \
+ *              lib/PayloadCodec/PayloadWriter.cpp lib/PayloadCodec/PayloadFields.cpp lib/I2cHUB/JsonFrame.cpp \
+ *              -o /tmp/payload_codec_bench && /tmp/payload_codec_bench
+ */
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "JsonFrame.h"
+#include "PayloadFields.h"
+#include "PayloadWriter.h"
+
+#define FRAME_COUNT 256
+#define ROUNDS 200000
+#define PATH_MAX_LEN 64
+#define NESTED_OBJECTS 3
+
+/** @brief 一帧传感器数据 */
+struct Reading {
+  float mag[3], gyr[3], acc[3];
+  float temperature, pressure, humidity, altitude, lux;
+  int32_t input;
+  float dht11Temp, dht11Humi, dht22Temp, dht22Humi;
+  int32_t bpm;
+  uint64_t ts;
+};
+
+/** @brief 二进制编码的一个叶子字段：键链与值 */
+struct Leaf {
+  const char *keys[2];
+  const float *real;
+  const int32_t *sint;
+  const uint64_t *u64;
+};
+
+static float round2(float v) { return (float)(int32_t)(v * 100.0f) / 100.0f; }
+
+static std::vector<Reading> makeReadings() {
+  std::mt19937 rng(12345);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<Reading> readings(FRAME_COUNT);
+  uint64_t ts = 1760000000000ull;
+  for (Reading &r : readings) {
+    for (int i = 0; i < 3; i++) {
+      r.mag[i] = round2(unit(rng) * 60.0f);
+      r.gyr[i] = round2(unit(rng) * 250.0f);
+      r.acc[i] = round2(unit(rng) * 2.0f);
+    }
+    r.temperature = round2(25.0f + unit(rng) * 5.0f);
+    r.pressure = round2(101325.0f + unit(rng) * 500.0f);
+    r.humidity = round2(45.0f + unit(rng) * 10.0f);
+    r.altitude = round2(40.0f + unit(rng) * 5.0f);
+    r.lux = round2(300.0f + unit(rng) * 200.0f);
+    r.input = unit(rng) > 0 ? 1 : 0;
+    r.dht11Temp = (float)(int32_t)(24.0f + unit(rng) * 3.0f);
+    r.dht11Humi = (float)(int32_t)(50.0f + unit(rng) * 10.0f);
+    r.dht22Temp = round2(24.0f + unit(rng) * 3.0f);
+    r.dht22Humi = round2(50.0f + unit(rng) * 10.0f);
+    r.bpm = 70 + (int32_t)(unit(rng) * 10.0f);
+    r.ts = ts;
+    ts += 100;
+  }
+  return readings;
+}
+
+static std::vector<Leaf> makeLeaves(const Reading &r) {
+  std::vector<Leaf> leaves;
+  const char *axes[] = {"x", "y", "z"};
+  for (int i = 0; i < 3; i++) {
+    leaves.push_back({{"mag", axes[i]}, &r.mag[i], nullptr, nullptr});
+  }
+  for (int i = 0; i < 3; i++) {
+    leaves.push_back({{"gyr", axes[i]}, &r.gyr[i], nullptr, nullptr});
+  }
+  for (int i = 0; i < 3; i++) {
+    leaves.push_back({{"acc", axes[i]}, &r.acc[i], nullptr, nullptr});
+  }
+  leaves.push_back({{"Temperature"}, &r.temperature, nullptr, nullptr});
+  leaves.push_back({{"Pressure"}, &r.pressure, nullptr, nullptr});
+  leaves.push_back({{"Humidity"}, &r.humidity, nullptr, nullptr});
+  leaves.push_back({{"Altitude"}, &r.altitude, nullptr, nullptr});
+  leaves.push_back({{"Lux"}, &r.lux, nullptr, nullptr});
+  leaves.push_back({{"p1_input_val"}, nullptr, &r.input, nullptr});
+  leaves.push_back({{"p2_dht11_temp"}, &r.dht11Temp, nullptr, nullptr});
+  leaves.push_back({{"p2_dht11_humi"}, &r.dht11Humi, nullptr, nullptr});
+  leaves.push_back({{"p3_dht22_temp"}, &r.dht22Temp, nullptr, nullptr});
+  leaves.push_back({{"p3_dht22_humi"}, &r.dht22Humi, nullptr, nullptr});
+  leaves.push_back({{"p4_hr_bpm"}, nullptr, &r.bpm, nullptr});
+  leaves.push_back({{"ts"}, nullptr, nullptr, &r.ts});
+  return leaves;
+}
+
+/** @brief 设备上的JSON帧：JsonFrame写字段片段，外加花括号和毫秒时间戳 */
+static size_t encodeJson(const Reading &r, char *buf, size_t cap) {
+  buf[0] = '{';
+  JsonFrame f(buf + 1, cap - 1);
+  f.open(JSON_KEY("mag"));
+  f.real(JSON_KEY("x"), r.mag[0], 2);
+  f.real(JSON_KEY("y"), r.mag[1], 2);
+  f.real(JSON_KEY("z"), r.mag[2], 2);
+  f.close();
+  f.open(JSON_KEY("gyr"));
+  f.real(JSON_KEY("x"), r.gyr[0], 2);
+  f.real(JSON_KEY("y"), r.gyr[1], 2);
+  f.real(JSON_KEY("z"), r.gyr[2], 2);
+  f.close();
+  f.open(JSON_KEY("acc"));
+  f.real(JSON_KEY("x"), r.acc[0], 2);
+  f.real(JSON_KEY("y"), r.acc[1], 2);
+  f.real(JSON_KEY("z"), r.acc[2], 2);
+  f.close();
+  f.real(JSON_KEY("Temperature"), r.temperature, 2);
+  f.real(JSON_KEY("Pressure"), r.pressure, 2);
+  f.real(JSON_KEY("Humidity"), r.humidity, 2);
+  f.real(JSON_KEY("Altitude"), r.altitude, 2);
+  f.real(JSON_KEY("Lux"), r.lux, 2);
+  f.num(JSON_KEY("p1_input_val"), r.input);
+  f.real(JSON_KEY("p2_dht11_temp"), r.dht11Temp, 2);
+  f.real(JSON_KEY("p2_dht11_humi"), r.dht11Humi, 2);
+  f.real(JSON_KEY("p3_dht22_temp"), r.dht22Temp, 2);
+  f.real(JSON_KEY("p3_dht22_humi"), r.dht22Humi, 2);
+  f.num(JSON_KEY("p4_hr_bpm"), r.bpm);
+  if (f.overflow()) {
+    return 0;
+  }
+  size_t len = 1 + f.size();
+  int n = snprintf(buf + len, cap - len, ",\"ts\":%llu}", (unsigned long long)r.ts);
+  return n > 0 && (size_t)n < cap - len ? len + n : 0;
+}
+
+/** @brief {字段ID: 值} 映射，路径拼接与数值规则同PayloadCodec */
+static size_t encodeBinary(const PayloadFieldIndex &index, const std::vector<Leaf> &leaves, PayloadFormat format,
+                           uint8_t *buf, size_t cap) {
+  PayloadWriter w(buf, cap, format);
+  char path[PATH_MAX_LEN];
+  w.map(leaves.size());
+  for (const Leaf &leaf : leaves) {
+    size_t n = 0;
+    for (const char *k : leaf.keys) {
+      if (k == nullptr) {
+        break;
+      }
+      if (n > 0 && n < PATH_MAX_LEN - 1) {
+        path[n++] = '.';
+      }
+      while (*k && n < PATH_MAX_LEN - 1) {
+        path[n++] = *k++;
+      }
+    }
+    path[n] = '\0';
+    w.uint(index.find(path));
+    if (leaf.u64 != nullptr) {
+      w.uint64(*leaf.u64);
+    } else if (leaf.sint != nullptr) {
+      w.sint(*leaf.sint);
+    } else if (*leaf.real == (float)(int32_t)*leaf.real) {
+      w.sint((int32_t)*leaf.real);
+    } else {
+      w.real(*leaf.real);
+    }
+  }
+  return w.overflow() ? 0 : w.size();
+}
+
+int main() {
+  std::vector<Reading> readings = makeReadings();
+  std::vector<std::vector<Leaf>> frames;
+  for (const Reading &r : readings) {
+    frames.push_back(makeLeaves(r));
+  }
+  PayloadFieldIndex index;
+  static char json[1024];
+  static uint8_t bin[1024];
+
+  // 帧中的字段都在固定表内，且JSON与二进制编码的字段数相同
+  for (const Leaf &leaf : frames[0]) {
+    char path[PATH_MAX_LEN];
+    snprintf(path, sizeof(path), leaf.keys[1] ? "%s.%s" : "%s", leaf.keys[0], leaf.keys[1]);
+    if (index.find(path) == 0) {
+      printf("field not in table: %s\n", path);
+      return 1;
+    }
+  }
+  size_t jsonLen = encodeJson(readings[0], json, sizeof(json));
+  size_t quotes = 0;
+  for (size_t i = 0; i < jsonLen; i++) {
+    quotes += json[i] == '"';
+  }
+  if (jsonLen == 0 || quotes / 2 != frames[0].size() + NESTED_OBJECTS) {
+    printf("json frame mismatch: %zu keys for %zu fields\n", quotes / 2, frames[0].size());
+    return 1;
+  }
+
+  struct Result {
+    const char *name;
+    size_t bytes;
+    double ns;
+  } results[3] = {{"json", 0, 0}, {"msgpack", 0, 0}, {"cbor", 0, 0}};
+  const PayloadFormat formats[3] = {PAYLOAD_JSON, PAYLOAD_MSGPACK, PAYLOAD_CBOR};
+
+  volatile size_t sink = 0;
+  for (int f = 0; f < 3; f++) {
+    size_t total = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+      size_t k = i % FRAME_COUNT;
+      size_t len = formats[f] == PAYLOAD_JSON ? encodeJson(readings[k], json, sizeof(json))
+                                              : encodeBinary(index, frames[k], formats[f], bin, sizeof(bin));
+      if (len == 0) {
+        printf("%s: encode failed\n", results[f].name);
+        return 1;
+      }
+      total += len;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    sink += total;
+    results[f].bytes = total / ROUNDS;
+    results[f].ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / ROUNDS;
+  }
+
+  printf("frame: %zu fields, %d rounds\n", frames[0].size(), ROUNDS);
+  for (const Result &r : results) {
+    printf("%-8s %4zu bytes/frame (%3.0f%% of json)  %7.1f ns/frame  %7.2f MB/s\n", r.name, r.bytes,
+           100.0 * r.bytes / results[0].bytes, r.ns, r.bytes / r.ns * 1e3);
+  }
+  return sink == 0;
+}
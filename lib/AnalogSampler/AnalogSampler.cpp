@@ -0,0 +1,268 @@
+/**
+ * @file    AnalogSampler.cpp
+ * @brief   ADC连续采样（DMA）模块实现
+ */
+#include "AnalogSampler.h"
+
+AnalogSampler analogSampler;
+
+AnalogSampler::AnalogSampler()
+    : overruns(0), _count(0), _rate(ANALOG_RATE_DEFAULT), _configRate(ANALOG_RATE_DEFAULT), _running(false),
+      _task(NULL), _lock(NULL) {
+  _mux = portMUX_INITIALIZER_UNLOCKED;
+  memset(_slotOf, -1, sizeof(_slotOf));
+}
+
+/**
+ * @brief 从配置键值对读取采样率
+ */
+void AnalogSampler::config(KeyValue *kv_pairs, int count) {
+  const char *rate = get_value_case_insensitive(kv_pairs, count, "ADC_Rate");
+  _configRate = ANALOG_RATE_DEFAULT;
+  if (rate != NULL && atoi(rate) > 0) {
+    _configRate = atoi(rate);
+  }
+  _rate = _configRate;
+}
+
+AnalogFilter AnalogSampler::parseFilter(const char *name) {
+  if (name == NULL) {
+    return ANALOG_AVG;
+  }
+  if (strcasecmp(name, "min") == 0) {
+    return ANALOG_MIN;
+  }
+  if (strcasecmp(name, "max") == 0) {
+    return ANALOG_MAX;
+  }
+  if (strcasecmp(name, "rms") == 0) {
+    return ANALOG_RMS;
+  }
+  if (strcasecmp(name, "fir") == 0) {
+    printf("[Info]Filter fir removed, use avg\n");
+    return ANALOG_AVG;
+  }
+  if (strcasecmp(name, "raw") == 0) {
+    return ANALOG_RAW;
+  }
+  return ANALOG_AVG;
+}
+
+void AnalogSampler::reset() {
+  if (_lock == NULL) {
+    _lock = xSemaphoreCreateMutex();
+  }
+  // 读取任务在持锁期间最多阻塞ANALOG_READ_TIMEOUT_MS
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  if (_running) {
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    _running = false;
+  }
+  _count = 0;
+  _rate = _configRate;
+  memset(_slotOf, -1, sizeof(_slotOf));
+  xSemaphoreGive(_lock);
+}
+
+int AnalogSampler::add(uint8_t pin, AnalogFilter filter) {
+  int channel = digitalPinToAnalogChannel(pin);
+  // ADC2通道号从SOC_ADC_MAX_CHANNEL_NUM开始
+  if (channel < 0 || channel >= SOC_ADC_MAX_CHANNEL_NUM || _count >= ANALOG_MAX_SLOTS || _running) {
+    return -1;
+  }
+  if (_slotOf[channel] >= 0) {
+    return _slotOf[channel];
+  }
+  Slot &slot = _slots[_count];
+  memset(&slot, 0, sizeof(slot));
+  slot.channel = (uint8_t)channel;
+  slot.filter = filter;
+  slot.min = 0xFFFF;
+  _slotOf[channel] = _count;
+  return _count++;
+}
+
+int AnalogSampler::addStream(uint8_t pin, uint32_t rate, AnalogSink sink, void *ctx) {
+  int idx = add(pin, ANALOG_AVG);
+  if (idx < 0) {
+    return -1;
+  }
+  if (rate != 0 && rate != _rate) {
+    printf("[Info]ADC DMA: rate %u Hz required by GPIO%u\n", (unsigned)rate, pin);
+    _rate = rate;
+  }
+  _slots[idx].sink = sink;
+  _slots[idx].ctx = ctx;
+  return idx;
+}
+
+/**
+ * @brief 启动DMA采样
+ *
+ * @details 所有登记的ADC1通道组成一个转换序列，序列频率为 ADC_Rate × 通道数，
+ *          按芯片支持的范围限幅。读取任务只创建一次，停止期间阻塞等待通知。
+ */
+void AnalogSampler::begin() {
+  if (_count == 0 || _running) {
+    return;
+  }
+  uint32_t mask = 0;
+  adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {};
+  for (int i = 0; i < _count; i++) {
+    mask |= 1u << _slots[i].channel;
+    pattern[i].atten = ADC_ATTEN_DB_11;
+    pattern[i].channel = _slots[i].channel;
+    pattern[i].unit = 0;
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = ANALOG_READ_LEN * 8;
+  init.conv_num_each_intr = ANALOG_READ_LEN;
+  init.adc1_chan_mask = mask;
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    printf("[Error]ADC DMA init failed\n");
+    return;
+  }
+
+  uint32_t freq = _rate * _count;
+  if (freq < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+    freq = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+  } else if (freq > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+    freq = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+  }
+  adc_digi_configuration_t dig = {};
+  dig.conv_limit_en = false;
+  dig.conv_limit_num = 250;
+  dig.pattern_num = _count;
+  dig.adc_pattern = pattern;
+  dig.sample_freq_hz = freq;
+  dig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  dig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  _rate = freq / _count;
+  if (adc_digi_controller_configure(&dig) != ESP_OK || adc_digi_start() != ESP_OK) {
+    printf("[Error]ADC DMA start failed\n");
+    adc_digi_deinitialize();
+    return;
+  }
+  _running = true;
+  printf("[Info]ADC DMA: %u channels at %u Hz each\n", _count, (unsigned)_rate);
+
+  if (_task == NULL) {
+    xTaskCreate(_reader, "adc", 3072, this, 4, &_task);
+  } else {
+    xTaskNotifyGive(_task);
+  }
+}
+
+/**
+ * @brief 累加一批转换结果，样本流在临界区外交给回调
+ */
+void AnalogSampler::_feed(const uint8_t *buf, uint32_t len) {
+  memset(_blockLen, 0, sizeof(_blockLen));
+  portENTER_CRITICAL(&_mux);
+  for (uint32_t i = 0; i + ANALOG_RESULT_BYTES <= len; i += ANALOG_RESULT_BYTES) {
+    const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&buf[i];
+    if (p->type2.unit != 0 || p->type2.channel >= SOC_ADC_MAX_CHANNEL_NUM) {
+      continue;
+    }
+    int8_t idx = _slotOf[p->type2.channel];
+    if (idx < 0) {
+      continue;
+    }
+    Slot &slot = _slots[idx];
+    uint16_t v = p->type2.data;
+    slot.count++;
+    slot.sum += v;
+    slot.sumSq += (uint32_t)v * v;
+    if (v < slot.min) {
+      slot.min = v;
+    }
+    if (v > slot.max) {
+      slot.max = v;
+    }
+    slot.last = v;
+    if (slot.sink != NULL && _blockLen[idx] < ANALOG_BLOCK_MAX) {
+      _block[idx][_blockLen[idx]++] = v;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+  for (int i = 0; i < _count; i++) {
+    if (_blockLen[i] > 0) {
+      _slots[i].sink(_slots[i].ctx, _block[i], _blockLen[i]);
+    }
+  }
+}
+
+void AnalogSampler::_reader(void *arg) {
+  AnalogSampler *self = (AnalogSampler *)arg;
+  static uint8_t buf[ANALOG_READ_LEN];
+  while (1) {
+    if (!self->_running) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    xSemaphoreTake(self->_lock, portMAX_DELAY);
+    if (self->_running) {
+      uint32_t len = 0;
+      esp_err_t ret = adc_digi_read_bytes(buf, sizeof(buf), &len, ANALOG_READ_TIMEOUT_MS);
+      // INVALID_STATE表示驱动缓冲区曾经写满，数据仍然有效
+      if (ret == ESP_ERR_INVALID_STATE) {
+        self->overruns++;
+        ret = ESP_OK;
+      }
+      if (ret == ESP_OK) {
+        self->_feed(buf, len);
+      }
+    }
+    xSemaphoreGive(self->_lock);
+  }
+}
+
+/**
+ * @brief 取出本周期的结果并清空统计
+ *
+ * @details 临界区内只复制统计量，均方根在临界区外计算
+ */
+bool AnalogSampler::take(int slot, float *value) {
+  if (slot < 0 || slot >= _count) {
+    return false;
+  }
+  Slot &s = _slots[slot];
+  portENTER_CRITICAL(&_mux);
+  uint32_t count = s.count;
+  uint32_t sum = s.sum;
+  uint64_t sumSq = s.sumSq;
+  uint16_t min = s.min, max = s.max;
+  uint16_t last = s.last;
+  s.count = 0;
+  s.sum = 0;
+  s.sumSq = 0;
+  s.min = 0xFFFF;
+  s.max = 0;
+  portEXIT_CRITICAL(&_mux);
+
+  if (count == 0) {
+    return false;
+  }
+  switch (s.filter) {
+  case ANALOG_MIN:
+    *value = min;
+    break;
+  case ANALOG_MAX:
+    *value = max;
+    break;
+  case ANALOG_RMS:
+    *value = sqrtf((float)((double)sumSq / count));
+    break;
+  case ANALOG_RAW:
+    *value = last;
+    break;
+  default:
+    *value = (float)sum / count;
+    break;
+  }
+  return true;
+}
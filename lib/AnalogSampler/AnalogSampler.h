@@ -0,0 +1,136 @@
+/**
+ * @file    AnalogSampler.h
+ * @brief   ADC连续采样（DMA）模块头文件
+ *
+ * @details 配置为input的IO口中属于ADC1的引脚由ADC数字控制器以DMA方式按ADC_Rate连续采样，
+ *          读取任务把每批转换结果累加到各IO口的统计量，
+ *          传感器任务每个采集周期取一次结果（同时清空统计），得到该周期内的：
+ *          - avg：平均值（默认）。周期内全部样本等权平均后每周期输出一个值，即积分清零式的
+ *            降采样，频率响应为sinc，在上报频率的整数倍处为零点，是高于上报频率一半的
+ *            干扰（如工频）的抗混叠选项
+ *          - min / max：最小 / 最大值
+ *          - rms：均方根
+ *          - raw：最新一个样本，不做抗混叠
+ *          不提供对最近若干样本做FIR再取一个点的方式：只对采集时刻前的一小段样本滤波，
+ *          截止频率远高于上报频率的一半，并不能抗混叠。
+ *          需要逐个样本的IO口（如EMG）以addStream()登记，读取任务每批把该口的样本
+ *          连续交给回调处理，回调在读取任务中执行，不能阻塞。
+ *          不属于ADC1的引脚（ADC2不能与WiFi同时连续采样）仍使用analogRead。
+ *          配置项（config.txt）：
+ *          - ADC_Rate: 每个IO口的采样率（Hz），默认1000
+ *          - P<n>_Filter: avg | min | max | rms | raw，默认avg（原fir按avg处理）
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "driver/adc.h"
+
+#define ANALOG_RATE_DEFAULT 1000 ///< 默认每路采样率（Hz）
+#define ANALOG_READ_LEN 256      ///< 每次从DMA读取的字节数
+#define ANALOG_RESULT_BYTES 4    ///< TYPE2格式每个转换结果的字节数
+#define ANALOG_READ_TIMEOUT_MS 100 ///< 单次读取等待时间，也是reset()的最长等待时间
+#define ANALOG_MAX_SLOTS IO_PORT_NUM
+#define ANALOG_BLOCK_MAX (ANALOG_READ_LEN / ANALOG_RESULT_BYTES) ///< 每批最多样本数
+
+/**
+ * @brief 样本流回调
+ * @param ctx 登记时传入的上下文
+ * @param samples 本批该通道的原始样本（0~4095），按时间顺序
+ * @param count 样本数
+ */
+typedef void (*AnalogSink)(void *ctx, const uint16_t *samples, size_t count);
+
+typedef enum {
+    ANALOG_AVG,
+    ANALOG_MIN,
+    ANALOG_MAX,
+    ANALOG_RMS,
+    ANALOG_RAW,
+} AnalogFilter;
+
+class AnalogSampler {
+public:
+    AnalogSampler();
+
+    /**
+     * @brief 从配置键值对读取采样率
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /**
+     * @brief 停止采样并清空已登记的引脚，重新配置IO口前调用
+     */
+    void reset();
+
+    /**
+     * @brief 登记一个引脚
+     * @param pin GPIO编号
+     * @param filter 取值方式
+     * @return int 槽号，引脚不属于ADC1或槽已满时返回-1（调用者继续用analogRead）
+     */
+    int add(uint8_t pin, AnalogFilter filter);
+
+    /**
+     * @brief 登记一个需要逐个样本的引脚
+     * @param pin GPIO编号
+     * @param rate 要求的采样率（Hz），非0时覆盖ADC_Rate，所有通道共用同一采样率
+     * @param sink 样本回调
+     * @param ctx 回调上下文
+     * @return int 槽号，失败时返回-1
+     */
+    int addStream(uint8_t pin, uint32_t rate, AnalogSink sink, void *ctx);
+
+    /** @brief 每个通道的采样率（Hz），begin()后为限幅后的实际值 */
+    uint32_t rate() const { return _rate; }
+
+    /**
+     * @brief 启动DMA采样和读取任务，没有登记引脚时不启动
+     */
+    void begin();
+
+    /**
+     * @brief 取出本周期的结果并清空统计
+     * @param slot add()返回的槽号
+     * @param value 输出：原始值（0~4095）按滤波方式计算的结果
+     * @return false 本周期没有新样本，调用者保留上一次的值
+     */
+    bool take(int slot, float *value);
+
+    /**
+     * @brief 从字符串解析滤波方式，无法识别时返回avg
+     */
+    static AnalogFilter parseFilter(const char *name);
+
+    uint32_t overruns; ///< DMA缓冲区溢出次数（读取任务来不及处理）
+
+private:
+    struct Slot {
+        uint8_t channel;
+        AnalogFilter filter;
+        uint32_t count;
+        uint32_t sum;
+        uint64_t sumSq;
+        uint16_t min;
+        uint16_t max;
+        uint16_t last;
+        AnalogSink sink;
+        void *ctx;
+    };
+
+    Slot _slots[ANALOG_MAX_SLOTS];
+    int8_t _slotOf[SOC_ADC_MAX_CHANNEL_NUM]; // ADC1通道号到槽号
+    uint8_t _count;
+    uint32_t _rate;
+    uint32_t _configRate;
+    uint16_t _block[ANALOG_MAX_SLOTS][ANALOG_BLOCK_MAX]; // 读取任务分发给回调的样本
+    uint8_t _blockLen[ANALOG_MAX_SLOTS];
+    bool _running;
+    TaskHandle_t _task;
+    SemaphoreHandle_t _lock; // 串行化DMA读取与停止
+    portMUX_TYPE _mux;       // 保护槽内统计量
+
+    void _feed(const uint8_t *buf, uint32_t len);
+    static void _reader(void *arg);
+};
+
+extern AnalogSampler analogSampler;
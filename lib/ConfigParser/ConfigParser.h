@@ -16,11 +16,11 @@
 
 // 配置解析器参数定义
  ///< 最大键值对数量（可根据需求调整）
-#define MAX_ENTRIES 10     
+#define MAX_ENTRIES 40     
  ///< 键的最大长度（含终止符）
 #define MAX_KEY_LEN 30  
  ///< 值的最大长度（含终止符）    
-#define MAX_VALUE_LEN 30    
+#define MAX_VALUE_LEN 64    
 
 /**
  * @brief 键值对结构体
@@ -33,6 +33,14 @@ typedef struct {
     char value[MAX_VALUE_LEN];///< 配置项的值
 } KeyValue;
 
+/**
+ * @brief 去除字符串前后空格（原地修改）
+ * 
+ * @param str 待处理的字符串指针
+ * @return char* 处理后的字符串指针
+ */
+char *trim(char *str);
+
 /**
  * @brief 解析键值对字符串
  * 
@@ -13,16 +13,20 @@
  */
 #include "DFRobot_Heartrate.h"
 
-uint16_t value[SAMPLE_NUMBER]={0};   // Initialize sampling point value
-
 uint16_t DFRobot_Heartrate::getValue(uint8_t pin)
+{
+    addValue(analogRead(pin), millis());
+    return(value_[valueCount_]);
+}
+
+void DFRobot_Heartrate::addValue(uint16_t sample, uint32_t timeMs)
 {
     valueCount_++;
     if(valueCount_ >= SAMPLE_NUMBER){
         valueCount_ = 0;
     }
-    value[valueCount_] = analogRead(pin);
-    return(value[valueCount_]);
+    value_[valueCount_] = sample;
+    sampleTim_ = timeMs;
 }
 
 uint8_t DFRobot_Heartrate::getCnt(void)
@@ -44,7 +48,7 @@ char DFRobot_Heartrate::maxNumber(uint8_t count)
         }else{
             temp2 = (count-1)-i;
         }
-        if(value[temp1]<=value[temp2])return(0);
+        if(value_[temp1]<=value_[temp2])return(0);
     }
     if(valueFlag){
         valueFlag=1;
@@ -69,34 +73,32 @@ void DFRobot_Heartrate::minNumber(uint8_t count)
         }else{
             temp2 = (count-1)-i;
         }
-        if(value[temp1]>=value[temp2])return;
+        if(value_[temp1]>=value_[temp2])return;
     }
     valueFlag = 0;   // Continuous decrease
 }
 
 uint16_t DFRobot_Heartrate::analogGetRate(void)
 {
-    static uint8_t timeFlag;
-    static unsigned long sampleTime[10];
     unsigned long valueTime_;
     minNumber(valueCount_);
     if(maxNumber(valueCount_)){
-        nowTim = millis();
+        nowTim = sampleTim_;
         uint32_t difTime =  nowTim - lastTim;
         lastTim = nowTim;
 
-        if(difTime>300 || difTime<2000){
-            sampleTime[timeFlag++] = difTime;
-            if(timeFlag > 9)timeFlag=0;
+        if(difTime>300 && difTime<2000){   // 30~200 bpm
+            sampleTime_[timeFlag_++] = difTime;
+            if(timeFlag_ > 9)timeFlag_=0;
         }
-        if(0 == sampleTime[9]){
-            Serial.println("Wait for valid data !");
+        if(0 == sampleTime_[9]){
+            DBG("Wait for valid data !");
             return(0);
         }
 
         uint32_t Arrange[10]={0};
         for(int i=0;i<10;i++){
-            Arrange[i] = sampleTime[i];
+            Arrange[i] = sampleTime_[i];
         }
         uint32_t Arrange_=0;
         for(int i=9;i>0;i--){
@@ -109,7 +111,7 @@ uint16_t DFRobot_Heartrate::analogGetRate(void)
             }
         }
         if((Arrange[7]-Arrange[3])>150){
-            Serial.println("Wait for valid data !");
+            DBG("Wait for valid data !");
             return(0);
         }
         
@@ -127,8 +129,6 @@ uint16_t DFRobot_Heartrate::analogGetRate(void)
 uint16_t DFRobot_Heartrate::digitalGetRate(void)
 {
 
-    static uint8_t timeFlag;
-    static unsigned long sampleTime[10];
     unsigned long valueTime_;
     uint8_t count_;
     
@@ -137,23 +137,23 @@ uint16_t DFRobot_Heartrate::digitalGetRate(void)
     }else{
         count_ = SAMPLE_NUMBER-1;
     }
-    if((value[valueCount_]>1000)&&(value[count_]<20)){
-        nowTim = millis();
+    if((value_[valueCount_]>1000)&&(value_[count_]<20)){
+        nowTim = sampleTim_;
         uint32_t difTime =  nowTim - lastTim;
         lastTim = nowTim;
         
-        if(difTime>300 || difTime<2000){
-            sampleTime[timeFlag++] = difTime;
-            if(timeFlag > 9)timeFlag=0;
+        if(difTime>300 && difTime<2000){   // 30~200 bpm
+            sampleTime_[timeFlag_++] = difTime;
+            if(timeFlag_ > 9)timeFlag_=0;
         }       
-        if(0 == sampleTime[9]){
-            Serial.println("Wait for valid data !");
+        if(0 == sampleTime_[9]){
+            DBG("Wait for valid data !");
             return(0);
         }
 
         uint32_t Arrange[10]={0};
         for(int i=0;i<10;i++){
-            Arrange[i] = sampleTime[i];
+            Arrange[i] = sampleTime_[i];
         }
         uint32_t Arrange_=0;
         for(int i=9;i>0;i--){
@@ -166,7 +166,7 @@ uint16_t DFRobot_Heartrate::digitalGetRate(void)
             }
         }
         if((Arrange[7]-Arrange[3])>120){
-            Serial.println("Wait for valid data !");
+            DBG("Wait for valid data !");
             return(0);
         }
 
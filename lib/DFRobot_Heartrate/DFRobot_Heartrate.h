@@ -63,6 +63,22 @@ public:
      */
     uint16_t getValue(uint8_t pin);
 
+    /**
+     * @fn addValue
+     * @brief Store a sample taken elsewhere (timer, DMA), then call getRate()
+     * @param sample - Sample value
+     * @param timeMs - Sample time in milliseconds, used instead of millis() for beat intervals
+     * @return None
+     */
+    void addValue(uint16_t sample, uint32_t timeMs);
+
+    /**
+     * @fn lastBeat
+     * @brief Time of the last detected beat, whether or not it produced a rate
+     * @return Time in milliseconds, 0 before the first beat
+     */
+    uint32_t lastBeat(void) { return lastTim; }
+
 protected:
 
     /**
@@ -103,8 +119,13 @@ private:
 
     uint8_t mode_;
     uint8_t valueCount_=255;
-    uint8_t valueFlag;
+    uint8_t valueFlag=0;
     uint32_t nowTim=0, lastTim=0;
+    uint32_t sampleTim_=0;
+    // per instance, so several sensors can run side by side
+    uint16_t value_[SAMPLE_NUMBER]={0};
+    uint32_t sampleTime_[10]={0};
+    uint8_t timeFlag_=0;
 
 };
 
@@ -225,7 +225,7 @@ void ScreenDisplay::loop()
 void ScreenDisplay::updateHeaderFromKeyValue(KeyValue *kv_pairs, int max_entries)
 {
     const char *validLabels[] = {
-        "DHT11", "DS18B20", "OUTPUT", "SERVO180", "SERVO360", "WS2812", "INPUT", "HEARTRATE", "EMG", "SERVO300"};
+        "DHT11", "DHT22", "DS18B20", "OUTPUT", "SERVO180", "SERVO360", "WS2812", "INPUT", "HEARTRATE", "EMG", "SERVO300"};
 
     char tempKey[8];
     for (uint8_t i = 0; i < IO_PORT_NUM; i++)
@@ -36,11 +36,60 @@ enum NOTCH_FREQUENCY { NOTCH_FREQ_50HZ = 50, NOTCH_FREQ_60HZ = 60 };
 
 enum SAMPLE_FREQUENCY { SAMPLE_FREQ_500HZ = 500, SAMPLE_FREQ_1000HZ = 1000 };
 
+// \brief Second-order IIR section (direct form II).
+class FILTER_2nd {
+  public:
+    void init(int type, int sampleFreq);
+
+    float update(float input) {
+        float tmp = (input - den[1] * states[0] - den[2] * states[1]) / den[0];
+        float output = num[0] * tmp + num[1] * states[0] + num[2] * states[1];
+        // save last states
+        states[1] = states[0];
+        states[0] = tmp;
+        return output;
+    }
+
+  private:
+    float states[2];
+    float num[3];
+    float den[3];
+};
+
+// \brief Fourth-order anti-hum filter, two cascaded second-order sections.
+class FILTER_4th {
+  public:
+    void init(int sampleFreq, int humFreq);
+
+    float update(float input) {
+        float stageIn;
+        float stageOut;
+
+        stageOut  = num[0] * input + states[0];
+        states[0] = (num[1] * input + states[1]) - den[1] * stageOut;
+        states[1] = num[2] * input - den[2] * stageOut;
+        stageIn   = stageOut;
+        stageOut  = num[3] * stageOut + states[2];
+        states[2] = (num[4] * stageIn + states[3]) - den[4] * stageOut;
+        states[3] = num[5] * stageIn - den[5] * stageOut;
+
+        return gain * stageOut;
+    }
+
+  private:
+    float states[4];
+    float num[6];
+    float den[6];
+    float gain;
+};
+
 // \brief EMGFilter provides an anti-hum notch filter to filter out 50HZ or
 //        60HZ power line noise, a lowpass filter to filter out signals above
 //        150HZ, and a highpass filter to filter out noise below 20HZ;
 //        You can turn on or off these filters by the init function.
 // \remark Input frequencies of 500HZ and 1000HZ are supported only!
+// \remark Filter states belong to the instance, so several channels can be
+//         filtered independently.
 class EMGFilters {
   public:
     // \brief Initializes the filter.
@@ -64,6 +113,14 @@ class EMGFilters {
     // value
     int update(int inputValue);
 
+    // \brief Filters a block of samples; same result as calling update()
+    //        on each sample in turn, with the filter stages inlined into
+    //        one loop instead of a call per sample.
+    // \param input raw samples
+    // \param output filtered samples, may be the same buffer as input
+    // \param count number of samples
+    void update(const int *input, int *output, int count);
+
   private:
     SAMPLE_FREQUENCY m_sampleFreq;
     NOTCH_FREQUENCY  m_notchFreq;
@@ -71,6 +128,9 @@ class EMGFilters {
     bool             m_notchFilterEnabled;
     bool             m_lowpassFilterEnabled;
     bool             m_highpassFilterEnabled;
+    FILTER_2nd       m_LPF;
+    FILTER_2nd       m_HPF;
+    FILTER_4th       m_AHF;
 };
 
 #endif
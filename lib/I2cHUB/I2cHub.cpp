@@ -25,14 +25,12 @@ void GestureFaceDetectionI2CHub::callback()
             gestureType = gfd->getGestureType();
         }
         gestureScore = gfd->getGestureScore();
-        sprintf(tempStr, "\"FaceX\":%d,\"FaceY\":%d,\"GestureType\":%d", faceX, faceY, gestureType);
-        data = String(tempStr);
-    }
-    else
-    {
-        sprintf(tempStr, "\"FaceX\":%d,\"FaceY\":%d,\"GestureType\":%d", faceX, faceY, gestureType);
-        data = String(tempStr);
     }
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("FaceX"), faceX);
+    frame.num(JSON_KEY("FaceY"), faceY);
+    frame.num(JSON_KEY("GestureType"), gestureType);
+    setData(frame);
 }
 
 bool GR10_30I2CHub::init()
@@ -48,63 +46,69 @@ bool GR10_30I2CHub::init()
 
 void GR10_30I2CHub::callback()
 {
-    char res[64] = "";
+    char res[64];
     if (gr10_30->getDataReady())
     {
+        const char *gesture = NULL;
         uint16_t gestures = gr10_30->getGesturesState();
         if (gestures & GESTURE_UP)
         {
-            // sprintf(res, "\"Gesture\":%s", "\"UP\"");
-            sprintf(res, "\"Gesture\":%s", "\"3\"");
+            // gesture = "UP";
+            gesture = "3";
         }
         if (gestures & GESTURE_DOWN)
         {
-            // sprintf(res, "\"Gesture\":%s", "\"Down\"");
-            sprintf(res, "\"Gesture\":%s", "\"4\"");
+            // gesture = "Down";
+            gesture = "4";
         }
         if (gestures & GESTURE_LEFT)
         {
-            // sprintf(res, "\"Gesture\":%s", "\"Left\"");
-            sprintf(res, "\"Gesture\":%s", "\"1\"");
+            // gesture = "Left";
+            gesture = "1";
         }
         if (gestures & GESTURE_RIGHT)
         {
-            // sprintf(res, "\"Gesture\":%s", "\"Right\"");
-            sprintf(res, "\"Gesture\":%s", "\"2\"");
+            // gesture = "Right";
+            gesture = "2";
         }
         if (gestures & GESTURE_FORWARD)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Forward\"");
+            gesture = "Forward";
         }
         if (gestures & GESTURE_BACKWARD)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Backward\"");
+            gesture = "Backward";
         }
         if (gestures & GESTURE_CLOCKWISE)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Clockwise\"");
+            gesture = "Clockwise";
         }
         if (gestures & GESTURE_COUNTERCLOCKWISE)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Contrarotate\"");
+            gesture = "Contrarotate";
         }
         if (gestures & GESTURE_WAVE)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Wave\"");
+            gesture = "Wave";
         }
         if (gestures & GESTURE_HOVER)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Hover\"");
+            gesture = "Hover";
         }
         if (gestures & GESTURE_CLOCKWISE_C)
         {
-            sprintf(res, "\"Gesture\":%s", "\"clockwise\"");
+            gesture = "clockwise";
         }
         if (gestures & GESTURE_COUNTERCLOCKWISE_C)
         {
-            sprintf(res, "\"Gesture\":%s", "\"Continuous counterclockwise\"");
+            gesture = "Continuous counterclockwise";
+        }
+        JsonFrame frame(res, sizeof(res));
+        if (gesture != NULL)
+        {
+            frame.text(JSON_KEY("Gesture"), gesture);
         }
-        data = String(res);
+        setData(frame);
     }
 }
 
@@ -122,8 +126,12 @@ void BME280I2CHub::callback()
     uint32_t press = bme->getPressure();
     float alti = bme->calAltitude(1015.0, press);
     float humi = bme->getHumidity();
-    sprintf(tempStr, "\"Temperature\":%.1f,\"Pressure\":%d,\"Altitude\":%.2f,\"Humidity\":%.1f", temp, press, alti, humi);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.real(JSON_KEY("Temperature"), temp, 1);
+    frame.num(JSON_KEY("Pressure"), press);
+    frame.real(JSON_KEY("Altitude"), alti, 2);
+    frame.real(JSON_KEY("Humidity"), humi, 1);
+    setData(frame);
 }
 
 bool URM09I2CHub::init()
@@ -139,10 +147,10 @@ void URM09I2CHub::callback()
 {
     char tempStr[64];
     // URM09->measurement();                 // Send ranging command
-    float temp = URM09->getTemperature(); // Read temperature
     int16_t dist = URM09->getDistance();  // Read distance
-    sprintf(tempStr, "\"UltrasonicSensor\":%d", dist);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("UltrasonicSensor"), dist);
+    setData(frame);
 }
 
 bool ColorI2CHub::init()
@@ -157,8 +165,11 @@ void ColorI2CHub::callback()
     uint16_t clear, red, green, blue;
     tcs->getRGBC(&red, &green, &blue, &clear);
     tcs->lock();
-    sprintf(tempStr, "\"R\":%d,\"G\":%d,\"B\":%d", red, green, blue);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("R"), red);
+    frame.num(JSON_KEY("G"), green);
+    frame.num(JSON_KEY("B"), blue);
+    setData(frame);
 }
 
 bool AmbientLightI2CHub::init()
@@ -173,8 +184,9 @@ void AmbientLightI2CHub::callback()
     char tempStr[64];
     float lux;
     als->getALSLux(lux); // Get the measured ambient light value
-    sprintf(tempStr, "\"Lux\":%.3f", lux);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.real(JSON_KEY("Lux"), lux, 3);
+    setData(frame);
 }
 
 bool TripleAxisAccelerometerI2CHub::init()
@@ -194,8 +206,11 @@ void TripleAxisAccelerometerI2CHub::callback()
     ax = acce->readAccX(); // Get the acceleration in the x direction
     ay = acce->readAccY(); // Get the acceleration in the y direction
     az = acce->readAccZ(); // Get the acceleration in the z direction
-    sprintf(tempStr, "\"x\":%ld,\"y\":%ld,\"z\":%ld", ax, ay, az);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("x"), ax);
+    frame.num(JSON_KEY("y"), ay);
+    frame.num(JSON_KEY("z"), az);
+    setData(frame);
 }
 
 bool mmWaveI2CHub::init()
@@ -213,8 +228,9 @@ bool mmWaveI2CHub::init()
 void mmWaveI2CHub::callback()
 {
     char tempStr[64];
-    sprintf(tempStr, "\"motion\":%d", radar->motionDetection() ? 1 : 0);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("motion"), radar->motionDetection() ? 1 : 0);
+    setData(frame);
 }
 
 bool UVI2CHub::init()
@@ -226,10 +242,10 @@ bool UVI2CHub::init()
 void UVI2CHub::callback()
 {
     char tempStr[64];
-    uint16_t voltage = UVIndex240370Sensor->readUvOriginalData();
     uint16_t index = UVIndex240370Sensor->readUvIndexData();
-    sprintf(tempStr, "\"UV\":%d", index);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("UV"), index);
+    setData(frame);
 }
 
 bool Bmx160I2CHub::init()
@@ -246,16 +262,23 @@ void Bmx160I2CHub::callback()
     sBmx160SensorData_t Omagn, Ogyro, Oaccel;
     bmx->getAllData(&Omagn, &Ogyro, &Oaccel);
 
-    sprintf(tempStr,
-            // "\"acc\":{\"x\":%.1f,\"y\":%.1f,\"z\":%.1f}",
-            "\"mag\":{\"x\":%.2f,\"y\":%.2f,\"z\":%.2f},"
-            "\"gyr\":{\"x\":%.2f,\"y\":%.2f,\"z\":%.2f},"
-            "\"acc\":{\"x\":%.2f,\"y\":%.2f,\"z\":%.2f}",
-            Omagn.x, Omagn.y, Omagn.z,
-            Ogyro.x, Ogyro.y, Ogyro.z,
-            Oaccel.x, Oaccel.y, Oaccel.z
-    );
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.open(JSON_KEY("mag"));
+    frame.real(JSON_KEY("x"), Omagn.x, 2);
+    frame.real(JSON_KEY("y"), Omagn.y, 2);
+    frame.real(JSON_KEY("z"), Omagn.z, 2);
+    frame.close();
+    frame.open(JSON_KEY("gyr"));
+    frame.real(JSON_KEY("x"), Ogyro.x, 2);
+    frame.real(JSON_KEY("y"), Ogyro.y, 2);
+    frame.real(JSON_KEY("z"), Ogyro.z, 2);
+    frame.close();
+    frame.open(JSON_KEY("acc"));
+    frame.real(JSON_KEY("x"), Oaccel.x, 2);
+    frame.real(JSON_KEY("y"), Oaccel.y, 2);
+    frame.real(JSON_KEY("z"), Oaccel.z, 2);
+    frame.close();
+    setData(frame);
 }
 
 bool ENS160I2CHub::init()
@@ -278,8 +301,11 @@ void ENS160I2CHub::callback()
     uint16_t TVOC = ens160->getTVOC();
     uint16_t ECO2 = ens160->getECO2();
 
-    sprintf(tempStr, "\"ens160_TVOC\":%d,\"ens160_ECO2\":%d,\"ens160_AQI\":%d",TVOC, ECO2, AQI);
-    data = String(tempStr);
+    JsonFrame frame(tempStr, sizeof(tempStr));
+    frame.num(JSON_KEY("ens160_TVOC"), TVOC);
+    frame.num(JSON_KEY("ens160_ECO2"), ECO2);
+    frame.num(JSON_KEY("ens160_AQI"), AQI);
+    setData(frame);
 }
 
 bool MAX30102I2CHub::init()
@@ -294,26 +320,23 @@ bool MAX30102I2CHub::init()
 
 void MAX30102I2CHub::callback()
 {   
-    char sop2Str[32], heartRateStr[32];
+    char tempStr[64];
     static uint8_t skip= 0;
     static uint16_t HeartRate = 0, SPO2 = 0;
 
     if(skip++ == 10){
         max30102->getHeartbeatSPO2();
+        // 读数无效时沿用上次的有效值
         if(max30102->_sHeartbeatSPO2.SPO2 > 0){
-            sprintf(sop2Str,"\"max30102_SPO2\":%d",max30102->_sHeartbeatSPO2.SPO2);
             SPO2 = max30102->_sHeartbeatSPO2.SPO2;
-        }else{
-            sprintf(sop2Str,"\"max30102_SPO2\":%d", SPO2);
         }
         if(max30102->_sHeartbeatSPO2.Heartbeat > 0){
-            sprintf(heartRateStr,"\"max30102_HeartRate\":%d",max30102->_sHeartbeatSPO2.Heartbeat);
             HeartRate = max30102->_sHeartbeatSPO2.Heartbeat;
-        }else{
-            sprintf(heartRateStr,"\"max30102_HeartRate\":%d", HeartRate);
         }
-        //sprintf(tempStr, "\"max30102_SPO2\":%d,\"max30102_HeartRate\":%d", max30102->_sHeartbeatSPO2.SPO2, max30102->_sHeartbeatSPO2.Heartbeat);
-        data = String(sop2Str + String(",") + heartRateStr);
+        JsonFrame frame(tempStr, sizeof(tempStr));
+        frame.num(JSON_KEY("max30102_SPO2"), SPO2);
+        frame.num(JSON_KEY("max30102_HeartRate"), HeartRate);
+        setData(frame);
         //printf("%s",data.c_str());
         //printf("i am here\n");
         skip = 0;
@@ -342,8 +365,9 @@ void SCD4XI2CHub::callback()
         scd4x->readMeasurement(&scd4xData);
         // printf("\"SCD4X\": {\"CO2\": %d, \"Temperature\": %.2f, \"Humidity\": %.2f}\n",
         //        data.CO2ppm, data.temp, data.humidity);
-        sprintf(tempStr,"\"scd4x_CO2ppm\":%d", scd4xData.CO2ppm);
-        data = String(tempStr);
+        JsonFrame frame(tempStr, sizeof(tempStr));
+        frame.num(JSON_KEY("scd4x_CO2ppm"), scd4xData.CO2ppm);
+        setData(frame);
     }
 }
 
@@ -360,6 +384,26 @@ bool BMI160I2CHub::init()
     return true;
 }
 
+/**
+ * @brief 四舍五入的整数除法
+ */
+static inline int32_t roundDiv(int32_t num, int32_t den)
+{
+    return num >= 0 ? (num + den / 2) / den : (num - den / 2) / den;
+}
+
+/** @brief 陀螺仪原始值换算为0.01单位（原公式 raw*3.14/180） */
+static inline int32_t bmi160GyrCenti(int16_t raw)
+{
+    return roundDiv((int32_t)raw * 157, 90);
+}
+
+/** @brief 加速度原始值换算为0.01g（原公式 raw/16384） */
+static inline int32_t bmi160AccCenti(int16_t raw)
+{
+    return roundDiv((int32_t)raw * 100, 16384);
+}
+
 void BMI160I2CHub::callback()
 {
     int i = 0;
@@ -369,9 +413,14 @@ void BMI160I2CHub::callback()
 
     rslt = bmi160->getAccelGyroData(accelGyro);
     if(rslt == 0){
-        sprintf(tempStr, "\"bmi160_gyr_x\":%.2f,\"bmi160_gyr_y\":%.2f,\"bmi160_gyr_z\":%.2f,\"bmi160_acc_x\":%.2f,\"bmi160_acc_y\":%.2f,\"bmi160_acc_z\":%.2f",
-                accelGyro[0]*3.14/180.0, accelGyro[1]*3.14/180.0, accelGyro[2]*3.14/180.0,
-                accelGyro[3]/16384.0, accelGyro[4]/16384.0, accelGyro[5]/16384.0);
-        data = String(tempStr);
+        // 纯整数换算为两位小数的定点数：gyr = raw*3.14/180 = raw*157/90，acc = raw/16384
+        JsonFrame frame(tempStr, sizeof(tempStr));
+        frame.fixed(JSON_KEY("bmi160_gyr_x"), bmi160GyrCenti(accelGyro[0]), 2);
+        frame.fixed(JSON_KEY("bmi160_gyr_y"), bmi160GyrCenti(accelGyro[1]), 2);
+        frame.fixed(JSON_KEY("bmi160_gyr_z"), bmi160GyrCenti(accelGyro[2]), 2);
+        frame.fixed(JSON_KEY("bmi160_acc_x"), bmi160AccCenti(accelGyro[3]), 2);
+        frame.fixed(JSON_KEY("bmi160_acc_y"), bmi160AccCenti(accelGyro[4]), 2);
+        frame.fixed(JSON_KEY("bmi160_acc_z"), bmi160AccCenti(accelGyro[5]), 2);
+        setData(frame);
     }
 }
\ No newline at end of file
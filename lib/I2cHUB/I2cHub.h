@@ -7,6 +7,8 @@
  */
 #pragma once
 #include "global.h"
+#include "JsonFrame.h"
+#include "esp_timer.h"
 
 // #ifndef __I2CHUB_H_
 // #define __I2CHUB_H_
@@ -67,12 +69,66 @@ public:
 
     String getResStr();
 
+    /**
+     * @brief 获取设备主题名
+     *
+     * @return const char* 设备在发布主题层级中的名称，如 "bme280"
+     */
+    virtual const char *getTopicName() const = 0;
+
+    /**
+     * @brief 获取采样序号
+     *
+     * @return uint32_t 每产生一次新数据加一，用于按设备自身的更新节奏发布
+     */
+    uint32_t getSeq() const { return seq; }
+
+    /**
+     * @brief 获取最近一次数据读取完成的时刻
+     *
+     * @return int64_t 单调时钟（esp_timer，微秒）
+     */
+    int64_t getReadUs() const { return readUs; }
+
     /** @brief 虚析构函数，确保正确释放派生类资源 */
     virtual ~I2CHub() = default;
 
 protected:
     /** @brief 传感器数据缓存 */
     String data;
+
+    /** @brief 采样序号 */
+    uint32_t seq = 0;
+
+    /** @brief 最近一次数据读取完成的时刻（微秒） */
+    int64_t readUs = 0;
+
+    /**
+     * @brief 更新数据缓存并递增采样序号，记录读取完成时刻
+     *
+     * @param str 格式化的传感器数据字符串
+     */
+    void setData(const String &str)
+    {
+        data = str;
+        seq++;
+        readUs = esp_timer_get_time();
+    }
+
+    /**
+     * @brief 用字段写入器的结果更新数据缓存
+     *
+     * @param frame 已写入的字段片段，缓冲区不足时丢弃本次数据
+     */
+    void setData(const JsonFrame &frame)
+    {
+        if (!frame.overflow())
+        {
+            data = frame.c_str();
+            seq++;
+            readUs = esp_timer_get_time();
+        }
+    }
 };
 
 class GestureFaceDetectionI2CHub : public I2CHub
@@ -80,6 +136,7 @@ class GestureFaceDetectionI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x72;
     uint8_t getAddr() const override { return 0x72; }
+    const char *getTopicName() const override { return "gesture_face"; }
     virtual bool init() override;
     void callback() override;
 
@@ -92,6 +149,7 @@ class GR10_30I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x73;
     uint8_t getAddr() const override { return 0x73; }
+    const char *getTopicName() const override { return "gr10_30"; }
     virtual bool init() override;
     void callback() override;
 
@@ -103,6 +161,7 @@ class BME280I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x77;
     uint8_t getAddr() const override { return 0x77; }
+    const char *getTopicName() const override { return "bme280"; }
     virtual bool init() override;
     void callback() override;
 
@@ -114,6 +173,7 @@ class URM09I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x11;
     uint8_t getAddr() const override { return 0x11; }
+    const char *getTopicName() const override { return "urm09"; }
     virtual bool init() override;
     void callback() override;
 
@@ -126,6 +186,7 @@ class ColorI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x29;
     uint8_t getAddr() const override { return 0x29; }
+    const char *getTopicName() const override { return "color"; }
     virtual bool init() override;
     void callback() override;
 
@@ -137,6 +198,7 @@ class AmbientLightI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x10;
     uint8_t getAddr() const override { return 0x10; }
+    const char *getTopicName() const override { return "ambient_light"; }
     virtual bool init() override;
     void callback() override;
 
@@ -149,6 +211,7 @@ class TripleAxisAccelerometerI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x18;
     uint8_t getAddr() const override { return 0x18; }
+    const char *getTopicName() const override { return "lis2dh12"; }
     virtual bool init() override;
     void callback() override;
 
@@ -161,6 +224,7 @@ class mmWaveI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x2A;
     uint8_t getAddr() const override { return 0x2A; }
+    const char *getTopicName() const override { return "mmwave"; }
     virtual bool init() override;
     void callback() override;
 
@@ -173,6 +237,7 @@ class UVI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x23;
     uint8_t getAddr() const override { return 0x23; }
+    const char *getTopicName() const override { return "uv"; }
     virtual bool init() override;
     void callback() override;
 
@@ -185,6 +250,7 @@ class Axis9OrientationI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x28;
     uint8_t getAddr() const override { return 0x28; }
+    const char *getTopicName() const override { return "bno055"; }
     virtual bool init() override;
     void callback() override;
 
@@ -197,6 +263,7 @@ class Bmx160I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x68;
     uint8_t getAddr() const override { return 0x68; }
+    const char *getTopicName() const override { return "bmx160"; }
     virtual bool init() override;
     void callback() override;
 
@@ -209,6 +276,7 @@ class ENS160I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x52;
     uint8_t getAddr() const override { return 0x52; }
+    const char *getTopicName() const override { return "ens160"; }
     virtual bool init() override;
     void callback() override;
 
@@ -221,6 +289,7 @@ class MAX30102I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x57;
     uint8_t getAddr() const override { return 0x57; }
+    const char *getTopicName() const override { return "max30102"; }
     virtual bool init() override;
     void callback() override;
 
@@ -233,6 +302,7 @@ class SCD4XI2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x62;
     uint8_t getAddr() const override { return 0x62; }
+    const char *getTopicName() const override { return "scd4x"; }
     virtual bool init() override;
     void callback() override;
      DFRobot_SCD4X::sSensorMeasurement_t scd4xData;
@@ -246,6 +316,7 @@ class BMI160I2CHub : public I2CHub
 public:
     static const uint8_t addr = 0x69;
     uint8_t getAddr() const override { return 0x69; }
+    const char *getTopicName() const override { return "bmi160"; }
     virtual bool init() override;
     void callback() override;
 private:
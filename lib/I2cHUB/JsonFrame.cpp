@@ -0,0 +1,125 @@
+/**
+ * @file    JsonFrame.cpp
+ * @brief   传感器JSON字段片段写入器实现
+ *
+ * @details 整数逐位转换；浮点数先拆成整数部分和小数部分，只对小数部分乘10^n取整，
+ *          舍入结果与printf("%.nf")一致，再输出整数部分和补零的小数部分。
+ */
+#include "JsonFrame.h"
+#include <math.h>
+
+static const uint32_t kPow10[JSON_FRAME_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+void JsonFrame::_put(char c) {
+  if (_len + 1 < _cap) {
+    _buf[_len++] = c;
+    _buf[_len] = '\0';
+  } else {
+    _overflow = true;
+  }
+}
+
+void JsonFrame::_raw(const char *s, size_t len) {
+  if (_len + len < _cap) {
+    memcpy(_buf + _len, s, len);
+    _len += len;
+    _buf[_len] = '\0';
+  } else {
+    _overflow = true;
+  }
+}
+
+void JsonFrame::_key(const char *key, size_t len) {
+  if (!_first) {
+    _put(',');
+  }
+  _first = false;
+  _raw(key, len);
+}
+
+/**
+ * @brief 写入无符号整数
+ *
+ * @param v 数值
+ * @param minDigits 最少位数，不足时前补0（用于小数部分）
+ */
+void JsonFrame::_uint(uint32_t v, uint8_t minDigits) {
+  char tmp[10];
+  uint8_t n = 0;
+  do {
+    tmp[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v > 0);
+  while (n < minDigits) {
+    tmp[n++] = '0';
+  }
+  while (n > 0) {
+    _put(tmp[--n]);
+  }
+}
+
+void JsonFrame::_int(int32_t v) {
+  if (v < 0) {
+    _put('-');
+    _uint(0u - (uint32_t)v, 1);
+  } else {
+    _uint((uint32_t)v, 1);
+  }
+}
+
+void JsonFrame::_fixed(int32_t scaled, uint8_t decimals) {
+  if (decimals > JSON_FRAME_MAX_DECIMALS) {
+    decimals = JSON_FRAME_MAX_DECIMALS;
+  }
+  if (decimals == 0) {
+    _int(scaled);
+    return;
+  }
+  uint32_t mag = scaled < 0 ? 0u - (uint32_t)scaled : (uint32_t)scaled;
+  if (scaled < 0) {
+    _put('-');
+  }
+  _uint(mag / kPow10[decimals], 1);
+  _put('.');
+  _uint(mag % kPow10[decimals], decimals);
+}
+
+/**
+ * @brief 写入浮点数
+ *
+ * @details 整数部分直接截断，小数部分（相减无误差）转为2^-40定点数后乘10^n，
+ *          按余数就近舍入、恰好一半时取偶，不会像整体乘10^n那样二次舍入；
+ *          小数部分进位到整数部分时整数加1
+ */
+void JsonFrame::_real(float v, uint8_t decimals) {
+  if (decimals > JSON_FRAME_MAX_DECIMALS) {
+    decimals = JSON_FRAME_MAX_DECIMALS;
+  }
+  // NaN、无穷大及整数部分超出int32范围的值输出null，保证JSON有效
+  if (!(v > -2.1e9f && v < 2.1e9f)) {
+    _raw("null", 4);
+    return;
+  }
+  bool negative = signbit(v);
+  float mag = negative ? -v : v;
+  uint32_t ip = (uint32_t)mag;
+  uint64_t frac = (uint64_t)((mag - (float)ip) * 1099511627776.0f); // 2^40
+  uint64_t prod = frac * kPow10[decimals];
+  uint32_t fp = (uint32_t)(prod >> 40);
+  uint64_t rem = prod & ((1ULL << 40) - 1);
+  if (rem > (1ULL << 39) || (rem == (1ULL << 39) && ((decimals > 0 ? fp : ip) & 1))) {
+    fp++;
+  }
+  if (fp >= kPow10[decimals]) {
+    fp -= kPow10[decimals];
+    ip++;
+  }
+  if (negative) {
+    _put('-');
+  }
+  _uint(ip, 1);
+  if (decimals > 0) {
+    _put('.');
+    _uint(fp, decimals);
+  }
+}
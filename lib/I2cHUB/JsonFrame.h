@@ -0,0 +1,100 @@
+/**
+ * @file    JsonFrame.h
+ * @brief   传感器JSON字段片段写入器头文件
+ *
+ * @details 替代回调中的sprintf：键名用JSON_KEY在编译期拼成 "\"键\":" 字面量，
+ *          长度由模板参数得到；数值按整数定点格式化，不经过newlib的double浮点格式化。
+ *          直接写入调用者提供的缓冲区，不分配内存，空间不足时置溢出标志。
+ *          输出为不含花括号的字段片段，如 "Temperature":25.3,"Pressure":101325
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/** @brief 编译期生成字段键字面量，如 JSON_KEY("Lux") 即 "\"Lux\":" */
+#define JSON_KEY(name) "\"" name "\":"
+
+#define JSON_FRAME_MAX_DECIMALS 6 ///< 最大小数位数
+
+class JsonFrame {
+public:
+    /**
+     * @brief 构造写入器
+     * @param buf 输出缓冲区，始终以'\0'结尾
+     * @param cap 缓冲区容量（含结尾'\0'）
+     */
+    JsonFrame(char *buf, size_t cap) : _buf(buf), _cap(cap), _len(0), _first(true), _overflow(false) {
+        if (_cap > 0) {
+            _buf[0] = '\0';
+        }
+    }
+
+    /** @brief 写入整数字段 */
+    template <size_t N> void num(const char (&key)[N], int32_t v) {
+        _key(key, N - 1);
+        _int(v);
+    }
+
+    /**
+     * @brief 写入定点数字段
+     * @param scaled 放大10^decimals倍后的整数值，如 2534 配合 decimals=2 输出 25.34
+     * @param decimals 小数位数
+     */
+    template <size_t N> void fixed(const char (&key)[N], int32_t scaled, uint8_t decimals) {
+        _key(key, N - 1);
+        _fixed(scaled, decimals);
+    }
+
+    /**
+     * @brief 写入浮点数字段（保留decimals位小数，舍入结果与printf("%.nf")相同）
+     * @param decimals 小数位数，NaN或整数部分超出int32范围时输出null
+     */
+    template <size_t N> void real(const char (&key)[N], float v, uint8_t decimals) {
+        _key(key, N - 1);
+        _real(v, decimals);
+    }
+
+    /** @brief 写入字符串字段，内容不转义，只用于固定的枚举文本 */
+    template <size_t N> void text(const char (&key)[N], const char *s) {
+        _key(key, N - 1);
+        _put('"');
+        _raw(s, strlen(s));
+        _put('"');
+    }
+
+    /** @brief 开始嵌套对象字段，如 "mag":{ */
+    template <size_t N> void open(const char (&key)[N]) {
+        _key(key, N - 1);
+        _put('{');
+        _first = true;
+    }
+
+    /** @brief 结束嵌套对象 */
+    void close() {
+        _put('}');
+        _first = false;
+    }
+
+    /** @brief 输出字符串 */
+    const char *c_str() const { return _buf; }
+    /** @brief 已写入字节数 */
+    size_t size() const { return _len; }
+    /** @brief 缓冲区是否不足 */
+    bool overflow() const { return _overflow; }
+
+private:
+    char *_buf;
+    size_t _cap;
+    size_t _len;
+    bool _first;
+    bool _overflow;
+
+    void _put(char c);
+    void _raw(const char *s, size_t len);
+    void _key(const char *key, size_t len);
+    void _uint(uint32_t v, uint8_t minDigits);
+    void _int(int32_t v);
+    void _fixed(int32_t scaled, uint8_t decimals);
+    void _real(float v, uint8_t decimals);
+};
@@ -1,46 +1,465 @@
 #include "IOHub.h"
 #include "global.h"
+#include "esp_timer.h"
+#include "mongoose.h"
+#include "JsonFrame.h"
+
+void MotionProfile::start(float target, float speed, float accel) {
+  this->_target = target;
+  this->_vmax = speed;
+  this->_amax = accel;
+  this->_moving = this->_target != this->_pos || this->_vel != 0;
+}
+
+void MotionProfile::jump(float pos) {
+  this->_pos = this->_target = pos;
+  this->_vel = 0;
+  this->_moving = false;
+}
+
+bool MotionProfile::step(float dt) {
+  if (!this->_moving) {
+    return false;
+  }
+  float dist = this->_target - this->_pos;
+  float dir = dist >= 0 ? 1.0f : -1.0f;
+  float v;
+  if (this->_vel * dir < 0) {
+    // 正在背离目标，先减速反向
+    v = this->_vel + dir * this->_amax * dt;
+  } else if (fabsf(dist) - fabsf(this->_vel) * dt <= this->_vel * this->_vel / (2.0f * this->_amax)) {
+    // 下一周期后的剩余距离不够减速，开始减速
+    v = this->_vel - dir * this->_amax * dt;
+    if (v * dir < 0) {
+      v = 0;
+    }
+  } else {
+    v = this->_vel + dir * this->_amax * dt;
+  }
+  if (fabsf(v) > this->_vmax) {
+    v = copysignf(this->_vmax, v);
+  }
+  this->_pos += 0.5f * (this->_vel + v) * dt;
+  this->_vel = v;
+  // 越过目标或停在目标附近时到位
+  if ((this->_target - this->_pos) * dir <= 0 || (v == 0 && fabsf(this->_target - this->_pos) < 0.5f)) {
+    this->jump(this->_target);
+  }
+  return this->_moving;
+}
 
 void NanIOHub::init() {}
 
 void NanIOHub::callback(const char *arg) {}
 
-void AnalogIOHub::init() {}
+void AnalogIOHub::init() { this->_slot = analogSampler.add(this->_pin, this->_filter); }
+
+// 各IO口的字段键，编译期字面量供JsonFrame使用
+static const char kAnalogKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_input_val"))] = {
+    JSON_KEY("p1_input_val"), JSON_KEY("p2_input_val"), JSON_KEY("p3_input_val"),
+    JSON_KEY("p4_input_val"), JSON_KEY("p5_input_val"), JSON_KEY("p6_input_val")};
 
 void AnalogIOHub::callback(const char *arg) {
-  char tempStr[32] = {0};
-  float val = analogRead(this->_pin) / 4096.0f;
-  this->_JsonStr =
-      "\"p" + String(this->_ioIdx) + "_input_val\":" + String(val, 2) + "\n";
+  float raw;
+  if (this->_slot >= 0) {
+    // 本周期没有新样本时保留上一次的值
+    if (!analogSampler.take(this->_slot, &raw)) {
+      return;
+    }
+  } else {
+    raw = analogRead(this->_pin);
+  }
+  char buf[32];
+  JsonFrame frame(buf, sizeof(buf));
+  frame.real(kAnalogKeys[this->_ioIdx - 1], raw / 4096.0f, 2);
+  this->_JsonStr = frame.c_str();
+}
+
+void EMGIOHub::init() {
+  this->_filters.init(SAMPLE_FREQ_1000HZ, this->_notch);
+  this->_slot = analogSampler.addStream(this->_pin, SAMPLE_FREQ_1000HZ, _sink, this);
+  if (this->_slot < 0) {
+    // ADC2引脚无法连续采样，不参与采集
+    printf("[Error]P%u: emg needs an ADC1 pin (P1-P4)\n", this->_ioIdx);
+    this->setType(IO_CONTROL);
+  }
+}
+
+/**
+ * @brief 样本块回调，在ADC读取任务中执行
+ */
+void EMGIOHub::_sink(void *ctx, const uint16_t *samples, size_t count) {
+  EMGIOHub *self = (EMGIOHub *)ctx;
+  int block[ANALOG_BLOCK_MAX];
+  for (size_t i = 0; i < count; i++) {
+    block[i] = samples[i];
+  }
+  self->_filters.update(block, block, (int)count);
+  uint32_t sumAbs = 0;
+  uint64_t sumSq = 0;
+  for (size_t i = 0; i < count; i++) {
+    int v = block[i];
+    sumAbs += (uint32_t)abs(v);
+    sumSq += (uint64_t)((int64_t)v * v);
+  }
+  portENTER_CRITICAL(&self->_mux);
+  self->_count += count;
+  self->_sumAbs += sumAbs;
+  self->_sumSq += sumSq;
+  portEXIT_CRITICAL(&self->_mux);
+}
+
+static const char kEmgEnvKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_emg_env"))] = {
+    JSON_KEY("p1_emg_env"), JSON_KEY("p2_emg_env"), JSON_KEY("p3_emg_env"),
+    JSON_KEY("p4_emg_env"), JSON_KEY("p5_emg_env"), JSON_KEY("p6_emg_env")};
+static const char kEmgRmsKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_emg_rms"))] = {
+    JSON_KEY("p1_emg_rms"), JSON_KEY("p2_emg_rms"), JSON_KEY("p3_emg_rms"),
+    JSON_KEY("p4_emg_rms"), JSON_KEY("p5_emg_rms"), JSON_KEY("p6_emg_rms")};
+
+void EMGIOHub::callback(const char *arg) {
+  portENTER_CRITICAL(&this->_mux);
+  uint32_t count = this->_count;
+  uint64_t sumAbs = this->_sumAbs;
+  uint64_t sumSq = this->_sumSq;
+  this->_count = 0;
+  this->_sumAbs = 0;
+  this->_sumSq = 0;
+  portEXIT_CRITICAL(&this->_mux);
+  // 本周期没有新样本时保留上一次的值
+  if (count == 0) {
+    return;
+  }
+  char buf[64];
+  JsonFrame frame(buf, sizeof(buf));
+  frame.real(kEmgEnvKeys[this->_ioIdx - 1], (float)sumAbs / count, 1);
+  frame.real(kEmgRmsKeys[this->_ioIdx - 1], sqrtf((float)((double)sumSq / count)), 1);
+  this->_JsonStr = frame.c_str();
+}
+
+HeartRateIOHub::~HeartRateIOHub() {
+  if (this->_timer != NULL) {
+    esp_timer_stop(this->_timer);
+    esp_timer_delete(this->_timer);
+  }
+}
+
+void HeartRateIOHub::init() {
+  this->_slot = analogSampler.addStream(this->_pin, 0, _sink, this);
+  if (this->_slot >= 0) {
+    return;
+  }
+  // ADC2引脚由定时器单次读取
+  if (this->_timer == NULL) {
+    esp_timer_create_args_t args = {};
+    args.callback = _tick;
+    args.arg = this;
+    args.name = "hr";
+    esp_timer_create(&args, &this->_timer);
+  }
+  esp_timer_start_periodic(this->_timer, 1000000 / HR_SAMPLE_HZ);
+}
+
+/**
+ * @brief 处理一个样本，在ADC读取任务或ESP定时器任务中执行
+ */
+void HeartRateIOHub::_push(uint16_t sample, uint32_t timeMs) {
+  this->_sensor.addValue(sample, timeMs);
+  uint16_t rate = this->_sensor.getRate();
+  portENTER_CRITICAL(&this->_mux);
+  this->_nowMs = timeMs;
+  this->_beatMs = this->_sensor.lastBeat();
+  if (rate != 0) {
+    this->_bpm = rate;
+    this->_goodMs = timeMs;
+  }
+  portEXIT_CRITICAL(&this->_mux);
+}
+
+void HeartRateIOHub::_tick(void *arg) {
+  HeartRateIOHub *self = (HeartRateIOHub *)arg;
+  self->_samples++;
+  self->_push(analogRead(self->_pin), self->_samples * (1000 / HR_SAMPLE_HZ));
+}
+
+/**
+ * @brief DMA样本块回调，每_decim个样本取平均作为一个心率样本
+ */
+void HeartRateIOHub::_sink(void *ctx, const uint16_t *samples, size_t count) {
+  HeartRateIOHub *self = (HeartRateIOHub *)ctx;
+  uint32_t rate = analogSampler.rate();
+  if (self->_decim == 0) {
+    self->_decim = rate > HR_SAMPLE_HZ ? rate / HR_SAMPLE_HZ : 1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    self->_raw++;
+    self->_acc += samples[i];
+    if (++self->_accN >= self->_decim) {
+      self->_push((uint16_t)(self->_acc / self->_accN), (uint32_t)(self->_raw * 1000 / rate));
+      self->_acc = 0;
+      self->_accN = 0;
+    }
+  }
 }
 
-void DigitalOutIOHub::init() { pinMode(this->_pin, OUTPUT); }
+static const char kHrBpmKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_hr_bpm"))] = {
+    JSON_KEY("p1_hr_bpm"), JSON_KEY("p2_hr_bpm"), JSON_KEY("p3_hr_bpm"),
+    JSON_KEY("p4_hr_bpm"), JSON_KEY("p5_hr_bpm"), JSON_KEY("p6_hr_bpm")};
+static const char kHrQualityKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_hr_quality"))] = {
+    JSON_KEY("p1_hr_quality"), JSON_KEY("p2_hr_quality"), JSON_KEY("p3_hr_quality"),
+    JSON_KEY("p4_hr_quality"), JSON_KEY("p5_hr_quality"), JSON_KEY("p6_hr_quality")};
+
+void HeartRateIOHub::callback(const char *arg) {
+  portENTER_CRITICAL(&this->_mux);
+  uint16_t bpm = this->_bpm;
+  uint32_t now = this->_nowMs;
+  uint32_t good = this->_goodMs;
+  uint32_t beat = this->_beatMs;
+  portEXIT_CRITICAL(&this->_mux);
+
+  uint8_t quality = 0;
+  if (good != 0 && now - good < HR_VALID_MS) {
+    quality = 2;
+  } else if (beat != 0 && now - beat < HR_VALID_MS) {
+    quality = 1;
+  } else {
+    bpm = 0;
+  }
+  char buf[64];
+  JsonFrame frame(buf, sizeof(buf));
+  frame.num(kHrBpmKeys[this->_ioIdx - 1], bpm);
+  frame.num(kHrQualityKeys[this->_ioIdx - 1], quality);
+  this->_JsonStr = frame.c_str();
+}
+
+DigitalOutIOHub::~DigitalOutIOHub() {
+  this->_stop();
+  if (this->_timer != NULL) {
+    esp_timer_delete(this->_timer);
+  }
+  delete this->_pwm;
+}
+
+void DigitalOutIOHub::init() { this->_level(false); }
 
 void DigitalOutIOHub::callback(const char *arg) {
   if (arg == nullptr) {
     return;
   }
-  uint8_t outLevel = LOW;
+  this->setBytes(arg, strlen(arg));
+}
+
+bool DigitalOutIOHub::setInt(int32_t value) { return this->setFloat((float)value); }
+
+bool DigitalOutIOHub::setFloat(float value) {
+  switch (this->_name) {
+  case IO_PWM:
+    return this->setPwm(value, 0);
+  case IO_PATTERN:
+    if (value <= 0) {
+      this->_level(false);
+      return true;
+    }
+    return this->setPattern((uint32_t)value, 50, 0);
+  default:
+    this->_level(value == 1.0f);
+    return true;
+  }
+}
+
+bool DigitalOutIOHub::setBytes(const char *data, size_t len) {
+  // 判断控制命令，忽略大小写
+  if (len == 2 && strncasecmp(data, "on", 2) == 0) {
+    return this->_name == IO_PWM ? this->setPwm(100, 0) : (this->_level(true), true);
+  } else if (len == 3 && strncasecmp(data, "off", 3) == 0) {
+    return this->_name == IO_PWM ? this->setPwm(0, 0) : (this->_level(false), true);
+  }
+  return this->setFloat(atof(data));
+}
+
+bool DigitalOutIOHub::setObject(JsonObjectConst params) {
+  if (params["period"].is<uint32_t>()) {
+    return this->setPattern(params["period"].as<uint32_t>(), params["duty"] | 50.0f, params["count"] | 0u);
+  }
+  if (params["duty"].is<float>() || params["freq"].is<float>()) {
+    return this->setPwm(params["duty"] | 0.0f, params["freq"] | 0.0f);
+  }
+  return false;
+}
 
-  // 忽略大小写
-  char lowerVal[16];
-  strncpy(lowerVal, arg, sizeof(lowerVal) - 1);
-  lowerVal[sizeof(lowerVal) - 1] = '\0';
-  for (char *ch = lowerVal; *ch != '\0'; ch++) {
-    *ch = tolower(*ch);
+bool DigitalOutIOHub::setPwm(float duty, float freq) {
+  // 已在输出PWM时只更新占空比/频率，不释放LEDC通道，避免每次调节都重新接管引脚产生毛刺
+  this->_stopBlink();
+  if (freq > 0) {
+    this->_freq = constrain(freq, PWM_FREQ_MIN, PWM_FREQ_MAX);
+  }
+  duty = constrain(duty, 0.0f, 100.0f) / 100.0f;
+  if (this->_pwm == nullptr) {
+    // 使用ESP32Servo的LEDC通道分配，不与舵机冲突
+    this->_pwm = new ESP32PWM();
   }
-  // 判断控制命令
-  if (strcmp(lowerVal, "on") == 0) {
-    outLevel = HIGH;
-  } else if (strcmp(lowerVal, "off") == 0) {
-    outLevel = LOW;
+  if (!this->_pwm->attached()) {
+    portENTER_CRITICAL(&this->_mux);
+    this->_ledc = true;
+    portEXIT_CRITICAL(&this->_mux);
+    this->_pwm->attachPin(this->_pin, this->_freq, PWM_RESOLUTION_BITS);
+    this->_pwm->writeScaled(duty);
+  } else if (freq > 0) {
+    this->_pwm->adjustFrequency(this->_freq, duty);
   } else {
-    float val = atof(lowerVal);
-    if (val == 1.0f) {
-      outLevel = HIGH;
+    this->_pwm->writeScaled(duty);
+  }
+  return true;
+}
+
+/**
+ * @brief 闪烁输出
+ *
+ * @details 高低电平各用一次单次定时，回调中翻转电平并按对应时长重新定时，
+ *          占空比为0或100%时退化为固定电平。
+ */
+bool DigitalOutIOHub::setPattern(uint32_t periodMs, float duty, uint32_t count) {
+  duty = constrain(duty, 0.0f, 100.0f);
+  uint32_t onUs = (uint32_t)(periodMs * 10.0f * duty);
+  uint32_t offUs = periodMs * 1000 - onUs;
+  if (onUs == 0 || offUs == 0) {
+    this->_level(onUs > 0);
+    return true;
+  }
+  this->_level(true);
+  if (this->_timer == NULL) {
+    esp_timer_create_args_t args = {};
+    args.callback = _tick;
+    args.arg = this;
+    args.name = "pattern";
+    if (esp_timer_create(&args, &this->_timer) != ESP_OK) {
+      return false;
+    }
+  }
+  portENTER_CRITICAL(&this->_mux);
+  this->_onUs = onUs;
+  this->_offUs = offUs;
+  this->_cycles = count;
+  this->_high = true;
+  this->_blinking = true;
+  esp_err_t err = this->_arm(onUs);
+  portEXIT_CRITICAL(&this->_mux);
+  if (err != ESP_OK) {
+    printf("[Error]P%u: pattern timer start failed (%d)\n", this->_ioIdx, err);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 按当前代启动单次定时，需持有_mux
+ * @return esp_err_t 定时器启动结果，失败时停止闪烁
+ */
+esp_err_t DigitalOutIOHub::_arm(uint32_t us) {
+  this->_armedGen = this->_gen;
+  this->_dueUs = esp_timer_get_time() + us;
+  esp_err_t err = esp_timer_start_once(this->_timer, us);
+  if (err != ESP_OK) {
+    this->_blinking = false;
+  }
+  return err;
+}
+
+/**
+ * @brief 闪烁定时器回调
+ *
+ * @details 在esp_timer任务中运行，可能与停止、重新设置闪烁的任务同时执行（双核），
+ *          翻转电平和重新定时都在_mux内完成。以下回调直接丢弃：
+ *          已停止或切换为PWM输出的；停止之后才执行的上一代定时（代号不符）；
+ *          停止前已派发、重新定时后才执行的旧回调（早于本次定时的到期时刻）。
+ */
+void DigitalOutIOHub::_tick(void *arg) {
+  DigitalOutIOHub *self = (DigitalOutIOHub *)arg;
+  esp_err_t err = ESP_OK;
+  portENTER_CRITICAL(&self->_mux);
+  if (self->_blinking && !self->_ledc && self->_armedGen == self->_gen && esp_timer_get_time() >= self->_dueUs) {
+    self->_high = !self->_high;
+    digitalWrite(self->_pin, self->_high ? HIGH : LOW);
+    if (!self->_high && self->_cycles > 0 && --self->_cycles == 0) {
+      self->_blinking = false;
+    } else {
+      err = self->_arm(self->_high ? self->_onUs : self->_offUs);
     }
   }
-  digitalWrite(this->_pin, outLevel);
+  portEXIT_CRITICAL(&self->_mux);
+  if (err != ESP_OK) {
+    printf("[Error]P%u: pattern timer restart failed (%d)\n", self->_ioIdx, err);
+  }
+}
+
+/**
+ * @brief 停止闪烁，不影响LEDC输出
+ *
+ * @details 先在_mux内结束当前代，之后已在执行或稍后执行的回调都不会再写引脚或重新定时
+ */
+void DigitalOutIOHub::_stopBlink() {
+  portENTER_CRITICAL(&this->_mux);
+  this->_blinking = false;
+  this->_gen++;
+  portEXIT_CRITICAL(&this->_mux);
+  if (this->_timer != NULL) {
+    esp_timer_stop(this->_timer);
+  }
+}
+
+/**
+ * @brief 停止PWM和闪烁，引脚回到普通输出
+ */
+void DigitalOutIOHub::_stop() {
+  this->_stopBlink();
+  if (this->_pwm != nullptr && this->_pwm->attached()) {
+    this->_pwm->detachPin(this->_pin);
+  }
+  portENTER_CRITICAL(&this->_mux);
+  this->_ledc = false;
+  portEXIT_CRITICAL(&this->_mux);
+}
+
+void DigitalOutIOHub::_level(bool high) {
+  this->_stop();
+  pinMode(this->_pin, OUTPUT);
+  digitalWrite(this->_pin, high ? HIGH : LOW);
+}
+
+void RmtDHTIOHub::init() {
+  this->_slot = rmtDHT.add(this->_pin, this->_name == IO_DHT22 ? RMT_DHT22 : RMT_DHT11);
+  if (this->_slot < 0) {
+    printf("[Error]P%u: no free RMT channel for DHT\n", this->_ioIdx);
+  }
+}
+
+static const char kDht11HumiKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_dht11_humi"))] = {
+    JSON_KEY("p1_dht11_humi"), JSON_KEY("p2_dht11_humi"), JSON_KEY("p3_dht11_humi"),
+    JSON_KEY("p4_dht11_humi"), JSON_KEY("p5_dht11_humi"), JSON_KEY("p6_dht11_humi")};
+static const char kDht11TempKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_dht11_temp"))] = {
+    JSON_KEY("p1_dht11_temp"), JSON_KEY("p2_dht11_temp"), JSON_KEY("p3_dht11_temp"),
+    JSON_KEY("p4_dht11_temp"), JSON_KEY("p5_dht11_temp"), JSON_KEY("p6_dht11_temp")};
+static const char kDht22HumiKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_dht22_humi"))] = {
+    JSON_KEY("p1_dht22_humi"), JSON_KEY("p2_dht22_humi"), JSON_KEY("p3_dht22_humi"),
+    JSON_KEY("p4_dht22_humi"), JSON_KEY("p5_dht22_humi"), JSON_KEY("p6_dht22_humi")};
+static const char kDht22TempKeys[IO_PORT_NUM][sizeof(JSON_KEY("p1_dht22_temp"))] = {
+    JSON_KEY("p1_dht22_temp"), JSON_KEY("p2_dht22_temp"), JSON_KEY("p3_dht22_temp"),
+    JSON_KEY("p4_dht22_temp"), JSON_KEY("p5_dht22_temp"), JSON_KEY("p6_dht22_temp")};
+
+void RmtDHTIOHub::callback(const char *arg) {
+  bool dht22 = this->_name == IO_DHT22;
+  const auto &humiKey = (dht22 ? kDht22HumiKeys : kDht11HumiKeys)[this->_ioIdx - 1];
+  const auto &tempKey = (dht22 ? kDht22TempKeys : kDht11TempKeys)[this->_ioIdx - 1];
+  float temperature, humidity;
+  char buf[64];
+  JsonFrame frame(buf, sizeof(buf));
+  if (rmtDHT.get(this->_slot, &temperature, &humidity)) {
+    frame.real(humiKey, humidity, 1);
+    frame.real(tempKey, temperature, 1);
+  } else {
+    frame.text(humiKey, "NAN");
+    frame.text(tempKey, "NAN");
+  }
+  this->_JsonStr = frame.c_str();
 }
 
 void DHT11IOHub::init() {
@@ -244,13 +663,50 @@ void Servo180IOHub::callback(const char *arg) {
   if (arg == nullptr) {
     return;
   }
-  int angle = atoi(arg);
-  // 限制角度范围为 0 到 180 度
-  angle = constrain(angle, 0, 180);
+  this->setInt(atoi(arg));
+}
+
+bool Servo180IOHub::setBytes(const char *data, size_t len) { return this->setFloat(atof(data)); }
+
+bool Servo180IOHub::setInt(int32_t angle) { return this->setFloat((float)angle); }
+
+bool Servo180IOHub::setFloat(float angle) {
+  // 限制角度范围为 0 到 180 度，立即到位
+  this->_motion.jump(constrain(angle, 0.0f, 180.0f));
+  this->_write(this->_motion.position());
+  return true;
+}
+
+bool Servo180IOHub::setMotion(float target, float speed, float accel) {
+  target = constrain(target, 0.0f, 180.0f);
+  if (!this->_placed) {
+    // 上电后实际角度未知，第一次直接到位
+    return this->setFloat(target);
+  }
+  this->_motion.start(target, speed > 0 ? speed : SERVO_DEFAULT_SPEED, accel > 0 ? accel : SERVO_DEFAULT_ACCEL);
+  this->_lastUs = esp_timer_get_time();
+  return true;
+}
+
+bool Servo180IOHub::update(int64_t nowUs) {
+  if (!this->_motion.moving()) {
+    return false;
+  }
+  bool moving = this->_motion.step((nowUs - this->_lastUs) * 1e-6f);
+  this->_lastUs = nowUs;
+  this->_write(this->_motion.position());
+  return moving;
+}
+
+/**
+ * @brief 按角度输出脉宽，直接写微秒以保留小数角度，运动更平滑
+ */
+void Servo180IOHub::_write(float angle) {
   if (!this->_servo->attached()) {
-    this->_servo->attach(this->_pin);
+    this->_servo->attach(this->_pin, SERVO_US_LOW, SERVO_US_HIGH);
   }
-  this->_servo->write(angle);
+  this->_servo->writeMicroseconds(lroundf(SERVO_US_LOW + (SERVO_US_HIGH - SERVO_US_LOW) * angle / 180.0f));
+  this->_placed = true;
 }
 
 void Servo360IOHub::init() { this->_servo = new Servo(); }
@@ -259,12 +715,41 @@ void Servo360IOHub::callback(const char *arg) {
   if (arg == nullptr) {
     return;
   }
-  int speed = atoi(arg);
-  printf("SPEED: %d\n", speed);
-  // 解析速度值并限制在有效范围内
-  speed = constrain(speed, -100, 100);
-  printf("con SPEED: %d\n", speed);
+  this->setInt(atoi(arg));
+}
+
+bool Servo360IOHub::setBytes(const char *data, size_t len) { return this->setInt(atoi(data)); }
+
+bool Servo360IOHub::setInt(int32_t speed) { return this->setFloat((float)speed); }
+
+bool Servo360IOHub::setFloat(float speed) {
+  // 速度值限制在有效范围内，立即生效
+  this->_motion.jump(constrain(speed, -100.0f, 100.0f));
+  this->_write(this->_motion.position());
+  return true;
+}
+
+/**
+ * @brief 连续旋转舵机的运动指令：目标为速度（-100~100），按accel（%/秒）线性变速，speed不使用
+ */
+bool Servo360IOHub::setMotion(float target, float speed, float accel) {
+  // 加速度取极大值，曲线退化为以accel为速率的线性变化
+  this->_motion.start(constrain(target, -100.0f, 100.0f), accel > 0 ? accel : SERVO360_DEFAULT_RAMP, 1e6f);
+  this->_lastUs = esp_timer_get_time();
+  return true;
+}
+
+bool Servo360IOHub::update(int64_t nowUs) {
+  if (!this->_motion.moving()) {
+    return false;
+  }
+  bool moving = this->_motion.step((nowUs - this->_lastUs) * 1e-6f);
+  this->_lastUs = nowUs;
+  this->_write(this->_motion.position());
+  return moving;
+}
 
+void Servo360IOHub::_write(float speed) {
   // 舵机中点（停止）微调值（某些舵机可能不是刚好1500us）
   const int center_us = 1500;
   const int min_us = 1000; // 全速反转
@@ -275,23 +760,25 @@ void Servo360IOHub::callback(const char *arg) {
     this->_servo->setPeriodHertz(50);                 // 设置频率为50Hz
     this->_servo->attach(this->_pin, min_us, max_us); // 设置范围
   }
-  int pulse_us;
+  float pulse_us;
 
-  if (abs(speed) <= dead_zone) {
+  if (fabsf(speed) <= dead_zone) {
     pulse_us = center_us; // 停止
   } else if (speed > 0) {
     // 正转映射：center_us ~ max_us
-    pulse_us = map(speed, dead_zone + 1, 100, center_us + 10, max_us); // 正转
+    pulse_us = (center_us + 10) + (speed - (dead_zone + 1)) * (max_us - center_us - 10) / (100 - dead_zone - 1);
   } else {
     // 反转映射：center_us ~ min_us
-    pulse_us = map(-speed, dead_zone + 1, 100, center_us - 10, min_us);
+    pulse_us = (center_us - 10) - (-speed - (dead_zone + 1)) * (center_us - 10 - min_us) / (100 - dead_zone - 1);
   }
-  this->_servo->writeMicroseconds(pulse_us);
+  this->_servo->writeMicroseconds(lroundf(pulse_us));
 }
 
 void WS2812IOHub::init() {
+  this->_lock = xSemaphoreCreateMutex();
+  this->_back = new uint8_t[this->_pixels * 3]();
   this->_led = new LiteLED(LED_TYPE, LED_TYPE_IS_RGBW);
-  this->_led->begin(this->_pin, MAX_PIXELS);
+  this->_led->begin(this->_pin, this->_pixels);
   this->_led->brightness(160);
 }
 
@@ -299,34 +786,118 @@ void WS2812IOHub::callback(const char *arg) {
   if (arg == nullptr) {
     return;
   }
-  char buf[512];
-  strncpy(buf, arg, sizeof(buf) - 1);
-  buf[sizeof(buf) - 1] = '\0'; // 确保字符串以空字符结尾
+  this->setBytes(arg, strlen(arg));
+}
 
-  uint8_t values[MAX_CHANNELS];
-  int idx = 0;
-  char *token = strtok(buf, " "); // 使用逗号分隔字符串
-  while (token != NULL && idx < MAX_CHANNELS) {
-    values[idx++] = atoi(token); // 将字符串转换为整数
-    token = strtok(NULL, " ");   // 继续分割字符串
+/**
+ * @brief 字符串指令："b64:"开头为base64编码的二进制帧，否则为空格分隔的R G B值，从第0个像素开始
+ */
+bool WS2812IOHub::setBytes(const char *data, size_t len) {
+  if (len > 4 && strncmp(data, "b64:", 4) == 0) {
+    size_t cap = (len - 4) / 4 * 3 + 1;
+    if (cap > this->_scratchCap) {
+      delete[] this->_scratch;
+      this->_scratch = new uint8_t[cap];
+      this->_scratchCap = cap;
+    }
+    int n = mg_base64_decode(data + 4, (int)(len - 4), (char *)this->_scratch);
+    return n > 0 && this->setFrame(this->_scratch, n);
   }
 
-  int pixelCount = idx / 3; // 每个像素有3个值（RGB）
-  if (pixelCount > MAX_PIXELS) {
-    pixelCount = MAX_PIXELS; // 限制像素数量
+  xSemaphoreTake(this->_lock, portMAX_DELAY);
+  this->_fx.stop();
+  // 原地逐个解析数值，不复制、不限制长度
+  uint32_t ch = 0, channels = this->_pixels * 3;
+  const char *p = data;
+  while (ch < channels) {
+    char *next;
+    long v = strtol(p, &next, 10);
+    if (next == p) {
+      break;
+    }
+    this->_back[ch++] = (uint8_t)v;
+    p = next;
   }
+  this->_mark(0, ch / 3);
+  this->_swap();
+  xSemaphoreGive(this->_lock);
+  return true;
+}
 
-  for (int i = 0; i < pixelCount; i++) {
-    uint8_t r = values[i * 3];     // R
-    uint8_t g = values[i * 3 + 1]; // G
-    uint8_t b = values[i * 3 + 2]; // B
-    crgb_t color = (r << 16) | (g << 8) | b; // 组合颜色值
-    this->_led->setPixel(i, color, false); // 设置像素颜色不自动 show
+bool WS2812IOHub::setFrame(const uint8_t *data, size_t len) {
+  if (len < WS2812_FRAME_HEADER) {
+    return false;
+  }
+  uint8_t flags = data[0];
+  uint16_t offset = (data[1] << 8) | data[2];
+  uint16_t count = (data[3] << 8) | data[4];
+  if (len - WS2812_FRAME_HEADER < (size_t)count * 3 || offset >= this->_pixels) {
+    return false;
+  }
+  // 超出灯带长度的部分丢弃
+  if (count > this->_pixels - offset) {
+    count = this->_pixels - offset;
   }
+  xSemaphoreTake(this->_lock, portMAX_DELAY);
+  this->_fx.stop();
+  memcpy(this->_back + offset * 3, data + WS2812_FRAME_HEADER, count * 3);
+  this->_mark(offset, offset + count);
+  if (flags & WS2812_FRAME_SHOW) {
+    this->_swap();
+  }
+  xSemaphoreGive(this->_lock);
+  return true;
+}
 
-  this->_led->show(); // 一次性更新所有像素
+bool WS2812IOHub::setEffect(const LedEffect &fx) {
+  xSemaphoreTake(this->_lock, portMAX_DELAY);
+  this->_fx = fx;
+  xSemaphoreGive(this->_lock);
+  return true;
+}
+
+/**
+ * @brief 渲染一帧效果到后台缓冲区并刷新，静态效果渲染一次后停止
+ */
+bool WS2812IOHub::animate(uint32_t nowMs) {
+  xSemaphoreTake(this->_lock, portMAX_DELAY);
+  bool running = this->_fx.active();
+  if (running) {
+    running = this->_fx.render(this->_back, this->_pixels, nowMs);
+    if (!running) {
+      this->_fx.stop();
+    }
+    this->_mark(0, this->_pixels);
+    this->_swap();
+  }
+  xSemaphoreGive(this->_lock);
+  return running;
+}
+
+void WS2812IOHub::_mark(uint16_t lo, uint16_t hi) {
+  if (lo >= hi) {
+    return;
+  }
+  if (this->_dirtyLo >= this->_dirtyHi) {
+    this->_dirtyLo = lo;
+    this->_dirtyHi = hi;
+  } else {
+    this->_dirtyLo = min(this->_dirtyLo, lo);
+    this->_dirtyHi = max(this->_dirtyHi, hi);
+  }
+}
 
-  this->_JsonStr = "OK " + String(pixelCount) + " LEDs on pin " + String(this->_pin) + "\n";
+/**
+ * @brief 后台缓冲区中变化的像素写入LiteLED并刷新灯带
+ */
+void WS2812IOHub::_swap() {
+  for (uint16_t i = this->_dirtyLo; i < this->_dirtyHi; i++) {
+    const uint8_t *rgb = this->_back + i * 3;
+    crgb_t color = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2]; // 组合颜色值
+    this->_led->setPixel(i, color, false);                   // 设置像素颜色不自动 show
+  }
+  this->_dirtyLo = this->_dirtyHi = 0;
+  this->_led->show(); // 一次性更新所有像素
 }
 
 void Servo300IOHub::init() { this->_servo = new Servo(); }
@@ -335,15 +906,50 @@ void Servo300IOHub::callback(const char *arg) {
   if (arg == nullptr) {
     return;
   }
-  
-  int angle = atoi(arg);
-  // 限制角度范围为 0 到 300 度
-  angle = constrain(angle, 0, 300);
-  printf("ANGLE: %d\n", angle);
+  this->setInt(atoi(arg));
+}
+
+bool Servo300IOHub::setBytes(const char *data, size_t len) { return this->setFloat(atof(data)); }
+
+bool Servo300IOHub::setInt(int32_t angle) { return this->setFloat((float)angle); }
+
+bool Servo300IOHub::setFloat(float angle) {
+  // 限制角度范围为 0 到 300 度，立即到位
+  this->_motion.jump(constrain(angle, 0.0f, 300.0f));
+  this->_write(this->_motion.position());
+  return true;
+}
+
+bool Servo300IOHub::setMotion(float target, float speed, float accel) {
+  target = constrain(target, 0.0f, 300.0f);
+  if (!this->_placed) {
+    // 上电后实际角度未知，第一次直接到位
+    return this->setFloat(target);
+  }
+  this->_motion.start(target, speed > 0 ? speed : SERVO_DEFAULT_SPEED, accel > 0 ? accel : SERVO_DEFAULT_ACCEL);
+  this->_lastUs = esp_timer_get_time();
+  return true;
+}
+
+bool Servo300IOHub::update(int64_t nowUs) {
+  if (!this->_motion.moving()) {
+    return false;
+  }
+  bool moving = this->_motion.step((nowUs - this->_lastUs) * 1e-6f);
+  this->_lastUs = nowUs;
+  this->_write(this->_motion.position());
+  return moving;
+}
+
+void Servo300IOHub::_write(float angle) {
   // 进行角度的转化，实际测试中发现发送的角度和实际转动角度有误差
-  angle = (float)angle / 3.0 * 2;
+  float deg = angle / 3.0f * 2;
+  if (deg > 180.0f) {
+    deg = 180.0f;
+  }
   if (!this->_servo->attached()) {
-    this->_servo->attach(this->_pin);
+    this->_servo->attach(this->_pin, SERVO_US_LOW, SERVO_US_HIGH);
   }
-  this->_servo->write(angle);
-}
+  this->_servo->writeMicroseconds(lroundf(SERVO_US_LOW + (SERVO_US_HIGH - SERVO_US_LOW) * deg / 180.0f));
+  this->_placed = true;
+}
\ No newline at end of file
@@ -13,6 +13,12 @@
 #include "DHTesp.h"
 #include "DFRobot_DHT11.h"
 #include "IDFDHT11.h"
+#include "RmtDHT.h"
+#include "LedEffect.h"
+#include "AnalogSampler.h"
+#include "EMGFilters.h"
+#include "DFRobot_Heartrate.h"
+#include "esp_timer.h"
 
 
 /**
@@ -31,6 +37,11 @@ typedef enum
     IO_SERVO180,    ///< 180度舵机
     IO_SERVO360,    ///< 360度连续旋转舵机
     IO_SERVO300,    ///< 300度舵机
+    IO_PWM,         ///< PWM输出（LEDC）
+    IO_PATTERN,     ///< 闪烁输出（ESP定时器）
+    IO_EMG,         ///< 肌电信号（1kHz DMA采样）
+    IO_HEARTRATE,   ///< 心率传感器（后台50Hz采样）
+    IO_DHT22,       ///< DHT22温湿度传感器
 } SensorName;
 
 
@@ -40,10 +51,74 @@ typedef enum{
 } SensorType;
 /** @brief 最大支持的WS2812灯带数量 */
 #define MAX_STRIPS IO_PORT_NUM
-#define MAX_PIXELS 36
+#define WS2812_DEFAULT_PIXELS 36 ///< 未配置P<n>_Pixels时的灯珠数
+#define WS2812_MAX_PIXELS 1024    ///< 可配置的最大灯珠数
 #define LED_TYPE LED_STRIP_WS2812
 #define LED_TYPE_IS_RGBW 0
-#define MAX_CHANNELS (MAX_PIXELS * 3)
+
+/**
+ * @brief WS2812二进制帧格式
+ *
+ * @details [flags:1][offset:2][count:2][R G B]*count，offset/count为大端像素序号/像素数。
+ *          数据写入后台缓冲区，flags含WS2812_FRAME_SHOW时刷新到灯带，
+ *          一帧可分多条消息局部更新，最后一条置位SHOW。
+ *          通过 topic_output/p<n> 发送原始字节，或在JSON指令中以 "b64:<base64>" 字符串发送。
+ */
+#define WS2812_FRAME_HEADER 5
+#define WS2812_FRAME_SHOW 0x01
+
+#define PWM_FREQ_DEFAULT 1000       ///< PWM默认频率（Hz）
+#define PWM_FREQ_MIN 100            ///< 10位分辨率下LEDC可达的频率范围
+#define PWM_FREQ_MAX 40000
+#define PWM_RESOLUTION_BITS 10
+
+#define HR_SAMPLE_HZ 50             ///< 心率采样率（DFRobot_Heartrate按20ms间隔设计）
+#define HR_VALID_MS 3000            ///< 超过该时间没有有效心率/心跳时降低质量标志
+
+#define SERVO_US_LOW 544            ///< 0度脉宽（与ESP32Servo默认值一致）
+#define SERVO_US_HIGH 2400          ///< 180度脉宽
+#define SERVO_DEFAULT_SPEED 180.0f  ///< 运动指令未给出速度时的最大速度（度/秒）
+#define SERVO_DEFAULT_ACCEL 360.0f  ///< 运动指令未给出加速度时的加速度（度/秒²）
+#define SERVO360_DEFAULT_RAMP 200.0f ///< 连续旋转舵机未给出加速度时的速度变化率（%/秒）
+
+/**
+ * @brief 梯形速度曲线
+ *
+ * @details 由执行器任务按固定周期推进：剩余距离不足以按最大加速度减速到0时减速，
+ *          否则加速到最大速度后匀速。运动中收到新目标时从当前位置和速度平滑过渡。
+ */
+class MotionProfile {
+public:
+    /**
+     * @brief 开始向目标运动
+     * @param target 目标位置
+     * @param speed 最大速度（单位/秒）
+     * @param accel 加速度（单位/秒²）
+     */
+    void start(float target, float speed, float accel);
+
+    /** @brief 立即到达位置，停止运动 */
+    void jump(float pos);
+
+    /**
+     * @brief 推进一个周期
+     * @param dt 周期（秒）
+     * @return true 仍在运动
+     */
+    bool step(float dt);
+
+    float position() const { return _pos; }
+
+    bool moving() const { return _moving; }
+
+private:
+    float _pos = 0;
+    float _vel = 0;
+    float _target = 0;
+    float _vmax = 0;
+    float _amax = 0;
+    bool _moving = false;
+};
 
 class IOHub {
 public:
@@ -51,6 +126,43 @@ public:
     ~IOHub() {}
     virtual void init() = 0;
     virtual void callback(const char *arg = nullptr) = 0;
+
+    /**
+     * @brief 类型化控制指令，由SmartIOManager按JSON值类型直接调用，不经过字符串转换
+     * @return false 该IO不接受此类型的指令
+     */
+    virtual bool setInt(int32_t value) { return false; }
+    virtual bool setFloat(float value) { return this->setInt((int32_t)lroundf(value)); }
+    virtual bool setBytes(const char *data, size_t len) { return false; }
+    /** @brief 二进制数据指令（原始字节主题） */
+    virtual bool setFrame(const uint8_t *data, size_t len) { return false; }
+    /** @brief IO口特有的对象指令（如PWM、闪烁参数） */
+    virtual bool setObject(JsonObjectConst params) { return false; }
+    /** @brief 灯带效果指令，由效果任务周期调用animate()渲染 */
+    virtual bool setEffect(const LedEffect &fx) { return false; }
+
+    /**
+     * @brief 渲染一帧效果
+     * @param nowMs 当前时刻（毫秒）
+     * @return true 效果仍在运行，需要继续周期调用
+     */
+    virtual bool animate(uint32_t nowMs) { return false; }
+
+    /**
+     * @brief 运动指令：按梯形速度曲线运动到目标，由执行器任务周期调用update()推进
+     * @param target 目标位置
+     * @param speed 最大速度，<=0 使用默认值
+     * @param accel 加速度，<=0 使用默认值
+     */
+    virtual bool setMotion(float target, float speed, float accel) { return false; }
+
+    /**
+     * @brief 推进运动并更新输出
+     * @param nowUs 当前单调时钟（微秒）
+     * @return true 仍在运动，需要继续周期调用
+     */
+    virtual bool update(int64_t nowUs) { return false; }
+
     String getDataJsonStr() {return this->_JsonStr;}
     void setPin(uint8_t pin) { this->_pin = pin; }
     void setName(SensorName name) { this->_name = name; }
@@ -78,25 +190,176 @@ public:
     void callback(const char *arg = nullptr) override;
 };
 
+/**
+ * @brief 模拟输入
+ *
+ * @details ADC1引脚由AnalogSampler以DMA连续采样，每个采集周期按 P<n>_Filter 输出周期内的
+ *          平均/最小/最大/均方根/最新值；ADC2引脚仍在采集时analogRead单次读取。
+ *          输出值为0~1（原始值/4096）。
+ */
 class AnalogIOHub : public IOHub {
 public:
     AnalogIOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_ANALOG, SensorType type=IO_GRAB):IOHub(pin, ioIdx, name, type){}
     ~AnalogIOHub() {}
     void init() override; 
     void callback(const char *arg = nullptr) override;
+
+    /**
+     * @brief 设置取值方式，init()前调用
+     * @param filter 取值方式
+     */
+    void setFilter(AnalogFilter filter) { _filter = filter; }
+
+private:
+    AnalogFilter _filter = ANALOG_AVG;
+    int _slot = -1;
+};
+
+/**
+ * @brief 肌电信号输入
+ *
+ * @details 由AnalogSampler以1kHz连续采样（只支持ADC1引脚P1~P4），读取任务每批样本
+ *          经EMGFilters（工频陷波 + 150Hz低通 + 20Hz高通）块处理后累加，
+ *          每个采集周期输出周期内的包络（平均绝对值）和均方根，单位为ADC原始值。
+ *          工频由 P<n>_Notch 配置（50 | 60），默认50。
+ */
+class EMGIOHub : public IOHub {
+public:
+    EMGIOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_EMG, SensorType type=IO_GRAB):IOHub(pin, ioIdx, name, type){}
+    ~EMGIOHub() {}
+    void init() override;
+    void callback(const char *arg = nullptr) override;
+
+    /** @brief 设置工频陷波频率，init()前调用 */
+    void setNotch(NOTCH_FREQUENCY notch) { _notch = notch; }
+
+private:
+    EMGFilters _filters;
+    NOTCH_FREQUENCY _notch = NOTCH_FREQ_50HZ;
+    int _slot = -1;
+    uint32_t _count = 0;
+    uint64_t _sumAbs = 0;
+    uint64_t _sumSq = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    static void _sink(void *ctx, const uint16_t *samples, size_t count);
 };
 
+/**
+ * @brief 心率传感器（模拟输出型）
+ *
+ * @details 采样与上报间隔无关，在后台以HR_SAMPLE_HZ持续进行，每个样本到达时
+ *          由DFRobot_Heartrate增量检测心跳：
+ *          - ADC1引脚（P1~P4）使用AnalogSampler的DMA样本流，按块平均抽取到HR_SAMPLE_HZ
+ *          - ADC2引脚（P5、P6）由周期ESP定时器analogRead采样
+ *          采集周期只读取结果，不阻塞传感器任务。输出心率和质量标志：
+ *          2 心率有效；1 检测到心跳但间隔不稳定，心率不可信；0 无信号，心率为0
+ */
+class HeartRateIOHub : public IOHub {
+public:
+    HeartRateIOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_HEARTRATE, SensorType type=IO_GRAB):IOHub(pin, ioIdx, name, type), _sensor(ANALOG_MODE){}
+    ~HeartRateIOHub();
+    void init() override;
+    void callback(const char *arg = nullptr) override;
+
+private:
+    DFRobot_Heartrate _sensor;
+    int _slot = -1;
+    esp_timer_handle_t _timer = NULL;
+    uint32_t _decim = 0;  // DMA样本抽取倍数，首个样本块到达时按实际采样率确定
+    uint32_t _acc = 0;
+    uint32_t _accN = 0;
+    uint64_t _raw = 0;    // 已接收的DMA样本数，用于计算样本时刻
+    uint32_t _samples = 0;
+    uint16_t _bpm = 0;
+    uint32_t _nowMs = 0;
+    uint32_t _goodMs = 0;
+    uint32_t _beatMs = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    void _push(uint16_t sample, uint32_t timeMs);
+    static void _sink(void *ctx, const uint16_t *samples, size_t count);
+    static void _tick(void *arg);
+};
+
+/**
+ * @brief 数字输出
+ *
+ * @details 三种模式由配置 P<n> 选择，决定数值指令的含义：
+ *          - output：1为高电平，其他为低电平
+ *          - pwm：占空比（0~100%），由LEDC硬件输出
+ *          - pattern：闪烁周期（毫秒，占空比50%，持续闪烁），0为关闭，由ESP定时器翻转电平
+ *          任何模式都接受 "on"/"off" 和对象指令：
+ *          {"duty":50,"freq":1000} 切换为PWM输出；{"period":500,"duty":20,"count":3} 闪烁count次（0为持续）
+ */
 class DigitalOutIOHub : public IOHub {
 public:
     DigitalOutIOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_DIGITAL_OUT, SensorType type=IO_GRAB):IOHub(pin, ioIdx, name, type){}
-    ~DigitalOutIOHub() {}
+    ~DigitalOutIOHub();
+    void init() override;
+    void callback(const char *arg = nullptr) override;
+    bool setInt(int32_t value) override;
+    bool setFloat(float value) override;
+    bool setBytes(const char *data, size_t len) override;
+    bool setObject(JsonObjectConst params) override;
+
+    /**
+     * @brief LEDC PWM输出
+     * @param duty 占空比（0~100%）
+     * @param freq 频率（Hz），<=0 保持当前频率
+     */
+    bool setPwm(float duty, float freq);
+
+    /**
+     * @brief 闪烁输出
+     * @param periodMs 周期（毫秒）
+     * @param duty 高电平占比（0~100%）
+     * @param count 闪烁次数，0为持续
+     */
+    bool setPattern(uint32_t periodMs, float duty, uint32_t count);
+
+private:
+    ESP32PWM *_pwm = nullptr;
+    float _freq = PWM_FREQ_DEFAULT;
+    esp_timer_handle_t _timer = NULL;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED; // 保护闪烁状态、定时器回调中的引脚写入及重新定时
+    bool _blinking = false;
+    bool _ledc = false;      // 引脚由LEDC输出PWM，定时器回调不得写引脚
+    bool _high = false;      // 闪烁当前处于高电平阶段
+    uint32_t _onUs = 0;
+    uint32_t _offUs = 0;
+    uint32_t _cycles = 0;    // 剩余闪烁次数，0为持续
+    uint32_t _gen = 0;       // 每次停止加1，回调只处理当前代的定时
+    uint32_t _armedGen = 0;  // 最近一次定时所属的代
+    int64_t _dueUs = 0;      // 最近一次定时的到期时刻，早于该时刻执行的回调是已被取代的旧定时
+
+    void _level(bool high);
+    void _stop();
+    void _stopBlink();
+    esp_err_t _arm(uint32_t us);
+    static void _tick(void *arg);
+};
+
+/**
+ * @brief DHT11/DHT22温湿度传感器（RMT接收）
+ *
+ * @details 读取由RmtDHT的后台任务完成，采集时只取最近的有效结果，不轮询电平、不提升任务优先级。
+ *          超过DHT_STALE_MS没有有效读数时输出"NAN"。
+ */
+class RmtDHTIOHub : public IOHub {
+public:
+    RmtDHTIOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_DHT11, SensorType type=IO_GRAB):IOHub(pin, ioIdx, name, type){}
+    ~RmtDHTIOHub() {}
     void init() override;
     void callback(const char *arg = nullptr) override;
+
+private:
+    int _slot = -1;
 };
 
 /**
  * 这里有多个DHT11是因为dht11的时序比较严格，在这个系统中调度有点问题，无论使用哪种都会有概率出现错误数据，加锁目前也没有生效。
- * 目前用的是DHT11EspIOHub
+ * 目前用的是RmtDHTIOHub，以下几种软件时序实现保留备用
  */
 class DHT11IOHub : public IOHub {
 public:
@@ -161,9 +424,19 @@ public:
     ~Servo180IOHub() {  delete this->_servo;}
     void init() override;
     void callback(const char *arg = nullptr) override;
+    bool setInt(int32_t value) override;
+    bool setBytes(const char *data, size_t len) override;
+    bool setFloat(float value) override;
+    bool setMotion(float target, float speed, float accel) override;
+    bool update(int64_t nowUs) override;
 
 private:
     Servo *_servo; // 舵机实例
+    MotionProfile _motion; // 角度运动曲线
+    int64_t _lastUs = 0;   // 上次推进运动的时刻
+    bool _placed = false;  // 是否已输出过角度，之前的实际位置未知
+
+    void _write(float angle);
 };
 
 class Servo360IOHub : public IOHub {
@@ -172,20 +445,47 @@ public:
     ~Servo360IOHub() {  delete this->_servo;}
     void init() override;
     void callback(const char *arg = nullptr) override;
+    bool setInt(int32_t value) override;
+    bool setBytes(const char *data, size_t len) override;
+    bool setFloat(float value) override;
+    bool setMotion(float target, float speed, float accel) override;
+    bool update(int64_t nowUs) override;
 
 private:
     Servo *_servo; // 舵机实例
+    MotionProfile _motion; // 速度变化曲线
+    int64_t _lastUs = 0;   // 上次推进运动的时刻
+
+    void _write(float speed);
 };
 
 class WS2812IOHub : public IOHub {
 public:
     WS2812IOHub(uint8_t pin, uint8_t ioIdx, SensorName name=IO_WS2812, SensorType type=IO_CONTROL):IOHub(pin, ioIdx, name, type){}
-    ~WS2812IOHub() {  delete this->_led;}
+    ~WS2812IOHub() {  delete this->_led; delete[] this->_back; delete[] this->_scratch; vSemaphoreDelete(this->_lock);}
     void init() override;
     void callback(const char *arg = nullptr) override;
+    bool setBytes(const char *data, size_t len) override;
+    bool setFrame(const uint8_t *data, size_t len) override;
+    bool setEffect(const LedEffect &fx) override;
+    bool animate(uint32_t nowMs) override;
+
+    /** @brief 设置灯珠数，需在init()前调用 */
+    void setPixels(uint16_t pixels) { this->_pixels = constrain(pixels, 1, WS2812_MAX_PIXELS); }
 
 private:
-    LiteLED *_led; // LiteLED 实例
+    LiteLED *_led; // LiteLED 实例（前台缓冲区）
+    uint16_t _pixels = WS2812_DEFAULT_PIXELS;
+    uint8_t *_back = nullptr;    // 后台缓冲区，每像素RGB三字节
+    uint16_t _dirtyLo = 0;       // 后台缓冲区中待刷新的像素范围 [lo, hi)
+    uint16_t _dirtyHi = 0;
+    uint8_t *_scratch = nullptr; // base64解码缓冲区
+    size_t _scratchCap = 0;
+    LedEffect _fx;               // 当前效果，收到帧数据时停止
+    SemaphoreHandle_t _lock = NULL; // 指令任务与效果任务共用后台缓冲区和LiteLED
+
+    void _mark(uint16_t lo, uint16_t hi);
+    void _swap();
 };
 
 class Servo300IOHub : public IOHub {
@@ -194,9 +494,19 @@ public:
     ~Servo300IOHub() {  delete this->_servo;}
     void init() override;
     void callback(const char *arg = nullptr) override;
+    bool setInt(int32_t value) override;
+    bool setBytes(const char *data, size_t len) override;
+    bool setFloat(float value) override;
+    bool setMotion(float target, float speed, float accel) override;
+    bool update(int64_t nowUs) override;
 
 private:
     Servo *_servo; // 300度舵机实例
+    MotionProfile _motion; // 角度运动曲线
+    int64_t _lastUs = 0;   // 上次推进运动的时刻
+    bool _placed = false;  // 是否已输出过角度，之前的实际位置未知
+
+    void _write(float angle);
 };
 
 #endif
\ No newline at end of file
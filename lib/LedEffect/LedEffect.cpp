@@ -0,0 +1,230 @@
+/**
+ * @file    LedEffect.cpp
+ * @brief   WS2812灯带效果模块实现
+ */
+#include "LedEffect.h"
+
+FxSourceFn LedEffect::_source = NULL;
+volatile uint32_t LedEffect::_sourceUsedAt = 0;
+
+/** @brief 正弦表：sin8[i] = 127.5 + 127.5 * sin(2πi/256) */
+static const uint8_t sin8[256] = {
+    128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+    176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+    176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+     79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+     37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+     10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+      0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+     10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+     37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+     79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+};
+
+/** @brief 伽马表（γ=2.2），呼吸效果亮度按人眼感知线性变化 */
+static const uint8_t gamma8[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+static const struct {
+  const char *name;
+  LedEffect::Kind kind;
+} kEffects[] = {
+    {"solid", LedEffect::FX_SOLID},     {"gradient", LedEffect::FX_GRADIENT}, {"chase", LedEffect::FX_CHASE},
+    {"rainbow", LedEffect::FX_RAINBOW}, {"breathe", LedEffect::FX_BREATHE},   {"sensor", LedEffect::FX_SENSOR},
+};
+
+static inline void putPixel(uint8_t *rgb, uint16_t i, uint32_t color) {
+  rgb[i * 3] = color >> 16;
+  rgb[i * 3 + 1] = color >> 8;
+  rgb[i * 3 + 2] = color;
+}
+
+/** @brief 两种颜色按t/255混合 */
+static uint32_t blend(uint32_t a, uint32_t b, uint8_t t) {
+  uint32_t out = 0;
+  int w = t + (t >> 7); // 0~255 映射到 0~256，t=255时完全为b
+  for (int shift = 16; shift >= 0; shift -= 8) {
+    int ca = (a >> shift) & 0xFF, cb = (b >> shift) & 0xFF;
+    out |= (uint32_t)(ca + (((cb - ca) * w) >> 8)) << shift;
+  }
+  return out;
+}
+
+/** @brief 颜色亮度按level/255缩放 */
+static uint32_t scale(uint32_t color, uint8_t level) { return blend(0, color, level); }
+
+/** @brief 色相（0~255）转满饱和度颜色 */
+static uint32_t hue(uint8_t h) {
+  uint8_t region = h / 43;
+  uint8_t rise = (h - region * 43) * 6;
+  uint8_t fall = 255 - rise;
+  switch (region) {
+  case 0:
+    return 0xFF0000 | (rise << 8);
+  case 1:
+    return (fall << 16) | 0x00FF00;
+  case 2:
+    return 0x00FF00 | rise;
+  case 3:
+    return (fall << 8) | 0x0000FF;
+  case 4:
+    return (rise << 16) | 0x0000FF;
+  default:
+    return 0xFF0000 | fall;
+  }
+}
+
+/** @brief 解析颜色："#RRGGBB"、"RRGGBB" 或 [R,G,B] */
+static bool parseColor(JsonVariantConst v, uint32_t &out) {
+  if (v.is<const char *>()) {
+    const char *s = v.as<const char *>();
+    if (*s == '#') {
+      s++;
+    }
+    char *end;
+    uint32_t c = strtoul(s, &end, 16);
+    if (end == s + 6) {
+      out = c;
+      return true;
+    }
+  } else if (v.is<JsonArrayConst>() && v.size() == 3) {
+    out = ((v[0].as<uint32_t>() & 0xFF) << 16) | ((v[1].as<uint32_t>() & 0xFF) << 8) | (v[2].as<uint32_t>() & 0xFF);
+    return true;
+  }
+  return false;
+}
+
+bool LedEffect::parse(JsonObjectConst params) {
+  const char *fx = params["fx"];
+  if (fx == NULL) {
+    return false;
+  }
+  this->_kind = FX_NONE;
+  for (const auto &e : kEffects) {
+    if (strcasecmp(fx, e.name) == 0) {
+      this->_kind = e.kind;
+    }
+  }
+  if (this->_kind == FX_NONE) {
+    return false;
+  }
+  parseColor(params["color"], this->_color);
+  parseColor(params["color2"], this->_color2);
+  this->_speedQ8 = (int32_t)((params["speed"] | 1.0f) * 256);
+  this->_size = constrain(params["size"] | 3, 1, 1024);
+  strncpy(this->_field, params["source"] | "", sizeof(this->_field) - 1);
+  if (this->_kind == FX_SENSOR) {
+    // 字段名在多个设备中可能重复，必须指明设备
+    const char *dot = strchr(this->_field, '.');
+    if (dot == NULL || dot == this->_field || dot[1] == '\0') {
+      printf("[Info]fx sensor source must be <device>.<field>: %s\n", this->_field);
+      this->_kind = FX_NONE;
+      return false;
+    }
+  }
+  this->_min = params["min"] | 0.0f;
+  this->_max = params["max"] | 100.0f;
+  this->_sourced = false;
+  return true;
+}
+
+/**
+ * @brief 时间相位：每秒_speed个周期，一个周期为65536
+ */
+uint16_t LedEffect::_phase(uint32_t nowMs) { return (uint16_t)(((int64_t)nowMs * this->_speedQ8 * 256) / 1000); }
+
+/**
+ * @brief 渲染一帧
+ *
+ * @details 每帧只在开始处计算一次相位，逐像素部分全部为整数运算和查表。
+ */
+bool LedEffect::render(uint8_t *rgb, uint16_t pixels, uint32_t nowMs) {
+  uint8_t phase8 = this->_phase(nowMs) >> 8;
+  switch (this->_kind) {
+  case FX_SOLID:
+    for (uint16_t i = 0; i < pixels; i++) {
+      putPixel(rgb, i, this->_color);
+    }
+    return false;
+
+  case FX_GRADIENT:
+    if (this->_speedQ8 == 0) {
+      for (uint16_t i = 0; i < pixels; i++) {
+        putPixel(rgb, i, blend(this->_color, this->_color2, pixels > 1 ? i * 255 / (pixels - 1) : 0));
+      }
+      return false;
+    }
+    // 流动时按三角波往返，首尾颜色连续
+    for (uint16_t i = 0; i < pixels; i++) {
+      uint8_t t = (uint8_t)(i * 256 / pixels) + phase8;
+      putPixel(rgb, i, blend(this->_color, this->_color2, t < 128 ? t * 2 : (255 - t) * 2));
+    }
+    return true;
+
+  case FX_CHASE: {
+    // 速度为每秒像素数
+    uint32_t head = (uint32_t)(((int64_t)nowMs * this->_speedQ8 / 256000) % pixels + pixels) % pixels;
+    for (uint16_t i = 0; i < pixels; i++) {
+      putPixel(rgb, i, (i + pixels - head) % pixels < this->_size ? this->_color : this->_color2);
+    }
+    return true;
+  }
+
+  case FX_RAINBOW:
+    for (uint16_t i = 0; i < pixels; i++) {
+      putPixel(rgb, i, hue((uint8_t)(i * 256 / pixels) + phase8));
+    }
+    return true;
+
+  case FX_BREATHE: {
+    uint32_t color = scale(this->_color, gamma8[sin8[phase8]]);
+    for (uint16_t i = 0; i < pixels; i++) {
+      putPixel(rgb, i, color);
+    }
+    return true;
+  }
+
+  case FX_SENSOR: {
+    if (_source != NULL && (!this->_sourced || nowMs - this->_sourceAt >= FX_SOURCE_MS)) {
+      this->_sourced = true;
+      this->_sourceAt = nowMs;
+      _sourceUsedAt = nowMs | 1;
+      float v;
+      if (_source(this->_field, &v) && this->_max != this->_min) {
+        float t = (v - this->_min) / (this->_max - this->_min);
+        this->_level = t <= 0 ? 0 : t >= 1 ? 255 : (uint8_t)(t * 255);
+      }
+    }
+    uint32_t color = blend(this->_color, this->_color2, this->_level);
+    for (uint16_t i = 0; i < pixels; i++) {
+      putPixel(rgb, i, color);
+    }
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
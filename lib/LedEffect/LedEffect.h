@@ -0,0 +1,76 @@
+/**
+ * @file    LedEffect.h
+ * @brief   WS2812灯带效果模块头文件
+ *
+ * @details 灯带效果在设备端逐帧渲染，客户端只需发送一条指令：
+ *          {"p3":{"fx":"rainbow","speed":2}}
+ *          参数：
+ *          - fx: solid | gradient | chase | rainbow | breathe | sensor
+ *          - color / color2: "#RRGGBB" 或 [R,G,B]，默认白色/黑色
+ *          - speed: 每秒周期数（chase为每秒像素数），默认1
+ *          - size: chase亮段长度，默认3
+ *          - source / min / max: sensor效果的数据字段及映射范围，字段值从min到max对应color到color2；
+ *            source为 "<设备>.<字段>"，如 "bme280.Temperature"、"bmx160.acc.x"、"p1.input_val"
+ *          渲染只用整数运算和查表（正弦表、伽马表），时间相位按毫秒换算为16位定点数。
+ */
+#pragma once
+#include "global.h"
+
+#define FX_FRAME_MS 20      ///< 效果刷新周期（50帧/秒）
+#define FX_SOURCE_MS 200    ///< sensor效果读取数据的周期
+#define FX_SOURCE_LEN 32    ///< 数据字段名最大长度
+#define FX_SOURCE_HOLD_MS 1000 ///< 最近一次读取数据后，采集侧保留按设备数据的时长
+
+/**
+ * @brief 效果数据源：按 "<设备>.<字段>" 取该设备最新采样值
+ * @return false 设备或字段不存在，或不是数值
+ */
+typedef bool (*FxSourceFn)(const char *field, float *value);
+
+class LedEffect {
+public:
+    enum Kind : uint8_t { FX_NONE, FX_SOLID, FX_GRADIENT, FX_CHASE, FX_RAINBOW, FX_BREATHE, FX_SENSOR };
+
+    /**
+     * @brief 从JSON指令解析效果参数
+     * @param params 指令对象，必须包含"fx"
+     * @return false 效果名无效
+     */
+    bool parse(JsonObjectConst params);
+
+    /**
+     * @brief 渲染一帧
+     * @param rgb 输出缓冲区，每像素RGB三字节
+     * @param pixels 像素数
+     * @param nowMs 当前时刻（毫秒）
+     * @return true 效果随时间变化，需要继续逐帧渲染
+     */
+    bool render(uint8_t *rgb, uint16_t pixels, uint32_t nowMs);
+
+    bool active() const { return _kind != FX_NONE; }
+    void stop() { _kind = FX_NONE; }
+
+    /** @brief 设置sensor效果的数据源 */
+    static void setSource(FxSourceFn fn) { _source = fn; }
+
+    /** @brief 最近FX_SOURCE_HOLD_MS内是否有sensor效果读取过数据源 */
+    static bool sourceActive(uint32_t nowMs) { return _sourceUsedAt != 0 && nowMs - _sourceUsedAt < FX_SOURCE_HOLD_MS; }
+
+private:
+    Kind _kind = FX_NONE;
+    uint32_t _color = 0xFFFFFF;
+    uint32_t _color2 = 0x000000;
+    int32_t _speedQ8 = 256; // 速度，Q8定点数
+    uint16_t _size = 3;
+    char _field[FX_SOURCE_LEN] = {0};
+    float _min = 0;
+    float _max = 100;
+    uint8_t _level = 0;     // sensor效果当前映射值（0~255）
+    uint32_t _sourceAt = 0; // 上次读取数据的时刻
+    bool _sourced = false;
+
+    uint16_t _phase(uint32_t nowMs);
+
+    static FxSourceFn _source;
+    static volatile uint32_t _sourceUsedAt; // 最近一次读取数据源的时刻
+};
@@ -14,10 +14,11 @@
 #include "mqtt_client.h"
 #include "mqtt_publisher.h"
 #include "mqtt_subscriber.h"
+#include "mqtt_bridge.h"
 #include "mqtt_auth.h"
 const char *MOUNT_POINT = "/root";
 const char *TAG = "MQTTAPP";
-  TaskHandle_t broker_hanlde, pub_hanlde, sub_handle;
+  TaskHandle_t broker_hanlde, pub_hanlde, sub_handle, bridge_handle;
 void mqtt_server_init()
 {
 
@@ -45,6 +46,14 @@ void mqtt_server_init()
 
 	xTaskCreate(mqtt_publisher, "PUBLISH", 1024 * 5, (void *)cparam2, 6, &pub_hanlde);
 	vTaskDelay(10); // You need to wait until the task launch is complete.
+
+	/* Start Bridge, only when an upstream broker is configured */
+	if (mqtt_bridge_enabled()) {
+		char cparam3[64];
+		sprintf(cparam3, "mqtt://" IPSTR ":1883", IP2STR(&ip_info.ip));
+		xTaskCreate(mqtt_bridge, "BRIDGE", 1024 * 6, (void *)cparam3, 5, &bridge_handle);
+		vTaskDelay(10); // You need to wait until the task launch is complete.
+	}
 }
 void mqtt_server_delet()
 {
@@ -60,6 +69,10 @@ void mqtt_server_delet()
         vTaskDelete(pub_hanlde);
         pub_hanlde = NULL;
     }
+    if (bridge_handle) {
+        vTaskDelete(bridge_handle);
+        bridge_handle = NULL;
+    }
 }
 bool mqtt_server_status()
 {
@@ -0,0 +1,432 @@
+/* MQTT Broker Bridge
+
+   Forwards selected local topics to an upstream broker and selected
+   upstream topics to the local broker. Outbound messages are batched
+   into fewer TCP writes and queued in RAM, spilling to FFat while the
+   uplink is down.
+
+   This code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sys/stat.h>
+#include "esp_mac.h"
+
+#include "mqtt_bridge.h"
+#include "mqtt_auth.h"
+
+#define BRIDGE_RAM_SIZE (16 * 1024)				// RAM queue, records are spilled to FFat when full
+#define BRIDGE_MSG_MAX 2048						// Largest message the bridge queues
+#define BRIDGE_SPOOL_PATH "/ffat/bridge.spool"
+#define BRIDGE_SPOOL_MAX (256 * 1024)			// Spool file limit, newer messages are dropped above it
+#define BRIDGE_SPOOL_BLOCK 4096					// Read buffer while draining the spool
+#define BRIDGE_BATCH_BYTES 1024					// Flush the RAM queue once this much is waiting...
+#define BRIDGE_BATCH_MS 100						// ...or the oldest message waited this long
+#define BRIDGE_SEND_HIGH 4096					// Stop feeding the uplink while this much is unsent
+#define BRIDGE_RECONNECT_MS 5000
+#define BRIDGE_KEEPALIVE 60						// Upstream keep-alive, in seconds
+#define BRIDGE_ECHO_SLOTS 16					// Recently forwarded messages remembered for echo suppression
+#define BRIDGE_ECHO_MS 5000
+
+// Queue record header, followed by topic and data
+struct bridge_rec {
+	uint16_t topic_len;
+	uint16_t data_len;
+};
+
+struct bridge_echo {
+	uint32_t hash;
+	uint64_t expire_at;
+};
+
+static char s_url[MQTT_BRIDGE_STR_LEN];
+static char s_out[MQTT_BRIDGE_STR_LEN];
+static char s_in[MQTT_BRIDGE_STR_LEN];
+static char s_user[MQTT_BRIDGE_STR_LEN];
+static char s_pass[MQTT_BRIDGE_STR_LEN];
+static uint32_t s_rate = MQTT_BRIDGE_RATE_DEFAULT;
+
+static char s_local_url[64];
+static struct mg_connection *s_local;	// Connection to our own broker
+static struct mg_connection *s_up;		// Connection to the upstream broker
+static bool s_up_ready;					// Upstream CONNACK received
+static uint64_t s_local_retry_at;
+static uint64_t s_up_retry_at;
+static char s_client_id[32];
+
+// RAM ring of records
+static uint8_t *s_ram;
+static size_t s_ram_head;			// Read position
+static size_t s_ram_used;
+static uint32_t s_ram_count;
+static uint64_t s_ram_first_at;		// mg_millis() when the oldest RAM record was queued
+
+// FFat spool, records are always older than the RAM ones
+static long s_spool_rd;
+static long s_spool_size;
+
+static int64_t s_tokens;			// Drain rate bucket in 1/1000 units
+static uint64_t s_tokens_at;
+static struct bridge_echo s_echo[BRIDGE_ECHO_SLOTS];
+static uint8_t s_echo_next;
+static uint8_t s_scratch[sizeof(struct bridge_rec) + BRIDGE_MSG_MAX];
+
+static uint32_t s_forwarded, s_received, s_spooled, s_dropped, s_echoed;
+
+void mqtt_bridge_config(const char *url, const char *out, const char *in,
+	const char *user, const char *pass, uint32_t rate) {
+	snprintf(s_url, sizeof(s_url), "%s", url ? url : "");
+	snprintf(s_out, sizeof(s_out), "%s", out ? out : "");
+	snprintf(s_in, sizeof(s_in), "%s", in ? in : "");
+	snprintf(s_user, sizeof(s_user), "%s", user ? user : "");
+	snprintf(s_pass, sizeof(s_pass), "%s", pass ? pass : "");
+	s_rate = rate;
+}
+
+bool mqtt_bridge_enabled(void) {
+	return s_url[0] != '\0';
+}
+
+static uint32_t _bridge_hash(struct mg_str topic, struct mg_str data) {
+	uint32_t h = 2166136261u;	// FNV-1a
+	for (size_t i = 0; i < topic.len; i++) h = (h ^ (uint8_t) topic.ptr[i]) * 16777619u;
+	h = (h ^ 0xff) * 16777619u;
+	for (size_t i = 0; i < data.len; i++) h = (h ^ (uint8_t) data.ptr[i]) * 16777619u;
+	return h;
+}
+
+// Remember a message sent upstream, so its echo from the upstream broker is not re-injected
+static void _bridge_echo_add(struct mg_str topic, struct mg_str data) {
+	s_echo[s_echo_next].hash = _bridge_hash(topic, data);
+	s_echo[s_echo_next].expire_at = mg_millis() + BRIDGE_ECHO_MS;
+	s_echo_next = (s_echo_next + 1) % BRIDGE_ECHO_SLOTS;
+}
+
+static bool _bridge_echo_hit(struct mg_str topic, struct mg_str data) {
+	uint32_t hash = _bridge_hash(topic, data);
+	uint64_t now = mg_millis();
+	for (int i = 0; i < BRIDGE_ECHO_SLOTS; i++) {
+		if (s_echo[i].expire_at > now && s_echo[i].hash == hash) {
+			s_echo[i].expire_at = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Call fn for every filter of a comma separated list
+static void _bridge_each_filter(const char *list, struct mg_connection *c, uint8_t options,
+	void (*fn)(struct mg_connection *, struct mg_str, uint8_t)) {
+	const char *p = list;
+	while (*p != '\0') {
+		const char *end = strchr(p, ',');
+		if (end == NULL) end = p + strlen(p);
+		const char *q = end;
+		while (p < q && *p == ' ') p++;
+		while (q > p && q[-1] == ' ') q--;
+		if (q > p) fn(c, mg_str_n(p, (size_t) (q - p)), options);
+		p = *end == ',' ? end + 1 : end;
+	}
+}
+
+// SUBSCRIBE with raw options, mg_mqtt_sub() only carries the QoS
+static void _bridge_sub(struct mg_connection *c, struct mg_str topic, uint8_t options) {
+	uint8_t zero = 0;
+	uint32_t len = 2 + 2 + (uint32_t) topic.len + 1 + (c->is_mqtt5 ? 1 : 0);
+	mg_mqtt_send_header(c, MQTT_CMD_SUBSCRIBE, 2, len);
+	if (++c->mgr->mqtt_id == 0) ++c->mgr->mqtt_id;
+	uint16_t id = mg_htons(c->mgr->mqtt_id);
+	mg_send(c, &id, sizeof(id));
+	if (c->is_mqtt5) mg_send(c, &zero, sizeof(zero));
+	uint16_t topic_len = mg_htons((uint16_t) topic.len);
+	mg_send(c, &topic_len, sizeof(topic_len));
+	mg_send(c, topic.ptr, topic.len);
+	mg_send(c, &options, sizeof(options));
+	ESP_LOGI(pcTaskGetName(NULL), "SUBSCRIBED to %.*s", (int) topic.len, topic.ptr);
+}
+
+static void _bridge_ram_write(const void *buf, size_t len) {
+	size_t tail = (s_ram_head + s_ram_used) % BRIDGE_RAM_SIZE;
+	size_t first = len < BRIDGE_RAM_SIZE - tail ? len : BRIDGE_RAM_SIZE - tail;
+	memcpy(s_ram + tail, buf, first);
+	memcpy(s_ram, (const uint8_t *) buf + first, len - first);
+	s_ram_used += len;
+}
+
+static void _bridge_ram_read(void *buf, size_t offset, size_t len) {
+	size_t pos = (s_ram_head + offset) % BRIDGE_RAM_SIZE;
+	size_t first = len < BRIDGE_RAM_SIZE - pos ? len : BRIDGE_RAM_SIZE - pos;
+	memcpy(buf, s_ram + pos, first);
+	memcpy((uint8_t *) buf + first, s_ram, len - first);
+}
+
+// Copy the oldest RAM record into s_scratch and remove it
+static bool _bridge_ram_pop(struct bridge_rec *rec) {
+	if (s_ram_count == 0) return false;
+	_bridge_ram_read(rec, 0, sizeof(*rec));
+	size_t len = rec->topic_len + rec->data_len;
+	_bridge_ram_read(s_scratch, sizeof(*rec), len);
+	s_ram_head = (s_ram_head + sizeof(*rec) + len) % BRIDGE_RAM_SIZE;
+	s_ram_used -= sizeof(*rec) + len;
+	s_ram_count--;
+	return true;
+}
+
+// Move every RAM record to the end of the spool file
+static bool _bridge_spool_spill(void) {
+	if (s_spool_size + (long) s_ram_used > BRIDGE_SPOOL_MAX) return false;
+	FILE *f = fopen(BRIDGE_SPOOL_PATH, "ab");
+	if (f == NULL) {
+		ESP_LOGE(pcTaskGetName(NULL), "Cannot open %s", BRIDGE_SPOOL_PATH);
+		return false;
+	}
+	struct bridge_rec rec;
+	uint32_t count = s_ram_count;
+	while (_bridge_ram_pop(&rec)) {
+		fwrite(&rec, sizeof(rec), 1, f);
+		fwrite(s_scratch, 1, rec.topic_len + rec.data_len, f);
+	}
+	s_spool_size = ftell(f);
+	fclose(f);
+	s_spooled += count;
+	ESP_LOGI(pcTaskGetName(NULL), "SPOOL %"PRIu32" messages, %ld bytes pending", count, s_spool_size - s_spool_rd);
+	return true;
+}
+
+// Read the next spooled record into s_scratch from the file opened for this drain burst
+static bool _bridge_spool_pop(FILE *f, struct bridge_rec *rec) {
+	if (s_spool_rd >= s_spool_size) return false;
+	bool ok = f != NULL &&
+		fread(rec, sizeof(*rec), 1, f) == 1 &&
+		rec->topic_len + rec->data_len <= BRIDGE_MSG_MAX &&
+		fread(s_scratch, 1, rec->topic_len + rec->data_len, f) == (size_t) (rec->topic_len + rec->data_len);
+	if (ok) {
+		s_spool_rd += sizeof(*rec) + rec->topic_len + rec->data_len;
+	} else {
+		// Truncated or corrupt spool, give up on the rest
+		ESP_LOGW(pcTaskGetName(NULL), "Spool unreadable at %ld, discarded", s_spool_rd);
+		s_spool_rd = s_spool_size;
+	}
+	return ok;
+}
+
+// Open the spool at the read position, buffered so records are read in blocks
+static FILE *_bridge_spool_open(void) {
+	FILE *f = fopen(BRIDGE_SPOOL_PATH, "rb");
+	if (f == NULL) return NULL;
+	setvbuf(f, NULL, _IOFBF, BRIDGE_SPOOL_BLOCK);
+	if (fseek(f, s_spool_rd, SEEK_SET) != 0) {
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+// Close the spool after a drain burst, remove the file once drained
+static void _bridge_spool_close(FILE *f) {
+	if (f != NULL) fclose(f);
+	if (s_spool_rd >= s_spool_size) {
+		remove(BRIDGE_SPOOL_PATH);
+		s_spool_rd = s_spool_size = 0;
+	}
+}
+
+// Queue a local message for upstream
+static void _bridge_push(struct mg_str topic, struct mg_str data) {
+	struct bridge_rec rec = {(uint16_t) topic.len, (uint16_t) data.len};
+	size_t len = sizeof(rec) + topic.len + data.len;
+	if (topic.len + data.len > BRIDGE_MSG_MAX) {
+		s_dropped++;
+		ESP_LOGW(pcTaskGetName(NULL), "DROP [%.*s] too large", (int) topic.len, topic.ptr);
+		return;
+	}
+	if (s_ram_used + len > BRIDGE_RAM_SIZE && !_bridge_spool_spill()) {
+		s_dropped++;
+		ESP_LOGW(pcTaskGetName(NULL), "DROP [%.*s] queue full", (int) topic.len, topic.ptr);
+		return;
+	}
+	if (s_ram_count == 0) s_ram_first_at = mg_millis();
+	_bridge_ram_write(&rec, sizeof(rec));
+	_bridge_ram_write(topic.ptr, topic.len);
+	_bridge_ram_write(data.ptr, data.len);
+	s_ram_count++;
+}
+
+// Send queued messages upstream: spool first, then RAM, batched and rate limited
+static void _bridge_drain(void) {
+	uint64_t now = mg_millis();
+	int64_t cap = (int64_t) (s_rate ? s_rate : 1) * 1000;
+	s_tokens += (int64_t) (now - s_tokens_at) * s_rate;
+	if (s_tokens > cap) s_tokens = cap;
+	s_tokens_at = now;
+	if (s_up == NULL || !s_up_ready) return;
+
+	bool spool = s_spool_rd < s_spool_size;
+	bool batch = s_ram_used >= BRIDGE_BATCH_BYTES || (s_ram_count > 0 && now - s_ram_first_at >= BRIDGE_BATCH_MS);
+	if (!spool && !batch) return;
+
+	// Everything written here before the next poll leaves in as few TCP segments as possible.
+	// The backlog drains at s_rate, live traffic only waits for the socket.
+	// The spool stays open for the whole burst, nothing appends to it until the next poll
+	FILE *f = NULL;
+	if (spool && (!s_rate || s_tokens >= 1000)) {
+		f = _bridge_spool_open();
+		if (f == NULL) {
+			ESP_LOGW(pcTaskGetName(NULL), "Cannot open %s, %ld spooled bytes discarded", BRIDGE_SPOOL_PATH, s_spool_size - s_spool_rd);
+			s_spool_rd = s_spool_size;
+		}
+	}
+	uint32_t sent = 0;
+	while (s_up->send.len < BRIDGE_SEND_HIGH) {
+		struct bridge_rec rec;
+		if (s_spool_rd < s_spool_size) {
+			if (s_rate && s_tokens < 1000) break;
+			if (!_bridge_spool_pop(f, &rec)) continue;
+			if (s_rate) s_tokens -= 1000;
+		} else if (!_bridge_ram_pop(&rec)) {
+			break;
+		}
+		struct mg_str topic = mg_str_n((char *) s_scratch, rec.topic_len);
+		struct mg_str data = mg_str_n((char *) s_scratch + rec.topic_len, rec.data_len);
+		mg_mqtt_pub(s_up, topic, data, 1, false);
+		_bridge_echo_add(topic, data);
+		sent++;
+	}
+	if (spool) _bridge_spool_close(f);
+	if (s_ram_count > 0) s_ram_first_at = now;
+	s_forwarded += sent;
+	ESP_LOGD(pcTaskGetName(NULL), "BATCH %"PRIu32" messages, %d bytes", sent, (int) s_up->send.len);
+}
+
+static void _bridge_local_fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
+	if (ev == MG_EV_ERROR) {
+		ESP_LOGE(pcTaskGetName(NULL), "LOCAL MG_EV_ERROR %p %s", c->fd, (char *) ev_data);
+	} else if (ev == MG_EV_MQTT_OPEN) {
+		ESP_LOGI(pcTaskGetName(NULL), "CONNECTED to %s", s_local_url);
+		// No Local: what the bridge injects is not handed back to it
+		_bridge_each_filter(s_out, c, 1 | 0x04, _bridge_sub);
+	} else if (ev == MG_EV_MQTT_MSG) {
+		struct mg_mqtt_message *mm = (struct mg_mqtt_message *) ev_data;
+		_bridge_push(mm->topic, mm->data);
+	} else if (ev == MG_EV_CLOSE) {
+		ESP_LOGW(pcTaskGetName(NULL), "LOCAL MG_EV_CLOSE");
+		s_local = NULL;
+		s_local_retry_at = mg_millis() + BRIDGE_RECONNECT_MS;
+	}
+	(void) fn_data;
+}
+
+static void _bridge_up_fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
+	if (ev == MG_EV_ERROR) {
+		ESP_LOGE(pcTaskGetName(NULL), "UPSTREAM MG_EV_ERROR %p %s", c->fd, (char *) ev_data);
+	} else if (ev == MG_EV_CONNECT) {
+		// If target URL is SSL/TLS, command client connection to use TLS
+		if (mg_url_is_ssl(s_url)) {
+			struct mg_tls_opts opts = {.ca = "ca.pem"};
+			mg_tls_init(c, &opts);
+		}
+	} else if (ev == MG_EV_MQTT_OPEN) {
+		ESP_LOGI(pcTaskGetName(NULL), "CONNECTED to %s, %ld spooled bytes, %"PRIu32" queued",
+			s_url, s_spool_size - s_spool_rd, s_ram_count);
+		s_up_ready = true;
+		_bridge_each_filter(s_in, c, 1, _bridge_sub);
+	} else if (ev == MG_EV_MQTT_MSG) {
+		struct mg_mqtt_message *mm = (struct mg_mqtt_message *) ev_data;
+		if (_bridge_echo_hit(mm->topic, mm->data)) {
+			s_echoed++;
+		} else if (s_local != NULL) {
+			mg_mqtt_pub(s_local, mm->topic, mm->data, 0, false);
+			s_received++;
+		}
+	} else if (ev == MG_EV_CLOSE) {
+		ESP_LOGW(pcTaskGetName(NULL), "UPSTREAM MG_EV_CLOSE");
+		s_up = NULL;
+		s_up_ready = false;
+		s_up_retry_at = mg_millis() + BRIDGE_RECONNECT_MS;
+	}
+	(void) fn_data;
+}
+
+// Reconnect, keep the uplink alive and report now and then
+static void _bridge_timer(void *arg) {
+	static uint32_t ticks = 0;
+	struct mg_mgr *mgr = (struct mg_mgr *) arg;
+	uint64_t now = mg_millis();
+	ticks++;
+
+	if (s_local == NULL && now >= s_local_retry_at) {
+		struct mg_mqtt_opts opts;
+		memset(&opts, 0, sizeof(opts));
+		opts.client_id = mg_str("BRIDGE");
+		opts.version = 5;
+#if CONFIG_BROKER_AUTHENTICATION
+		opts.user = mg_str(CONFIG_AUTHENTICATION_USERNAME);
+		opts.pass = mg_str(CONFIG_AUTHENTICATION_PASSWORD);
+#endif
+		s_local = mg_mqtt_connect(mgr, s_local_url, &opts, _bridge_local_fn, NULL);
+		s_local_retry_at = now + BRIDGE_RECONNECT_MS;
+	}
+	if (s_up == NULL && now >= s_up_retry_at) {
+		struct mg_mqtt_opts opts;
+		memset(&opts, 0, sizeof(opts));
+		opts.client_id = mg_str(s_client_id);
+		opts.user = mg_str(s_user);
+		opts.pass = mg_str(s_pass);
+		opts.keepalive = BRIDGE_KEEPALIVE;
+		opts.clean = true;
+		ESP_LOGI(pcTaskGetName(NULL), "Connecting to %s", s_url);
+		s_up = mg_mqtt_connect(mgr, s_url, &opts, _bridge_up_fn, NULL);
+		s_up_retry_at = now + BRIDGE_RECONNECT_MS;
+	}
+	if (s_up != NULL && s_up_ready && ticks % (BRIDGE_KEEPALIVE / 2) == 0) {
+		mg_mqtt_ping(s_up);
+	}
+	if (ticks % 60 == 0) {
+		ESP_LOGI(pcTaskGetName(NULL), "forwarded=%"PRIu32" received=%"PRIu32" spooled=%"PRIu32" dropped=%"PRIu32" echoed=%"PRIu32,
+			s_forwarded, s_received, s_spooled, s_dropped, s_echoed);
+	}
+}
+
+void mqtt_bridge(void *pvParameters)
+{
+	char *task_parameter = (char *)pvParameters;
+	snprintf(s_local_url, sizeof(s_local_url), "%s", task_parameter);
+	ESP_LOGI(pcTaskGetName(NULL), "started on %s -> %s out=[%s] in=[%s]", s_local_url, s_url, s_out, s_in);
+
+	s_ram = malloc(BRIDGE_RAM_SIZE);
+	if (s_ram == NULL) {
+		ESP_LOGE(pcTaskGetName(NULL), "No memory for queue");
+		vTaskDelete(NULL);
+	}
+
+	// Messages spooled before a reboot are still due
+	struct stat st;
+	if (stat(BRIDGE_SPOOL_PATH, &st) == 0) {
+		s_spool_size = st.st_size;
+		ESP_LOGI(pcTaskGetName(NULL), "%ld spooled bytes from last run", s_spool_size);
+	}
+
+	uint8_t mac[6];
+	esp_read_mac(mac, ESP_MAC_WIFI_STA);
+	snprintf(s_client_id, sizeof(s_client_id), "dfr1234-%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+	/* Starting Bridge */
+	struct mg_mgr mgr;
+	mg_mgr_init(&mgr);
+	s_tokens_at = mg_millis();
+	mg_timer_add(&mgr, 1000, MG_TIMER_REPEAT | MG_TIMER_RUN_NOW, _bridge_timer, &mgr);
+
+	/* Processing events */
+	while (1) {
+		mg_mgr_poll(&mgr, 0);
+		_bridge_drain();
+		vTaskDelay(10);
+	}
+
+	// Never reach here
+	ESP_LOGI(pcTaskGetName(NULL), "finish");
+	mg_mgr_free(&mgr);
+}
@@ -0,0 +1,34 @@
+#ifndef __MQTTBRIDGE_H_
+#define __MQTTBRIDGE_H_
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "mongoose.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define MQTT_BRIDGE_STR_LEN 64			// Longest config string (URL, topic list, credentials)
+#define MQTT_BRIDGE_RATE_DEFAULT 50		// Spooled messages sent upstream per second
+
+/**
+ * Set the upstream bridge, call before the bridge task starts.
+ * url    upstream broker, e.g. "mqtt://192.168.1.10:1883", empty disables the bridge
+ * out    comma separated local filters forwarded upstream
+ * in     comma separated remote filters forwarded to the local broker
+ * rate   spooled messages sent upstream per second once the uplink is back, 0 means unlimited
+ */
+void mqtt_bridge_config(const char *url, const char *out, const char *in,
+	const char *user, const char *pass, uint32_t rate);
+bool mqtt_bridge_enabled(void);
+
+// Bridge task, pvParameters is the local broker URL
+void mqtt_bridge(void *pvParameters);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -9,16 +9,171 @@
 
 #include "mqtt_publisher.h"
 #include "mqtt_auth.h"
+
+enum { SLOT_FREE, SLOT_FILLING, SLOT_QUEUED, SLOT_SENDING };
+
+#define POOL_SLOTS (MQTT_PUB_SMALL_SLOTS + MQTT_PUB_LARGE_SLOTS)
+
+static char s_small_buf[MQTT_PUB_SMALL_SLOTS][MQTT_PUB_SMALL_SIZE];
+static char s_large_buf[MQTT_PUB_LARGE_SLOTS][MQTT_PUB_LARGE_SIZE];
+static mqtt_pub_msg_t s_slots[POOL_SLOTS];
+static bool s_pool_ready = false;
+static uint32_t s_pool_seq = 0;
+static uint32_t s_pool_dropped = 0;
+static portMUX_TYPE s_pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Bind the slots to their buffers, called with s_pool_mux held
+static void _pool_init(void)
+{
+	for (int i = 0; i < POOL_SLOTS; i++)
+	{
+		mqtt_pub_msg_t *slot = &s_slots[i];
+		slot->large = i >= MQTT_PUB_SMALL_SLOTS;
+		slot->buf = slot->large ? s_large_buf[i - MQTT_PUB_SMALL_SLOTS] : s_small_buf[i];
+		slot->cap = slot->large ? MQTT_PUB_LARGE_SIZE : MQTT_PUB_SMALL_SIZE;
+		slot->state = SLOT_FREE;
+	}
+	s_pool_ready = true;
+}
+
+// A free frame of the class, or the oldest queued non-retained one (dropped), called with s_pool_mux held
+static mqtt_pub_msg_t *_pool_take(uint8_t large, bool drop)
+{
+	mqtt_pub_msg_t *oldest = NULL;
+	for (int i = 0; i < POOL_SLOTS; i++)
+	{
+		mqtt_pub_msg_t *slot = &s_slots[i];
+		if (slot->large != large)
+			continue;
+		if (slot->state == SLOT_FREE)
+			return slot;
+		if (drop && slot->state == SLOT_QUEUED && !slot->retain &&
+			(oldest == NULL || (int32_t)(slot->seq - oldest->seq) < 0))
+			oldest = slot;
+	}
+	if (oldest != NULL)
+		s_pool_dropped++;
+	return oldest;
+}
+
+mqtt_pub_msg_t *mqtt_pub_msg_reserve(const char *topic, size_t len)
+{
+	size_t tlen = topic != NULL ? strlen(topic) + 1 : 0;
+	size_t need = tlen + len + 1;
+	mqtt_pub_msg_t *msg = NULL;
+	portENTER_CRITICAL(&s_pool_mux);
+	if (!s_pool_ready)
+		_pool_init();
+	if (need <= MQTT_PUB_SMALL_SIZE)
+	{
+		msg = _pool_take(0, false);
+		if (msg == NULL)
+			msg = _pool_take(1, false);
+		if (msg == NULL)
+			msg = _pool_take(0, true);
+	}
+	if (msg == NULL && need <= MQTT_PUB_LARGE_SIZE)
+		msg = _pool_take(1, true);
+	if (msg != NULL)
+		msg->state = SLOT_FILLING;
+	portEXIT_CRITICAL(&s_pool_mux);
+	if (msg == NULL)
+		return NULL;
+
+	// The frame is owned by the caller now, fill it outside the lock
+	char *p = msg->buf;
+	msg->topic = NULL;
+	if (topic != NULL)
+	{
+		memcpy(p, topic, tlen);
+		msg->topic = p;
+		p += tlen;
+	}
+	p[0] = '\0';
+	msg->payload = p;
+	msg->len = 0;
+	msg->retain = 0;
+	return msg;
+}
+
+size_t mqtt_pub_msg_room(const mqtt_pub_msg_t *msg)
+{
+	// One byte is kept for the trailing '\0'
+	return msg->cap - (size_t)(msg->payload - msg->buf) - 1;
+}
+
+mqtt_pub_msg_t *mqtt_pub_msg_new(const char *topic, const char *payload, size_t len)
+{
+	mqtt_pub_msg_t *msg = mqtt_pub_msg_reserve(topic, len);
+	if (msg == NULL)
+		return NULL;
+	memcpy(msg->payload, payload, len);
+	msg->payload[len] = '\0';
+	msg->len = len;
+	return msg;
+}
+
+void mqtt_pub_msg_send(mqtt_pub_msg_t *msg)
+{
+	portENTER_CRITICAL(&s_pool_mux);
+	msg->seq = ++s_pool_seq;
+	msg->state = SLOT_QUEUED;
+	portEXIT_CRITICAL(&s_pool_mux);
+}
+
+mqtt_pub_msg_t *mqtt_pub_msg_next(void)
+{
+	mqtt_pub_msg_t *oldest = NULL;
+	portENTER_CRITICAL(&s_pool_mux);
+	if (s_pool_ready)
+	{
+		for (int i = 0; i < POOL_SLOTS; i++)
+		{
+			mqtt_pub_msg_t *slot = &s_slots[i];
+			if (slot->state == SLOT_QUEUED && (oldest == NULL || (int32_t)(slot->seq - oldest->seq) < 0))
+				oldest = slot;
+		}
+		if (oldest != NULL)
+			oldest->state = SLOT_SENDING;
+	}
+	portEXIT_CRITICAL(&s_pool_mux);
+	return oldest;
+}
+
+void mqtt_pub_msg_free(mqtt_pub_msg_t *msg)
+{
+	portENTER_CRITICAL(&s_pool_mux);
+	msg->state = SLOT_FREE;
+	portEXIT_CRITICAL(&s_pool_mux);
+}
+
+uint32_t mqtt_pub_pool_queued(void)
+{
+	uint32_t queued = 0;
+	portENTER_CRITICAL(&s_pool_mux);
+	for (int i = 0; s_pool_ready && i < POOL_SLOTS; i++)
+	{
+		if (s_slots[i].state == SLOT_QUEUED)
+			queued++;
+	}
+	portEXIT_CRITICAL(&s_pool_mux);
+	return queued;
+}
+
+uint32_t mqtt_pub_pool_dropped(void)
+{
+	return s_pool_dropped;
+}
+
 #if CONFIG_PUBLISH
 
 #if 0
 static const char *sub_topic = "#";
 #endif
-static const char *pub_topic = "topic_input";
+static const char *pub_topic = MQTT_PUB_TOPIC;
 static const char *will_topic = "WILL";
 
 static EventGroupHandle_t s_wifi_event_group;
-extern QueueHandle_t jsonPtrQueue;
 /* The event group allows multiple bits for each event, but we only care about one event
  * - are we connected to the MQTT? */
 static int MQTT_CONNECTED_BIT = BIT0;
@@ -135,17 +290,16 @@ void mqtt_publisher(void *pvParameters)
 		ESP_LOGD(pcTaskGetName(NULL), "bits=0x%" PRIx32, bits);
 		if ((bits & MQTT_CONNECTED_BIT) != 0)
 		{
-			char *receivedPtr;
-
-			// if (xQueueReceive(jsonPtrQueue, &receivedPtr, portMAX_DELAY) == pdTRUE)
-      if (xQueueReceive(jsonPtrQueue, &receivedPtr, 0) == pdTRUE){
-				if (receivedPtr != NULL) {
-					if (strlen(receivedPtr) > 0) {
-						struct mg_str data = mg_str(receivedPtr);
-						mg_mqtt_pub(mgc, topic, data, 1, false);
-					}
-					free(receivedPtr);
+			mqtt_pub_msg_t *msg;
+
+			// Drain everything queued since the last poll, per-device topics queue several messages per interval.
+			// mg_mqtt_pub() copies into the connection's send buffer, so the frame goes straight back to the pool.
+			while ((msg = mqtt_pub_msg_next()) != NULL) {
+				if (msg->len > 0) {
+					struct mg_str data = mg_str_n(msg->payload, msg->len);
+					mg_mqtt_pub(mgc, msg->topic != NULL ? mg_str(msg->topic) : topic, data, 1, msg->retain);
 				}
+				mqtt_pub_msg_free(msg);
 			}
 
 			// TickType_t xCurrentTime = xTaskGetTickCount();
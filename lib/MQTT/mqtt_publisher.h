@@ -13,6 +13,62 @@
 extern "C"
 {
 #endif
+	// Default topic of the aggregate sensor frame
+#define MQTT_PUB_TOPIC "topic_input"
+
+// Publish frame pool, allocated statically: small frames for per-device/per-field topics,
+// large frames for aggregate frames and batches. Each frame holds the topic and the payload.
+#ifndef MQTT_PUB_SMALL_SLOTS
+#define MQTT_PUB_SMALL_SLOTS 12
+#endif
+#ifndef MQTT_PUB_SMALL_SIZE
+#define MQTT_PUB_SMALL_SIZE 512
+#endif
+#ifndef MQTT_PUB_LARGE_SLOTS
+#define MQTT_PUB_LARGE_SLOTS 3
+#endif
+#ifndef MQTT_PUB_LARGE_SIZE
+#define MQTT_PUB_LARGE_SIZE (8 * 1024 - 256) // Broker packet limit minus header room
+#endif
+
+	// A message handed to the publisher, backed by a pool frame.
+	// Ownership: mqtt_pub_msg_new() -> producer fills it -> mqtt_pub_msg_send() -> publisher
+	// takes it with mqtt_pub_msg_next() -> mqtt_pub_msg_free() returns the frame to the pool.
+	typedef struct
+	{
+		const char *topic; // NULL publishes on the default topic (topic_input)
+		char *payload;	   // May be binary (MessagePack/CBOR), always followed by a '\0'
+		size_t len;
+		uint8_t retain;
+		// Pool bookkeeping
+		uint8_t state;
+		uint8_t large;
+		uint32_t seq;	   // Queue order
+		char *buf;
+		size_t cap;
+	} mqtt_pub_msg_t;
+
+	// Take a frame and copy topic and payload into it, NULL if the message is larger than a
+	// large frame or every frame is in use. When the pool is exhausted the oldest queued
+	// non-retained message of the same size class is dropped and its frame reused.
+	mqtt_pub_msg_t *mqtt_pub_msg_new(const char *topic, const char *payload, size_t len);
+	// Take a frame with room for at least len payload bytes and copy only the topic into it, so
+	// the producer can encode straight into msg->payload. The producer sets msg->len and the
+	// trailing '\0', then sends the frame, or frees it if encoding failed.
+	mqtt_pub_msg_t *mqtt_pub_msg_reserve(const char *topic, size_t len);
+	// Payload bytes available in a reserved frame, excluding the trailing '\0'
+	size_t mqtt_pub_msg_room(const mqtt_pub_msg_t *msg);
+	// Hand a filled frame to the publisher
+	void mqtt_pub_msg_send(mqtt_pub_msg_t *msg);
+	// Oldest queued message, owned by the caller until mqtt_pub_msg_free(), NULL if none
+	mqtt_pub_msg_t *mqtt_pub_msg_next(void);
+	// Return a frame to the pool
+	void mqtt_pub_msg_free(mqtt_pub_msg_t *msg);
+	// Messages waiting for the publisher
+	uint32_t mqtt_pub_pool_queued(void);
+	// Messages dropped to make room since boot
+	uint32_t mqtt_pub_pool_dropped(void);
+
 	void mqtt_publisher(void *pvParameters);
 
 	void mqtt_subscriber(void *pvParameters);
@@ -9,11 +9,15 @@
 */
 
 #include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 #include "mongoose.h"
 #include "mqtt_server.h"
@@ -26,10 +30,33 @@ struct client *s_clients = NULL;
 
 // A list of subscription, held in memory
 struct sub *s_subs = NULL;
+// Taken by the broker while adding/removing subscriptions and by other tasks querying them
+static SemaphoreHandle_t s_subs_lock = NULL;
+#define SUBS_LOCK() xSemaphoreTake(s_subs_lock, portMAX_DELAY)
+#define SUBS_UNLOCK() xSemaphoreGive(s_subs_lock)
 
 // A list of will topic & message, held in memory
 struct will *s_wills = NULL;
 
+// A list of retained message, held in memory
+struct retained *s_retained = NULL;
+static uint32_t s_retained_cnt = 0;
+
+// Broker statistics, bumped on the hot path and aggregated by the $SYS timer
+static struct {
+	atomic_uint msgs_in, msgs_out;
+	atomic_uint bytes_in, bytes_out;
+	atomic_uint dropped;
+} s_stats;
+#define STAT_ADD(field, n) atomic_fetch_add_explicit(&s_stats.field, (n), memory_order_relaxed)
+
+// Largest client send buffer, refreshed by the rate timer for the publishing side
+static atomic_uint s_backlog;
+
+// Per-client publish rate limit, set from config.txt
+static volatile uint32_t s_rate_msgs = MQTT_SERVER_RATE_MSGS_DEFAULT;
+static volatile uint32_t s_rate_bytes = MQTT_SERVER_RATE_BYTES_DEFAULT;
+
 // Since version 7.8, mg_mqtt_next_sub() and mg_mqtt_next_unsub() are no longer supported.
 static size_t mg_mqtt_next_topic(struct mg_mqtt_message *msg, struct mg_str *topic, uint8_t *qos, size_t pos) {
   unsigned char *buf = (unsigned char *) msg->dgram.ptr + pos;
@@ -53,6 +80,467 @@ size_t mg_mqtt_next_unsub(struct mg_mqtt_message *msg, struct mg_str *topic, siz
   return mg_mqtt_next_topic(msg, topic, NULL, pos);
 }
 
+// MQTT 5 property identifiers used by the broker
+#define MQTT_PROP_MESSAGE_EXPIRY 0x02
+#define MQTT_PROP_RECEIVE_MAXIMUM 0x21
+#define MQTT_PROP_TOPIC_ALIAS_MAXIMUM 0x22
+#define MQTT_PROP_TOPIC_ALIAS 0x23
+#define MQTT_PROP_MAXIMUM_QOS 0x24
+#define MQTT_PROP_RETAIN_AVAILABLE 0x25
+#define MQTT_PROP_MAXIMUM_PACKET_SIZE 0x27
+#define MQTT_PROP_SUBSCRIPTION_ID_AVAILABLE 0x29
+#define MQTT_PROP_SHARED_SUB_AVAILABLE 0x2A
+
+// MQTT 5 reason codes used by the broker
+#define MQTT_RC_SUCCESS 0x00
+#define MQTT_RC_DISCONNECT_WITH_WILL 0x04
+#define MQTT_RC_NO_SUBSCRIPTION_EXISTED 0x11
+#define MQTT_RC_MALFORMED_PACKET 0x81
+#define MQTT_RC_PROTOCOL_ERROR 0x82
+#define MQTT_RC_UNSUPPORTED_PROTOCOL_VERSION 0x84
+#define MQTT_RC_BAD_USERNAME_OR_PASSWORD 0x86
+#define MQTT_RC_TOPIC_FILTER_INVALID 0x8F
+#define MQTT_RC_TOPIC_ALIAS_INVALID 0x94
+#define MQTT_RC_PACKET_TOO_LARGE 0x95
+#define MQTT_RC_QOS_NOT_SUPPORTED 0x9B
+
+// MQTT 5 properties the broker acts on, everything else is skipped
+struct mqtt_props {
+	uint16_t receive_max;
+	uint16_t topic_alias_max;
+	uint16_t topic_alias;
+	uint32_t max_packet;
+	uint32_t expiry;
+};
+
+// Decode a Variable Byte Integer, return the number of bytes used or 0 if malformed
+static size_t _mg_mqtt_varint(const uint8_t *p, const uint8_t *end, uint32_t *value) {
+	uint32_t v = 0;
+	for (size_t i = 0; i < 4 && p + i < end; i++) {
+		v |= (uint32_t) (p[i] & 0x7f) << (7 * i);
+		if ((p[i] & 0x80) == 0) {
+			*value = v;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+static size_t _mg_mqtt_varint_len(uint32_t value) {
+	return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+// Size of the fixed header, i.e. offset of the variable header
+static size_t _mg_mqtt_hdr_len(struct mg_mqtt_message *msg) {
+	const uint8_t *buf = (const uint8_t *) msg->dgram.ptr;
+	uint32_t len;
+	return 1 + _mg_mqtt_varint(buf + 1, buf + msg->dgram.len, &len);
+}
+
+// Parse a MQTT 5 property block at p, return a pointer past it or NULL if malformed
+static const uint8_t *_mg_mqtt5_parse_props(const uint8_t *p, const uint8_t *end, struct mqtt_props *props) {
+	uint32_t len;
+	size_t n = _mg_mqtt_varint(p, end, &len);
+	memset(props, 0, sizeof(*props));
+	if (n == 0 || p + n + len > end) return NULL;
+	p += n;
+	const uint8_t *pend = p + len;
+	while (p < pend) {
+		uint8_t id = *p++;
+		switch (id) {
+			// Byte
+			case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+				p += 1;
+				break;
+			// Two Byte Integer
+			case 0x13: case 0x21: case 0x22: case 0x23: {
+				if (p + 2 > pend) return NULL;
+				uint16_t v = (uint16_t) (p[0] << 8 | p[1]);
+				if (id == MQTT_PROP_RECEIVE_MAXIMUM) props->receive_max = v;
+				if (id == MQTT_PROP_TOPIC_ALIAS_MAXIMUM) props->topic_alias_max = v;
+				if (id == MQTT_PROP_TOPIC_ALIAS) props->topic_alias = v;
+				p += 2;
+				break;
+			}
+			// Four Byte Integer
+			case 0x02: case 0x11: case 0x18: case 0x27: {
+				if (p + 4 > pend) return NULL;
+				uint32_t v = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+				if (id == MQTT_PROP_MESSAGE_EXPIRY) props->expiry = v;
+				if (id == MQTT_PROP_MAXIMUM_PACKET_SIZE) props->max_packet = v;
+				p += 4;
+				break;
+			}
+			// Variable Byte Integer
+			case 0x0B: {
+				uint32_t v;
+				size_t m = _mg_mqtt_varint(p, pend, &v);
+				if (m == 0) return NULL;
+				p += m;
+				break;
+			}
+			// UTF-8 string or binary data
+			case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+				if (p + 2 > pend) return NULL;
+				p += 2 + (p[0] << 8 | p[1]);
+				break;
+			// UTF-8 string pair
+			case 0x26:
+				for (int i = 0; i < 2; i++) {
+					if (p + 2 > pend) return NULL;
+					p += 2 + (p[0] << 8 | p[1]);
+				}
+				break;
+			default:
+				return NULL;
+		}
+	}
+	return p == pend ? pend : NULL;
+}
+
+// Send CONNACK, MQTT 5 also advertises the broker limits
+static void _mg_mqtt_connack(struct mg_connection *c, uint8_t version, uint8_t code) {
+	if (version != 5) {
+		uint8_t response[] = {0, code};
+		mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
+		mg_send(c, response, sizeof(response));
+		return;
+	}
+	uint32_t max_packet = MQTT_SERVER_MAX_PACKET_SIZE;
+	uint8_t response[] = {
+		0, code,
+		16,	// Property Length
+		MQTT_PROP_TOPIC_ALIAS_MAXIMUM, 0, MQTT_SERVER_TOPIC_ALIAS_MAX,
+		MQTT_PROP_MAXIMUM_PACKET_SIZE, max_packet >> 24, max_packet >> 16, max_packet >> 8, max_packet,
+		MQTT_PROP_MAXIMUM_QOS, 1,
+		MQTT_PROP_RETAIN_AVAILABLE, 1,
+		MQTT_PROP_SUBSCRIPTION_ID_AVAILABLE, 0,
+		MQTT_PROP_SHARED_SUB_AVAILABLE, 1,
+	};
+	mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
+	mg_send(c, response, sizeof(response));
+}
+
+// Server side DISCONNECT with a reason code (MQTT 5 only), then close once flushed
+static void _mg_mqtt5_disconnect(struct mg_connection *c, uint8_t reason) {
+	uint8_t response[] = {reason, 0};
+	ESP_LOGW(pcTaskGetName(NULL), "DISCONNECT %p reason=0x%02x", c->fd, reason);
+	mg_mqtt_send_header(c, MQTT_CMD_DISCONNECT, 0, sizeof(response));
+	mg_send(c, response, sizeof(response));
+	c->is_draining = 1;
+}
+
+// Re-parse a MQTT 5 PUBLISH: collect properties, resolve the topic alias and check limits.
+// mongoose only skips a single-byte property length, so topic and data are recomputed here.
+static uint8_t _mg_mqtt5_parse_publish(struct client *client, struct mg_mqtt_message *mm, struct mqtt_props *props) {
+	const uint8_t *buf = (const uint8_t *) mm->dgram.ptr;
+	const uint8_t *end = buf + mm->dgram.len;
+	const uint8_t *p = buf + _mg_mqtt_hdr_len(mm);
+
+	if (mm->dgram.len > MQTT_SERVER_MAX_PACKET_SIZE) return MQTT_RC_PACKET_TOO_LARGE;
+	if (mm->qos > 1) return MQTT_RC_QOS_NOT_SUPPORTED;
+	if (p + 2 > end) return MQTT_RC_MALFORMED_PACKET;
+	mm->topic.len = (size_t) (p[0] << 8 | p[1]);
+	mm->topic.ptr = (char *) p + 2;
+	p += 2 + mm->topic.len + (mm->qos > 0 ? 2 : 0);
+	if (p > end) return MQTT_RC_MALFORMED_PACKET;
+	p = _mg_mqtt5_parse_props(p, end, props);
+	if (p == NULL) return MQTT_RC_MALFORMED_PACKET;
+	mm->data.ptr = (char *) p;
+	mm->data.len = (size_t) (end - p);
+
+	if (props->topic_alias == 0) {
+		return mm->topic.len > 0 ? MQTT_RC_SUCCESS : MQTT_RC_PROTOCOL_ERROR;
+	}
+	if (props->topic_alias > client->alias_in_max) return MQTT_RC_TOPIC_ALIAS_INVALID;
+	struct mg_str *slot = &client->alias_in[props->topic_alias - 1];
+	if (mm->topic.len > 0) {
+		// Topic and alias: (re)define the mapping
+		free((void *)slot->ptr);
+		*slot = mg_strdup(mm->topic);
+	} else if (slot->len == 0) {
+		// Alias only, but never defined
+		return MQTT_RC_PROTOCOL_ERROR;
+	} else {
+		mm->topic = *slot;
+	}
+	return MQTT_RC_SUCCESS;
+}
+
+// Encode a MQTT 5 PUBLISH, replacing the topic by an alias where the client allows it
+static void _mg_mqtt5_pub(struct client *client, struct mg_str topic, struct mg_str data, uint8_t qos, uint8_t retain, uint32_t expiry) {
+	struct mg_connection *c = client->c;
+	uint8_t flags = (uint8_t) (((qos & 3) << 1) | (retain ? 1 : 0));
+	uint8_t props[8];
+	uint8_t props_len = 0;
+	uint16_t alias = 0;
+	bool new_alias = false;
+	struct mg_str t = topic;
+
+	// Reuse an alias the client already knows, otherwise hand out a new one while any are left
+	for (uint16_t i = 0; i < client->alias_out_cnt; i++) {
+		if (mg_strcmp(client->alias_out[i], topic) == 0) {
+			alias = i + 1;
+			t.len = 0;
+			break;
+		}
+	}
+	if (alias == 0 && client->alias_out_cnt < client->alias_out_max) {
+		alias = client->alias_out_cnt + 1;
+		new_alias = true;
+	}
+
+	if (expiry) {
+		props[props_len++] = MQTT_PROP_MESSAGE_EXPIRY;
+		props[props_len++] = (uint8_t) (expiry >> 24);
+		props[props_len++] = (uint8_t) (expiry >> 16);
+		props[props_len++] = (uint8_t) (expiry >> 8);
+		props[props_len++] = (uint8_t) expiry;
+	}
+	if (alias) {
+		props[props_len++] = MQTT_PROP_TOPIC_ALIAS;
+		props[props_len++] = (uint8_t) (alias >> 8);
+		props[props_len++] = (uint8_t) alias;
+	}
+
+	uint32_t len = 2 + (uint32_t) t.len + (qos > 0 ? 2 : 0) + 1 + props_len + (uint32_t) data.len;
+	if (client->max_packet && 1 + _mg_mqtt_varint_len(len) + len > client->max_packet) {
+		// The client must never receive more than its Maximum Packet Size, discard
+		ESP_LOGW(pcTaskGetName(NULL), "DROP %p [%.*s] exceeds Maximum Packet Size %"PRIu32,
+			c->fd, (int) topic.len, topic.ptr, client->max_packet);
+		STAT_ADD(dropped, 1);
+		return;
+	}
+	STAT_ADD(msgs_out, 1);
+	STAT_ADD(bytes_out, 1 + _mg_mqtt_varint_len(len) + len);
+	if (new_alias) {
+		client->alias_out[client->alias_out_cnt++] = mg_strdup(topic);
+	}
+
+	mg_mqtt_send_header(c, MQTT_CMD_PUBLISH, flags, len);
+	uint16_t topic_len = mg_htons((uint16_t) t.len);
+	mg_send(c, &topic_len, sizeof(topic_len));
+	mg_send(c, t.ptr, t.len);
+	if (qos > 0) {
+		if (++c->mgr->mqtt_id == 0) ++c->mgr->mqtt_id;
+		uint16_t id = mg_htons(c->mgr->mqtt_id);
+		mg_send(c, &id, sizeof(id));
+		client->inflight++;
+	}
+	mg_send(c, &props_len, sizeof(props_len));
+	mg_send(c, props, props_len);
+	mg_send(c, data.ptr, data.len);
+}
+
+// Park a QoS 1 message until the client's receive window opens, dropping the oldest when full
+static void _mg_mqtt_park(struct client *client, struct mg_str topic, struct mg_str data, uint8_t retain, uint32_t expiry) {
+	if (client->pending_cnt >= MQTT_SERVER_PENDING_MAX) {
+		struct pending *oldest = client->pending;
+		ESP_LOGW(pcTaskGetName(NULL), "DROP %p [%.*s] receive window full", client->c->fd,
+			(int) oldest->topic.len, oldest->topic.ptr);
+		STAT_ADD(dropped, 1);
+		free((void *)oldest->topic.ptr);
+		free((void *)oldest->payload.ptr);
+		LIST_DELETE(struct pending, &client->pending, oldest);
+		free(oldest);
+		client->pending_cnt--;
+	}
+	struct pending *pending = calloc(1, sizeof(*pending));
+	if (pending == NULL) return;
+	pending->topic = mg_strdup(topic);
+	pending->payload = mg_strdup(data);
+	pending->retain = retain;
+	pending->expire_at = expiry ? mg_millis() + (uint64_t) expiry * 1000 : 0;
+	LIST_ADD_TAIL(struct pending, &client->pending, pending);
+	client->pending_cnt++;
+}
+
+// Send parked messages while the receive window allows, discarding the expired ones
+static void _mg_mqtt_flush_pending(struct client *client) {
+	uint64_t now = mg_millis();
+	while (client->pending != NULL && client->inflight < client->receive_max) {
+		struct pending *pending = client->pending;
+		LIST_DELETE(struct pending, &client->pending, pending);
+		client->pending_cnt--;
+		if (pending->expire_at == 0) {
+			_mg_mqtt5_pub(client, pending->topic, pending->payload, 1, pending->retain, 0);
+		} else if (pending->expire_at > now) {
+			// Forward the remaining lifetime, rounded up
+			uint32_t expiry = (uint32_t) ((pending->expire_at - now + 999) / 1000);
+			_mg_mqtt5_pub(client, pending->topic, pending->payload, 1, pending->retain, expiry);
+		} else {
+			ESP_LOGI(pcTaskGetName(NULL), "EXPIRED %p [%.*s]", client->c->fd,
+				(int) pending->topic.len, pending->topic.ptr);
+			STAT_ADD(dropped, 1);
+		}
+		free((void *)pending->topic.ptr);
+		free((void *)pending->payload.ptr);
+		free(pending);
+	}
+}
+
+// Deliver one message to one subscriber connection
+static void _mg_mqtt_forward(struct mg_connection *c, struct mg_str topic, struct mg_str data, uint8_t qos, uint8_t retain, uint32_t expiry) {
+	struct client *client = (struct client *) c->fn_data;
+	if (client == NULL || client->version != 5) {
+		// MQTT 3.1.1 subscribers keep the historical QoS 1 delivery
+		//for Ver7.6
+		mg_mqtt_pub(c, topic, data, 1, retain);
+		if (client != NULL) client->inflight++;
+		STAT_ADD(msgs_out, 1);
+		STAT_ADD(bytes_out, 1 + _mg_mqtt_varint_len(4 + topic.len + data.len) + 4 + topic.len + data.len);
+		return;
+	}
+	if (qos > 0 && client->inflight >= client->receive_max) {
+		_mg_mqtt_park(client, topic, data, retain, expiry);
+		return;
+	}
+	_mg_mqtt5_pub(client, topic, data, qos, retain, expiry);
+}
+
+static void _mg_mqtt_client_free(struct client *client) {
+	free((void *)client->cid.ptr);
+	for (uint16_t i = 0; client->alias_in != NULL && i < client->alias_in_max; i++) {
+		free((void *)client->alias_in[i].ptr);
+	}
+	for (uint16_t i = 0; client->alias_out != NULL && i < client->alias_out_cnt; i++) {
+		free((void *)client->alias_out[i].ptr);
+	}
+	free(client->alias_in);
+	free(client->alias_out);
+	for (struct pending *next, *pending = client->pending; pending != NULL; pending = next) {
+		next = pending->next;
+		free((void *)pending->topic.ptr);
+		free((void *)pending->payload.ptr);
+		free(pending);
+	}
+	free(client);
+}
+
+static void _mg_mqtt_will_delete(struct mg_connection *c) {
+	for (struct will *next, *will = s_wills; will != NULL; will = next) {
+		next = will->next;
+		if (c != will->c) continue;
+		ESP_LOGD(pcTaskGetName(NULL), "WILL DISCARD %p [%.*s]", c->fd, (int) will->topic.len, will->topic.ptr);
+		free((void *)will->topic.ptr);
+		free((void *)will->payload.ptr);
+		LIST_DELETE(struct will, &s_wills, will);
+		free(will);
+	}
+}
+
+// Split "$share/{group}/{filter}", return 1 if shared, 0 if not, -1 if malformed
+static int _mg_mqtt_share_parse(struct mg_str topic, struct mg_str *group, struct mg_str *filter) {
+	group->ptr = NULL;
+	group->len = 0;
+	*filter = topic;
+	if (topic.len < 7 || strncmp(topic.ptr, "$share/", 7) != 0) return 0;
+	const char *p = topic.ptr + 7;
+	const char *end = topic.ptr + topic.len;
+	const char *slash = memchr(p, '/', end - p);
+	if (slash == NULL || slash == p || slash + 1 >= end) return -1;
+	group->ptr = p;
+	group->len = slash - p;
+	if (memchr(group->ptr, '+', group->len) || memchr(group->ptr, '#', group->len)) return -1;
+	filter->ptr = slash + 1;
+	filter->len = end - filter->ptr;
+	return 1;
+}
+
+static void _mg_mqtt_sub_free(struct sub *sub) {
+	free((void *)sub->topic.ptr);
+	free((void *)sub->group.ptr);
+	free(sub);
+}
+
+static uint16_t _mg_mqtt_inflight(struct sub *sub) {
+	struct client *client = (struct client *) sub->c->fn_data;
+	return client == NULL ? 0 : client->inflight + client->pending_cnt;
+}
+
+void mqtt_server_set_rate_limit(uint32_t msgs_per_sec, uint32_t bytes_per_sec) {
+	s_rate_msgs = msgs_per_sec;
+	s_rate_bytes = bytes_per_sec;
+	ESP_LOGI("BROKER", "rate limit %"PRIu32" msg/s %"PRIu32" byte/s", msgs_per_sec, bytes_per_sec);
+}
+
+// Refill both token buckets, a bucket holds at most one second worth of tokens
+static void _mg_mqtt_refill(struct client *client, uint64_t now) {
+	int64_t elapsed = (int64_t) (now - client->refill_at);
+	int64_t msgs = s_rate_msgs, bytes = s_rate_bytes;
+	client->refill_at = now;
+	client->msg_tokens += elapsed * msgs;
+	if (client->msg_tokens > msgs * 1000) client->msg_tokens = msgs * 1000;
+	client->byte_tokens += elapsed * bytes;
+	if (client->byte_tokens > bytes * 1000) client->byte_tokens = bytes * 1000;
+}
+
+// Charge a PUBLISH to the sender's buckets, return false if it must be dropped.
+// Over the limit, QoS 0 is dropped; QoS 1 is delivered on credit and reads are paused until the debt is repaid.
+static bool _mg_mqtt_rate_check(struct client *client, struct mg_mqtt_message *mm) {
+	client->pub_count++;
+	client->pub_bytes += mm->dgram.len;
+	STAT_ADD(msgs_in, 1);
+	STAT_ADD(bytes_in, mm->dgram.len);
+	if (client->local) return true;
+	uint32_t rate_msgs = s_rate_msgs, rate_bytes = s_rate_bytes;
+	if (rate_msgs == 0 && rate_bytes == 0) return true;
+
+	_mg_mqtt_refill(client, mg_millis());
+	int64_t msg_cost = rate_msgs ? 1000 : 0;
+	int64_t byte_cost = rate_bytes ? (int64_t) mm->dgram.len * 1000 : 0;
+	bool over = client->msg_tokens < msg_cost || client->byte_tokens < byte_cost;
+	if (over && mm->qos == 0) {
+		client->drop_count++;
+		STAT_ADD(dropped, 1);
+		ESP_LOGD(pcTaskGetName(NULL), "THROTTLE DROP %p [%.*s]", client->c->fd, (int) mm->topic.len, mm->topic.ptr);
+		return false;
+	}
+	client->msg_tokens -= msg_cost;
+	client->byte_tokens -= byte_cost;
+	if (over && !client->paused) {
+		client->paused = 1;
+		client->c->is_full = 1;
+		client->pause_count++;
+		ESP_LOGW(pcTaskGetName(NULL), "THROTTLE PAUSE %p [%.*s]", client->c->fd, (int) client->cid.len, client->cid.ptr);
+	}
+	return true;
+}
+
+// Resume paused clients once their buckets are out of debt, report throttled clients now and then
+static void _mg_mqtt_rate_timer(void *arg) {
+	static uint32_t ticks = 0;
+	uint64_t now = mg_millis();
+	bool report = (++ticks % 100) == 0;
+	uint32_t backlog = 0;
+	for (struct client *client = s_clients; client != NULL; client = client->next) {
+		if (client->c->send.len > backlog) backlog = client->c->send.len;
+		if (client->paused) {
+			_mg_mqtt_refill(client, now);
+			if (client->msg_tokens >= 0 && client->byte_tokens >= 0) {
+				client->paused = 0;
+				client->c->is_full = 0;
+				ESP_LOGI(pcTaskGetName(NULL), "THROTTLE RESUME %p [%.*s]", client->c->fd, (int) client->cid.len, client->cid.ptr);
+				if (client->c->recv.len > 0) {
+					// Packets already buffered when reads were paused
+					long n = 0;
+					mg_call(client->c, MG_EV_READ, &n);
+				}
+			}
+		}
+		if (report && (client->drop_count || client->pause_count)) {
+			ESP_LOGW(pcTaskGetName(NULL), "THROTTLED [%.*s] pub=%"PRIu32" bytes=%"PRIu32" dropped=%"PRIu32" paused=%"PRIu32,
+				(int) client->cid.len, client->cid.ptr, client->pub_count, client->pub_bytes, client->drop_count, client->pause_count);
+		}
+	}
+	atomic_store_explicit(&s_backlog, backlog, memory_order_relaxed);
+	(void) arg;
+}
+
+uint32_t mqtt_server_backlog(void) {
+	return atomic_load_explicit(&s_backlog, memory_order_relaxed);
+}
+
 // Wildcard(#/+) support version
 int _mg_strcmp(const struct mg_str str1, const struct mg_str str2) {
 	size_t i1 = 0;
@@ -95,6 +583,122 @@ int _mg_strcmp(const struct mg_str str1, const struct mg_str str2) {
 	return 0;
 }
 
+// Topic filter match; wildcards at the first level never match topics starting with '$'
+static bool _mg_mqtt_match(struct mg_str topic, struct mg_str filter) {
+	if (topic.len > 0 && topic.ptr[0] == '$' && filter.len > 0 && (filter.ptr[0] == '+' || filter.ptr[0] == '#')) {
+		return false;
+	}
+	return _mg_strcmp(topic, filter) == 0;
+}
+
+// Split off the next topic level, s->ptr becomes NULL after the last one
+static bool _mg_mqtt_next_level(struct mg_str *s, struct mg_str *level) {
+	if (s->ptr == NULL) return false;
+	const char *slash = memchr(s->ptr, '/', s->len);
+	if (slash == NULL) {
+		*level = *s;
+		s->ptr = NULL;
+		s->len = 0;
+	} else {
+		*level = mg_str_n(s->ptr, slash - s->ptr);
+		s->len -= slash - s->ptr + 1;
+		s->ptr = slash + 1;
+	}
+	return true;
+}
+
+// Whether the filter matches the prefix itself or some topic below it
+static bool _mg_mqtt_match_under(struct mg_str prefix, struct mg_str filter) {
+	if (prefix.len > 0 && prefix.ptr[0] == '$' && filter.len > 0 && (filter.ptr[0] == '+' || filter.ptr[0] == '#')) {
+		return false;
+	}
+	struct mg_str pl, fl;
+	while (_mg_mqtt_next_level(&prefix, &pl)) {
+		if (!_mg_mqtt_next_level(&filter, &fl)) return false;
+		if (fl.len == 1 && fl.ptr[0] == '#') return true;
+		if (fl.len == 1 && fl.ptr[0] == '+') continue;
+		if (mg_strcmp(pl, fl) != 0) return false;
+	}
+	return true;
+}
+
+bool mqtt_server_has_subscriber(const char *topic) {
+	// Before the broker runs nobody can tell, keep publishing
+	if (s_subs_lock == NULL) return true;
+	struct mg_str t = mg_str(topic);
+	bool under = t.len >= 2 && t.ptr[t.len - 1] == '#' && t.ptr[t.len - 2] == '/';
+	if (under) t.len -= 2;
+	bool found = false;
+	SUBS_LOCK();
+	for (struct sub *sub = s_subs; sub != NULL && !found; sub = sub->next) {
+		found = under ? _mg_mqtt_match_under(t, sub->topic) : _mg_mqtt_match(t, sub->topic);
+	}
+	SUBS_UNLOCK();
+	return found;
+}
+
+// Store, replace or (empty payload) delete a retained message
+static void _mg_mqtt_retain(struct mg_str topic, struct mg_str payload, uint8_t qos) {
+	for (struct retained *r = s_retained; r != NULL; r = r->next) {
+		if (mg_strcmp(r->topic, topic) != 0) continue;
+		free((void *)r->payload.ptr);
+		if (payload.len == 0) {
+			free((void *)r->topic.ptr);
+			LIST_DELETE(struct retained, &s_retained, r);
+			free(r);
+			s_retained_cnt--;
+		} else {
+			r->payload = mg_strdup(payload);
+			r->qos = qos;
+		}
+		return;
+	}
+	if (payload.len == 0) return;
+	if (s_retained_cnt >= MQTT_SERVER_RETAIN_MAX) {
+		ESP_LOGW(pcTaskGetName(NULL), "RETAIN FULL [%.*s] not stored", (int) topic.len, topic.ptr);
+		return;
+	}
+	struct retained *r = calloc(1, sizeof(*r));
+	if (r == NULL) return;
+	r->topic = mg_strdup(topic);
+	r->payload = mg_strdup(payload);
+	r->qos = qos;
+	LIST_ADD_TAIL(struct retained, &s_retained, r);
+	s_retained_cnt++;
+}
+
+// Deliver a message to every matching subscription.
+// Each shared group ($share/group/filter) gets one copy, sent to the member with the fewest
+// unacknowledged messages; ties go to the member served longest ago (round-robin).
+static void _mg_mqtt_route(struct mg_connection *from, struct mg_str topic, struct mg_str data, uint8_t qos, uint8_t retain, uint32_t expiry) {
+	static uint32_t seq = 0;
+	if (++seq == 0) ++seq;
+	for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
+		if (sub->routed == seq) continue;
+		if (!_mg_mqtt_match(topic, sub->topic)) continue;
+		if (sub->group.len == 0) {
+			if (sub->no_local && sub->c == from) continue;
+			_mg_mqtt_forward(sub->c, topic, data, qos < sub->qos ? qos : sub->qos, retain, expiry);
+			continue;
+		}
+		struct sub *best = NULL;
+		for (struct sub *member = sub; member != NULL; member = member->next) {
+			if (member->group.len == 0) continue;
+			if (mg_strcmp(member->group, sub->group) != 0 || mg_strcmp(member->topic, sub->topic) != 0) continue;
+			member->routed = seq;
+			if (best == NULL) {
+				best = member;
+				continue;
+			}
+			uint16_t a = _mg_mqtt_inflight(member), b = _mg_mqtt_inflight(best);
+			if (a < b || (a == b && member->picked < best->picked)) best = member;
+		}
+		best->picked = seq;
+		ESP_LOGD(pcTaskGetName(NULL), "SHARE [%.*s] -> %p", (int) best->group.len, best->group.ptr, best->c->fd);
+		_mg_mqtt_forward(best->c, topic, data, qos < best->qos ? qos : best->qos, retain, expiry);
+	}
+}
+
 void _mg_mqtt_dump(char * tag, struct mg_mqtt_message *msg) {
 	unsigned char *buf = (unsigned char *) msg->dgram.ptr;
 	ESP_LOGI(pcTaskGetName(NULL),"%s=%x %x", tag, buf[0], buf[1]);
@@ -110,17 +714,26 @@ void _mg_mqtt_dump(char * tag, struct mg_mqtt_message *msg) {
 
 int _mg_mqtt_parse_header(struct mg_mqtt_message *msg, struct mg_str *client, 
 		struct mg_str *topic, struct mg_str *payload, 
-		struct mg_str *username, struct mg_str *password, uint8_t *qos, uint8_t *retain) {
+		struct mg_str *username, struct mg_str *password, uint8_t *qos, uint8_t *retain,
+		uint8_t *version, struct mqtt_props *props, struct mqtt_props *will_props) {
 	client->len = 0;
 	topic->len = 0;
 	payload->len = 0;
 	username->len = 0;
 	password->len = 0;
+	memset(props, 0, sizeof(*props));
+	memset(will_props, 0, sizeof(*will_props));
 	unsigned char *buf = (unsigned char *) msg->dgram.ptr;
-	int Protocol_Name_length = buf[2] << 8 | buf[3];
-	int Connect_Flags_position = Protocol_Name_length + 5;
+	const unsigned char *end = buf + msg->dgram.len;
+	int Protocol_Name_position = _mg_mqtt_hdr_len(msg);
+	if (buf + Protocol_Name_position + 2 > end) return -1;
+	int Protocol_Name_length = buf[Protocol_Name_position] << 8 | buf[Protocol_Name_position + 1];
+	int Protocol_Level_position = Protocol_Name_position + 2 + Protocol_Name_length;
+	int Connect_Flags_position = Protocol_Level_position + 1;
+	if (buf + Connect_Flags_position + 3 > end) return -1;
+	*version = buf[Protocol_Level_position];
 	uint8_t Connect_Flags = buf[Connect_Flags_position];
-	ESP_LOGD("_mg_mqtt_parse_header", "Connect_Flags=0x%02x", Connect_Flags);
+	ESP_LOGD("_mg_mqtt_parse_header", "version=%d Connect_Flags=0x%02x", *version, Connect_Flags);
 	//uint8_t Will_Flag = (Connect_Flags & WILL_FLAG) >> 2;
 	int will = (Connect_Flags & WILL_FLAG) >> 2;
 	*qos = (Connect_Flags & WILL_QOS) >> 3;
@@ -136,8 +749,15 @@ int _mg_mqtt_parse_header(struct mg_mqtt_message *msg, struct mg_str *client,
 
 	//int Client_Id_position = Connect_Flags_position + 3;
 	int Client_Id_position = Keep_Alive_Id_position + 2;
+	if (*version == 5) {
+		// CONNECT properties sit between Keep Alive and Client Identifier
+		const unsigned char *next = _mg_mqtt5_parse_props(&buf[Client_Id_position], end, props);
+		if (next == NULL) return -1;
+		Client_Id_position = next - buf;
+	}
 	//client->len = buf[Connect_Flags_position+3] << 8 | buf[Connect_Flags_position+4];
 	//client->ptr = (char *)&buf[Connect_Flags_position+5];
+	if (buf + Client_Id_position + 2 > end) return -1;
 	client->len = buf[Client_Id_position] << 8 | buf[Client_Id_position+1];
 	client->ptr = (char *)&buf[Client_Id_position+2];
 	ESP_LOGD("_mg_mqtt_parse_header", "client->len=%d client->ptr=[%.*s]", client->len, client->len, client->ptr);
@@ -146,10 +766,18 @@ int _mg_mqtt_parse_header(struct mg_mqtt_message *msg, struct mg_str *client,
 	ESP_LOGD("_mg_mqtt_parse_header", "next_position=%d", next_position);
 
 	if (will == 1) {
+		if (*version == 5) {
+			// Will properties precede the will topic
+			const unsigned char *next = _mg_mqtt5_parse_props(&buf[next_position], end, will_props);
+			if (next == NULL) return -1;
+			next_position = next - buf;
+		}
+		if (buf + next_position + 2 > end) return -1;
 		topic->len = buf[next_position] << 8 | buf[next_position+1];
 		topic->ptr = (char *)&(buf[next_position]) + 2;
 		ESP_LOGD("_mg_mqtt_parse_header", "topic->len=%d topic->ptr=[%.*s]", topic->len, topic->len, topic->ptr);
 		next_position = next_position + 2 + topic->len;
+		if (buf + next_position + 2 > end) return -1;
 		payload->len = buf[next_position] << 8 | buf[next_position+1];
 		payload->ptr = (char *)&(buf[next_position]) + 2;
 		ESP_LOGD("_mg_mqtt_parse_header", "payload->len=%d payload->ptr=[%.*s]", payload->len, payload->len, payload->ptr);
@@ -157,6 +785,7 @@ int _mg_mqtt_parse_header(struct mg_mqtt_message *msg, struct mg_str *client,
 	}
 
 	if (user == 1) {
+		if (buf + next_position + 2 > end) return -1;
 		username->len = buf[next_position] << 8 | buf[next_position+1];
 		username->ptr = (char *)&(buf[next_position]) + 2;
 		ESP_LOGD("_mg_mqtt_parse_header", "username->len=%d username->ptr=[%.*s]", username->len, username->len, username->ptr);
@@ -164,18 +793,22 @@ int _mg_mqtt_parse_header(struct mg_mqtt_message *msg, struct mg_str *client,
 	}
 
 	if (pass == 1) {
+		if (buf + next_position + 2 > end) return -1;
 		password->len = buf[next_position] << 8 | buf[next_position+1];
 		password->ptr = (char *)&(buf[next_position]) + 2;
 		ESP_LOGD("_mg_mqtt_parse_header", "password->len=%d password->ptr=[%.*s]", password->len, password->len, password->ptr);
 		next_position = next_position + 2 + password->len;
 	}
 
+	if (buf + next_position > end) return -1;
 	return will;
 }
 
 int _mg_mqtt_status() {
 	for (struct client *client = s_clients; client != NULL; client = client->next) {
-		ESP_LOGI(pcTaskGetName(NULL), "CLIENT(ALL) %p [%.*s]", client->c->fd, (int) client->cid.len, client->cid.ptr);
+		ESP_LOGI(pcTaskGetName(NULL), "CLIENT(ALL) %p [%.*s] pub=%"PRIu32" bytes=%"PRIu32" dropped=%"PRIu32" paused=%"PRIu32,
+			client->c->fd, (int) client->cid.len, client->cid.ptr,
+			client->pub_count, client->pub_bytes, client->drop_count, client->pause_count);
 		for (struct will *will = s_wills; will != NULL; will = will->next) {
 			if (client->c != will->c) continue;
 			ESP_LOGI(pcTaskGetName(NULL), "WILL(ALL) %p [%.*s] [%.*s] %d %d", 
@@ -183,7 +816,8 @@ int _mg_mqtt_status() {
 		}
 		for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
 			if (client->c != sub->c) continue;
-			ESP_LOGI(pcTaskGetName(NULL), "SUB(ALL) %p [%.*s]", sub->c->fd, (int) sub->topic.len, sub->topic.ptr);
+			ESP_LOGI(pcTaskGetName(NULL), "SUB(ALL) %p [%.*s] group [%.*s]", sub->c->fd, (int) sub->topic.len, sub->topic.ptr,
+				(int) sub->group.len, sub->group.ptr);
 		}
 	}
 
@@ -234,7 +868,24 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 				int willFlag;
 				uint8_t qos;
 				uint8_t retain;
-				willFlag = _mg_mqtt_parse_header(mm, &cid, &topic, &payload, &username, &password, &qos, &retain);
+				uint8_t version;
+				struct mqtt_props props;
+				struct mqtt_props will_props;
+				willFlag = _mg_mqtt_parse_header(mm, &cid, &topic, &payload, &username, &password, &qos, &retain,
+					&version, &props, &will_props);
+				if (willFlag < 0) {
+					ESP_LOGW(pcTaskGetName(NULL), "CONNECT %p malformed", c->fd);
+					c->is_closing = 1;
+					break;
+				}
+				if (version < 3 || version > 5) {
+					// Connection Refused, unacceptable protocol version
+					_mg_mqtt_connack(c, 4, 1);
+					c->is_draining = 1;
+					break;
+				}
+				// Bad user name or password
+				uint8_t refused = version == 5 ? MQTT_RC_BAD_USERNAME_OR_PASSWORD : 4;
 				ESP_LOGI(pcTaskGetName(NULL), "willFlag=%d cid.len=%d username.len=%d password.len=%d", willFlag, cid.len, username.len, password.len);
 				if (cid.len) 
 					ESP_LOGI(pcTaskGetName(NULL), "cid.len=%d cid.ptr=[%.*s]", cid.len, cid.len, cid.ptr);
@@ -247,18 +898,16 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 				if (username.len != strlen(CONFIG_AUTHENTICATION_USERNAME) ||
 					(strncmp(username.ptr, CONFIG_AUTHENTICATION_USERNAME, username.len) != 0) ) {
 					// Connection Refused, bad user name or password
-					uint8_t response[] = {0, 4};
-					mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
-					mg_send(c, response, sizeof(response));
+					_mg_mqtt_connack(c, version, refused);
+					c->is_draining = 1;
 					break;
 				}
 
 				if (password.len != strlen(CONFIG_AUTHENTICATION_PASSWORD) ||
 					(strncmp(password.ptr, CONFIG_AUTHENTICATION_PASSWORD, password.len) != 0) ) {
 					// Connection Refused, bad user name or password
-					uint8_t response[] = {0, 4};
-					mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
-					mg_send(c, response, sizeof(response));
+					_mg_mqtt_connack(c, version, refused);
+					c->is_draining = 1;
 					break;
 				}
 #endif
@@ -275,15 +924,44 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 				int keepCount = 1; // default is 9 count
 				setsockopt( (int) c->fd, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
 
-#if 0
 				// Client connects. Add to the client-id list
 				struct client *client = calloc(1, sizeof(*client));
+				if (client == NULL) {
+					c->is_closing = 1;
+					break;
+				}
 				client->c = c;
 				client->cid = mg_strdup(cid);
+				client->version = version;
+				client->receive_max = props.receive_max ? props.receive_max : 65535;
+				client->max_packet = props.max_packet;
+				// Connections from our own address are the built-in publisher/subscriber
+				struct sockaddr_in local;
+				socklen_t local_len = sizeof(local);
+				client->local = getsockname((int) c->fd, (struct sockaddr *) &local, &local_len) == 0 &&
+					local.sin_addr.s_addr == c->rem.ip;
+				client->refill_at = mg_millis();
+				client->msg_tokens = (int64_t) s_rate_msgs * 1000;
+				client->byte_tokens = (int64_t) s_rate_bytes * 1000;
+				if (version == 5) {
+					// Subsequent packets on this connection are MQTT 5
+					c->is_mqtt5 = 1;
+					client->alias_in_max = MQTT_SERVER_TOPIC_ALIAS_MAX;
+					client->alias_out_max = props.topic_alias_max < MQTT_SERVER_TOPIC_ALIAS_MAX ?
+						props.topic_alias_max : MQTT_SERVER_TOPIC_ALIAS_MAX;
+					client->alias_in = calloc(client->alias_in_max, sizeof(struct mg_str));
+					client->alias_out = calloc(client->alias_out_max ? client->alias_out_max : 1, sizeof(struct mg_str));
+					if (client->alias_in == NULL || client->alias_out == NULL) {
+						_mg_mqtt_client_free(client);
+						c->is_closing = 1;
+						break;
+					}
+				}
+				c->fn_data = client;
 				LIST_ADD_HEAD(struct client, &s_clients, client);
 				ESP_LOGD(pcTaskGetName(NULL), "CLIENT ADD %p [%.*s]", c->fd, (int) client->cid.len, client->cid.ptr);
-				ESP_LOGI(pcTaskGetName(NULL), "CLIENT ADD %p", client);
-#endif
+				ESP_LOGI(pcTaskGetName(NULL), "CLIENT ADD %p version=%d receive_max=%d alias_out_max=%d",
+					client, version, client->receive_max, client->alias_out_max);
 
 				// Client connects. Add to the will list
 				if (willFlag == 1) {
@@ -293,38 +971,90 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 					will->payload = mg_strdup(payload);
 					will->qos = qos;
 					will->retain = retain;
+					will->expiry = will_props.expiry;
 					LIST_ADD_HEAD(struct will, &s_wills, will);
 					ESP_LOGD(pcTaskGetName(NULL), "WILL ADD %p [%.*s] [%.*s] %d %d", 
 					c->fd, (int) will->topic.len, will->topic.ptr, (int) will->payload.len, will->payload.ptr, will->qos, will->retain);
 				}
 				_mg_mqtt_status();
 
-				// Client connects. Return success, do not check user/password
-				uint8_t response[] = {0, 0};
-				mg_mqtt_send_header(c, MQTT_CMD_CONNACK, 0, sizeof(response));
-				mg_send(c, response, sizeof(response));
+				// Client connects. Return success
+				_mg_mqtt_connack(c, version, 0);
 				break;
 			}
 			case MQTT_CMD_SUBSCRIBE: {
 				// Client subscribe
 				ESP_LOGI(pcTaskGetName(NULL), "MQTT_CMD_SUBSCRIBE");
-				int pos = 4;	// Initial topic offset, where ID ends
+				int v5 = c->is_mqtt5;
+				int pos = _mg_mqtt_hdr_len(mm) + 2;	// Initial topic offset, where ID ends
+				if (v5) {
+					// Skip the SUBSCRIBE properties
+					struct mqtt_props props;
+					const uint8_t *buf = (const uint8_t *) mm->dgram.ptr;
+					const uint8_t *next = _mg_mqtt5_parse_props(buf + pos, buf + mm->dgram.len, &props);
+					if (next == NULL) {
+						_mg_mqtt5_disconnect(c, MQTT_RC_MALFORMED_PACKET);
+						break;
+					}
+					pos = next - buf;
+				}
 				uint8_t qos, resp[256];
 				struct mg_str topic;
 				int num_topics = 0;
-				while ((pos = mg_mqtt_next_sub(mm, &topic, &qos, pos)) > 0) {
-					struct sub *sub = calloc(1, sizeof(*sub));
-					sub->c = c;
-					sub->topic = mg_strdup(topic);
+				while (num_topics < (int) sizeof(resp) && (pos = mg_mqtt_next_sub(mm, &topic, &qos, pos)) > 0) {
+					// MQTT 5 packs No Local and the retain options next to the QoS
+					uint8_t no_local = v5 ? (qos >> 2) & 1 : 0;
+					qos &= 3;
+					if (qos > 1) qos = 1;	// QoS 2 is granted as QoS 1
+					struct mg_str group, filter;
+					int shared = _mg_mqtt_share_parse(topic, &group, &filter);
+					if (topic.len == 0 || shared < 0) {
+						resp[num_topics++] = v5 ? MQTT_RC_TOPIC_FILTER_INVALID : 0x80;
+						continue;
+					}
+					// Subscribing again to the same filter replaces the subscription
+					struct sub *sub = NULL;
+					for (struct sub *old = s_subs; old != NULL; old = old->next) {
+						if (old->c == c && mg_strcmp(old->topic, filter) == 0 && mg_strcmp(old->group, group) == 0) {
+							sub = old;
+							break;
+						}
+					}
+					if (sub == NULL) {
+						sub = calloc(1, sizeof(*sub));
+						sub->c = c;
+						sub->topic = mg_strdup(filter);
+						if (shared) sub->group = mg_strdup(group);
+						SUBS_LOCK();
+						LIST_ADD_HEAD(struct sub, &s_subs, sub);
+						SUBS_UNLOCK();
+					}
 					sub->qos = qos;
-					LIST_ADD_HEAD(struct sub, &s_subs, sub);
-					ESP_LOGI(pcTaskGetName(NULL), "SUB ADD %p [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr);
+					// No Local does not apply to shared subscriptions
+					sub->no_local = shared ? 0 : no_local;
+					sub->fresh = !shared;
+					ESP_LOGI(pcTaskGetName(NULL), "SUB ADD %p [%.*s] group [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr,
+						(int) sub->group.len, sub->group.ptr);
 					resp[num_topics++] = qos;
 				}
-				mg_mqtt_send_header(c, MQTT_CMD_SUBACK, 0, num_topics + 2);
+				mg_mqtt_send_header(c, MQTT_CMD_SUBACK, 0, num_topics + 2 + (v5 ? 1 : 0));
 				uint16_t id = mg_htons(mm->id);
 				mg_send(c, &id, 2);
+				if (v5) {
+					uint8_t props_len = 0;
+					mg_send(c, &props_len, 1);
+				}
 				mg_send(c, resp, num_topics);
+
+				// Retained messages follow the SUBACK
+				for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
+					if (sub->c != c || !sub->fresh) continue;
+					sub->fresh = 0;
+					for (struct retained *r = s_retained; r != NULL; r = r->next) {
+						if (!_mg_mqtt_match(r->topic, sub->topic)) continue;
+						_mg_mqtt_forward(c, r->topic, r->payload, r->qos < sub->qos ? r->qos : sub->qos, 1, 0);
+					}
+				}
 				_mg_mqtt_status();
 				break;
 			}
@@ -332,33 +1062,78 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 				// Client unsubscribes. Remove from the subscription list
 				ESP_LOGI(pcTaskGetName(NULL), "MQTT_CMD_UNSUBSCRIBE");
 				//_mg_mqtt_dump("UNSUBSCRIBE", mm);
-				int pos = 4;	// Initial topic offset, where ID ends
+				int v5 = c->is_mqtt5;
+				int pos = _mg_mqtt_hdr_len(mm) + 2;	// Initial topic offset, where ID ends
+				if (v5) {
+					// Skip the UNSUBSCRIBE properties
+					struct mqtt_props props;
+					const uint8_t *buf = (const uint8_t *) mm->dgram.ptr;
+					const uint8_t *next = _mg_mqtt5_parse_props(buf + pos, buf + mm->dgram.len, &props);
+					if (next == NULL) {
+						_mg_mqtt5_disconnect(c, MQTT_RC_MALFORMED_PACKET);
+						break;
+					}
+					pos = next - buf;
+				}
+				uint8_t resp[256];
+				int num_topics = 0;
 				struct mg_str topic;
-				while ((pos = mg_mqtt_next_unsub(mm, &topic, pos)) > 0) {
+				while (num_topics < (int) sizeof(resp) && (pos = mg_mqtt_next_unsub(mm, &topic, pos)) > 0) {
 					ESP_LOGI(pcTaskGetName(NULL), "UNSUB %p [%.*s]", c->fd, (int) topic.len, topic.ptr);
 					// Remove from the subscription list
 					for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
 						ESP_LOGI(pcTaskGetName(NULL), "SUB[b] %p [%.*s]", sub->c->fd, (int) sub->topic.len, sub->topic.ptr);
 					}
+					uint8_t rc = MQTT_RC_NO_SUBSCRIPTION_EXISTED;
+					struct mg_str group, filter;
+					_mg_mqtt_share_parse(topic, &group, &filter);
 					for (struct sub *next, *sub = s_subs; sub != NULL; sub = next) {
 						next = sub->next;
 						ESP_LOGD(pcTaskGetName(NULL), "c->fd=%p sub->c->fd=%p", c->fd, sub->c->fd);
 						if (c != sub->c) continue;
-						if (strncmp(topic.ptr, sub->topic.ptr, topic.len) != 0) continue;
+						if (mg_strcmp(filter, sub->topic) != 0 || mg_strcmp(group, sub->group) != 0) continue;
 						ESP_LOGI(pcTaskGetName(NULL), "DELETE SUB %p [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr);
-						free((void *)sub->topic.ptr);
+						SUBS_LOCK();
 						LIST_DELETE(struct sub, &s_subs, sub);
-						free(sub);
+						SUBS_UNLOCK();
+						_mg_mqtt_sub_free(sub);
+						rc = MQTT_RC_SUCCESS;
 					}
+					resp[num_topics++] = rc;
 					for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
 						ESP_LOGI(pcTaskGetName(NULL), "SUB[a] %p [%.*s]", sub->c->fd, (int) sub->topic.len, sub->topic.ptr);
 					}
 				}
+				// MQTT 3.1.1 UNSUBACK carries the packet id only
+				uint16_t id = mg_htons(mm->id);
+				if (v5) {
+					uint8_t props_len = 0;
+					mg_mqtt_send_header(c, MQTT_CMD_UNSUBACK, 0, num_topics + 3);
+					mg_send(c, &id, 2);
+					mg_send(c, &props_len, 1);
+					mg_send(c, resp, num_topics);
+				} else {
+					mg_mqtt_send_header(c, MQTT_CMD_UNSUBACK, 0, 2);
+					mg_send(c, &id, 2);
+				}
 				_mg_mqtt_status();
 				break;
 			}
 			case MQTT_CMD_PUBLISH: {
 				// Client published message. Push to all subscribed channels
+				struct client *client = (struct client *) fn_data;
+				struct mqtt_props props;
+				memset(&props, 0, sizeof(props));
+				// Resolve the topic alias before throttling: a dropped QoS 0 PUBLISH may still define
+				// an alias that the client's next alias-only PUBLISH relies on
+				if (client != NULL && client->version == 5) {
+					uint8_t rc = _mg_mqtt5_parse_publish(client, mm, &props);
+					if (rc != MQTT_RC_SUCCESS) {
+						_mg_mqtt5_disconnect(c, rc);
+						break;
+					}
+				}
+				if (client != NULL && !_mg_mqtt_rate_check(client, mm)) break;
 				//ESP_LOGI(pcTaskGetName(NULL), "mm->data.ptr[0]=0x%x", mm->data.ptr[0]);
 				//if (isascii(mm->data.ptr[0])) {
 				// Make sure all characters are ASCII codes
@@ -369,13 +1144,37 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 					ESP_LOGI(pcTaskGetName(NULL), "PUB %p [BINARY] -> [%.*s]", c->fd,
 						(int) mm->topic.len, mm->topic.ptr);
 				}
-				for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
-					if (_mg_strcmp(mm->topic, sub->topic) != 0) continue;
-					//mg_mqtt_pub(sub->c, &mm->topic, &mm->data);
-					//mg_mqtt_pub(sub->c, &mm->topic, &mm->data, 1, false);
-					//for Ver7.6
-					mg_mqtt_pub(sub->c, mm->topic, mm->data, 1, false);
+				if (mm->topic.len >= 5 && strncmp(mm->topic.ptr, "$SYS/", 5) == 0) {
+					// $SYS belongs to the broker
+					ESP_LOGW(pcTaskGetName(NULL), "PUB %p [%.*s] refused", c->fd, (int) mm->topic.len, mm->topic.ptr);
+					STAT_ADD(dropped, 1);
+					break;
+				}
+				if (mm->dgram.ptr[0] & 1) {
+					// RETAIN flag
+					_mg_mqtt_retain(mm->topic, mm->data, mm->qos);
 				}
+				//mg_mqtt_pub(sub->c, &mm->topic, &mm->data);
+				//mg_mqtt_pub(sub->c, &mm->topic, &mm->data, 1, false);
+				_mg_mqtt_route(c, mm->topic, mm->data, mm->qos, 0, props.expiry);
+				break;
+			}
+			case MQTT_CMD_PUBACK: {
+				// Subscriber acknowledged a QoS 1 message, the receive window opens again
+				struct client *client = (struct client *) fn_data;
+				if (client == NULL) break;
+				if (client->inflight) client->inflight--;
+				_mg_mqtt_flush_pending(client);
+				break;
+			}
+			case MQTT_CMD_DISCONNECT: {
+				// Normal disconnection discards the will, MQTT 5 may ask to keep it
+				const uint8_t *buf = (const uint8_t *) mm->dgram.ptr;
+				size_t hdr_len = _mg_mqtt_hdr_len(mm);
+				uint8_t reason = (c->is_mqtt5 && mm->dgram.len > hdr_len) ? buf[hdr_len] : MQTT_RC_SUCCESS;
+				ESP_LOGI(pcTaskGetName(NULL), "DISCONNECT %p reason=0x%02x", c->fd, reason);
+				if (reason != MQTT_RC_DISCONNECT_WITH_WILL) _mg_mqtt_will_delete(c);
+				c->is_draining = 1;
 				break;
 			}
 			case MQTT_CMD_PINGREQ: {
@@ -402,9 +1201,9 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 			if (c != client->c) continue;
 			ESP_LOGD(pcTaskGetName(NULL), "CLIENT DEL %p [%.*s]", c->fd, (int) client->cid.len, client->cid.ptr);
 			ESP_LOGI(pcTaskGetName(NULL), "CLIENT DEL %p", client);
-			free((void *)client->cid.ptr);
 			LIST_DELETE(struct client, &s_clients, client);
-			free(client);
+			_mg_mqtt_client_free(client);
+			c->fn_data = NULL;
 		}
 		for (struct client *client = s_clients; client != NULL; client = client->next) {
 			ESP_LOGD(pcTaskGetName(NULL), "CLIENT(a) %p [%.*s]", client->c->fd, (int) client->cid.len, client->cid.ptr);
@@ -419,27 +1218,25 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 			ESP_LOGD(pcTaskGetName(NULL), "c->fd=%p sub->c->fd=%p", c->fd, sub->c->fd);
 			if (c != sub->c) continue;
 			ESP_LOGD(pcTaskGetName(NULL), "SUB DEL %p [%.*s]", c->fd, (int) sub->topic.len, sub->topic.ptr);
-			free((void *)sub->topic.ptr);
+			SUBS_LOCK();
 			LIST_DELETE(struct sub, &s_subs, sub);
-			free(sub);
+			SUBS_UNLOCK();
+			_mg_mqtt_sub_free(sub);
 		}
 
 		// Judgment to send will
 		for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) {
 			ESP_LOGD(pcTaskGetName(NULL), "SUB[a] %p [%.*s]", sub->c->fd, (int) sub->topic.len, sub->topic.ptr);
-			for (struct will *will = s_wills; will != NULL; will = will->next) {
-				ESP_LOGD(pcTaskGetName(NULL), "WILL(ALL) %p [%.*s] [%.*s] %d %d", 
-					will->c->fd, (int) will->topic.len, will->topic.ptr, (int) will->payload.len, will->payload.ptr, will->qos, will->retain);
-				//if (c == will->c) continue;
-				if (sub->c == will->c) continue;
-				ESP_LOGD(pcTaskGetName(NULL), "WILL(CMP) %p [%.*s] [%.*s] %d %d", 
-					will->c->fd, (int) will->topic.len, will->topic.ptr, (int) will->payload.len, will->payload.ptr, will->qos, will->retain);
-				if (_mg_strcmp(will->topic, sub->topic) != 0) continue;
-				//mg_mqtt_pub(sub->c, &will->topic, &will->payload);
-				//mg_mqtt_pub(sub->c, &will->topic, &will->payload, 1, false);
-				//for Ver7.6
-				mg_mqtt_pub(sub->c, will->topic, will->payload, 1, false);
-			}
+		}
+		for (struct will *will = s_wills; will != NULL; will = will->next) {
+			ESP_LOGD(pcTaskGetName(NULL), "WILL(ALL) %p [%.*s] [%.*s] %d %d", 
+				will->c->fd, (int) will->topic.len, will->topic.ptr, (int) will->payload.len, will->payload.ptr, will->qos, will->retain);
+			// Only the will of the closing connection is due
+			if (c != will->c) continue;
+			//mg_mqtt_pub(sub->c, &will->topic, &will->payload);
+			//mg_mqtt_pub(sub->c, &will->topic, &will->payload, 1, false);
+			if (will->retain) _mg_mqtt_retain(will->topic, will->payload, will->qos);
+			_mg_mqtt_route(c, will->topic, will->payload, will->qos, false, will->expiry);
 		}
 
 		// Client disconnects. Remove from the will list
@@ -468,6 +1265,66 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 	(void) fn_data;
 }
 
+// Publish one retained $SYS value
+static void _mg_mqtt_sys_pub(const char *name, uint32_t value) {
+	char topic[64], payload[16];
+	snprintf(topic, sizeof(topic), "$SYS/broker/%s", name);
+	snprintf(payload, sizeof(payload), "%"PRIu32, value);
+	_mg_mqtt_retain(mg_str(topic), mg_str(payload), 0);
+	_mg_mqtt_route(NULL, mg_str(topic), mg_str(payload), 0, 0, 0);
+}
+
+// Aggregate the counters and publish the $SYS tree
+static void _mg_mqtt_sys_timer(void *arg) {
+	static uint64_t last_at = 0;
+	static uint32_t last_msgs_in, last_msgs_out, last_bytes_in, last_bytes_out;
+	uint64_t now = mg_millis();
+	uint32_t elapsed = (uint32_t) (now - last_at);
+	last_at = now;
+	if (elapsed == 0) elapsed = 1;
+
+	uint32_t clients = 0, subs = 0, inflight = 0, pending = 0, send_max = 0;
+	for (struct client *client = s_clients; client != NULL; client = client->next) {
+		clients++;
+		inflight += client->inflight;
+		pending += client->pending_cnt;
+		if (client->c->send.len > send_max) send_max = client->c->send.len;
+	}
+	for (struct sub *sub = s_subs; sub != NULL; sub = sub->next) subs++;
+
+	uint32_t msgs_in = atomic_load_explicit(&s_stats.msgs_in, memory_order_relaxed);
+	uint32_t msgs_out = atomic_load_explicit(&s_stats.msgs_out, memory_order_relaxed);
+	uint32_t bytes_in = atomic_load_explicit(&s_stats.bytes_in, memory_order_relaxed);
+	uint32_t bytes_out = atomic_load_explicit(&s_stats.bytes_out, memory_order_relaxed);
+	uint32_t dropped = atomic_load_explicit(&s_stats.dropped, memory_order_relaxed);
+
+	_mg_mqtt_sys_pub("uptime", (uint32_t) (now / 1000));
+	_mg_mqtt_sys_pub("clients/connected", clients);
+	_mg_mqtt_sys_pub("subscriptions/count", subs);
+	_mg_mqtt_sys_pub("retained/count", s_retained_cnt);
+	_mg_mqtt_sys_pub("messages/received", msgs_in);
+	_mg_mqtt_sys_pub("messages/sent", msgs_out);
+	_mg_mqtt_sys_pub("messages/dropped", dropped);
+	_mg_mqtt_sys_pub("messages/inflight", inflight);
+	_mg_mqtt_sys_pub("messages/pending", pending);
+	_mg_mqtt_sys_pub("bytes/received", bytes_in);
+	_mg_mqtt_sys_pub("bytes/sent", bytes_out);
+	_mg_mqtt_sys_pub("load/messages/received", (uint32_t) ((uint64_t) (msgs_in - last_msgs_in) * 1000 / elapsed));
+	_mg_mqtt_sys_pub("load/messages/sent", (uint32_t) ((uint64_t) (msgs_out - last_msgs_out) * 1000 / elapsed));
+	_mg_mqtt_sys_pub("load/bytes/received", (uint32_t) ((uint64_t) (bytes_in - last_bytes_in) * 1000 / elapsed));
+	_mg_mqtt_sys_pub("load/bytes/sent", (uint32_t) ((uint64_t) (bytes_out - last_bytes_out) * 1000 / elapsed));
+	_mg_mqtt_sys_pub("send_buffer/max", send_max);
+	_mg_mqtt_sys_pub("heap/free", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+	_mg_mqtt_sys_pub("heap/largest_free_block", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+	// Loads are computed from the counters before this round of $SYS traffic
+	last_msgs_in = msgs_in;
+	last_msgs_out = atomic_load_explicit(&s_stats.msgs_out, memory_order_relaxed);
+	last_bytes_in = bytes_in;
+	last_bytes_out = atomic_load_explicit(&s_stats.bytes_out, memory_order_relaxed);
+	(void) arg;
+}
+
 void mqtt_server(void *pvParameters)
 {
 	/* Starting Broker */
@@ -476,7 +1333,10 @@ void mqtt_server(void *pvParameters)
 	//mg_log_set(1); // Set to log level to LL_ERROR
 	mg_log_set(3); // Set to log level to LL_DEBUG
 	mg_mgr_init(&mgr);
+	s_subs_lock = xSemaphoreCreateMutex();
 	mg_mqtt_listen(&mgr, s_listen_on, fn, NULL); // Create MQTT listener
+	mg_timer_add(&mgr, 100, MG_TIMER_REPEAT, _mg_mqtt_rate_timer, NULL); // Rate limit bookkeeping
+	mg_timer_add(&mgr, MQTT_SERVER_SYS_INTERVAL_MS, MG_TIMER_REPEAT, _mg_mqtt_sys_timer, NULL); // $SYS statistics
 	//ESP_LOGI(pcTaskGetName(NULL), "Starting Mongoose v%s MQTT Server", MG_VERSION);
 
 	/* Processing events */
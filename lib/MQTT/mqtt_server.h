@@ -7,11 +7,60 @@ extern "C" {
 
 #include "mongoose.h"
 
+// MQTT 5 limits advertised in CONNACK
+#define MQTT_SERVER_TOPIC_ALIAS_MAX 16			// Topic aliases accepted per client
+#define MQTT_SERVER_MAX_PACKET_SIZE (8 * 1024)	// Largest packet accepted from a client
+#define MQTT_SERVER_PENDING_MAX 16				// QoS 1 messages parked per client when its receive window is full
+
+// Per-client publish rate limit defaults, 0 disables the limit
+#define MQTT_SERVER_RATE_MSGS_DEFAULT 50		// PUBLISH packets per second
+#define MQTT_SERVER_RATE_BYTES_DEFAULT 32768	// PUBLISH bytes per second
+
+#define MQTT_SERVER_RETAIN_MAX 64				// Retained topics kept, $SYS included
+#define MQTT_SERVER_SYS_INTERVAL_MS 5000		// $SYS statistics publish period
+
+// A QoS 1 message waiting for the client's receive window, held in memory
+struct pending {
+  struct pending *next;
+  struct mg_str topic;
+  struct mg_str payload;
+  uint64_t expire_at;	// mg_millis() deadline, 0 means never expires
+  uint8_t retain;
+};
+
+// A list of retained message, held in memory
+struct retained {
+  struct retained *next;
+  struct mg_str topic;
+  struct mg_str payload;
+  uint8_t qos;
+};
+
 // A list of client, held in memory
 struct client {
   struct client *next;
   struct mg_connection *c;
   struct mg_str cid;
+  uint8_t version;			// Protocol level, 3/4 (3.1/3.1.1) or 5
+  uint16_t receive_max;		// Client's Receive Maximum, QoS 1 window
+  uint16_t inflight;		// QoS 1 PUBLISH sent and not yet acknowledged
+  uint32_t max_packet;		// Client's Maximum Packet Size, 0 means no limit
+  uint16_t alias_in_max;	// Topic aliases the client may use towards us
+  uint16_t alias_out_max;	// Topic aliases we may use towards the client
+  uint16_t alias_out_cnt;	// Topic aliases already assigned towards the client
+  struct mg_str *alias_in;	// alias_in[alias - 1] = topic, client -> broker
+  struct mg_str *alias_out;	// alias_out[alias - 1] = topic, broker -> client
+  struct pending *pending;	// Messages waiting for receive window
+  uint16_t pending_cnt;
+  uint8_t local;			// Broker's own publisher/subscriber, never throttled
+  uint8_t paused;			// Reads paused by the rate limit
+  int64_t msg_tokens;		// Token buckets in 1/1000 units, negative while in debt
+  int64_t byte_tokens;
+  uint64_t refill_at;		// mg_millis() of the last refill
+  uint32_t pub_count;		// PUBLISH received
+  uint32_t pub_bytes;		// PUBLISH bytes received
+  uint32_t drop_count;		// QoS 0 PUBLISH dropped by the rate limit
+  uint32_t pause_count;		// Times reads were paused by the rate limit
 };
 
 // A list of subscription, held in memory
@@ -20,6 +69,11 @@ struct sub {
   struct mg_connection *c;
   struct mg_str topic;
   uint8_t qos;
+  uint8_t no_local;		// MQTT 5 No Local option
+  struct mg_str group;	// Shared subscription group ($share/group/topic), empty if not shared
+  uint32_t routed;		// Message sequence this entry was last considered for
+  uint32_t picked;		// Message sequence this member last received, for round-robin
+  uint8_t fresh;		// Just (re)subscribed, retained messages are due
 };
 
 // A list of will topic & message, held in memory
@@ -30,9 +84,16 @@ struct will {
   struct mg_str payload;
   uint8_t qos;
   uint8_t retain;
+  uint32_t expiry;		// MQTT 5 Message Expiry Interval of the will, 0 means none
 };
 
 void mqtt_server(void *pvParameters);
+void mqtt_server_set_rate_limit(uint32_t msgs_per_sec, uint32_t bytes_per_sec);
+// Whether any subscription matches topic, a topic ending in "/#" asks for anything at or below that prefix.
+// Safe to call from other tasks, returns true until the broker is running.
+bool mqtt_server_has_subscriber(const char *topic);
+// Largest client send buffer in bytes, refreshed every 100 ms
+uint32_t mqtt_server_backlog(void);
 #ifdef __cplusplus
 }
 #endif
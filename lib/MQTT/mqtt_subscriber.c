@@ -11,17 +11,111 @@
 #include "mqtt_subscriber.h"
 #include "mqtt_auth.h"
 
+// Record layout: uint16 topic length, uint16 payload length, topic '\0', payload '\0', padded to 4 bytes.
+// A record never wraps: when it does not fit before the end of the ring a pad marker skips to the start.
+#define MAILBOX_HDR 4
+#define MAILBOX_PAD 0xFFFF
+#define MAILBOX_ALIGN(n) (((n) + 3) & ~3u)
+
+static uint8_t s_mailbox[MQTT_SUB_MAILBOX_SIZE] __attribute__((aligned(4)));
+static uint32_t s_mailbox_head = 0;	// Written by the producer, free-running
+static uint32_t s_mailbox_tail = 0;	// Written by the consumer, free-running
+static uint32_t s_mailbox_taken = 0; // Size of the record handed out by take()
+static uint32_t s_mailbox_dropped = 0;
+static SemaphoreHandle_t s_mailbox_sem = NULL;
+
+bool mqtt_sub_mailbox_init(void)
+{
+	if (s_mailbox_sem == NULL)
+		s_mailbox_sem = xSemaphoreCreateBinary();
+	return s_mailbox_sem != NULL;
+}
+
+bool mqtt_sub_mailbox_post(const char *topic, size_t topic_len, const char *payload, size_t len)
+{
+	uint32_t need = MAILBOX_ALIGN(MAILBOX_HDR + topic_len + 1 + len + 1);
+	if (topic_len + len > MQTT_SUB_MSG_MAX || s_mailbox_sem == NULL)
+	{
+		s_mailbox_dropped++;
+		return false;
+	}
+	uint32_t head = s_mailbox_head;
+	uint32_t tail = __atomic_load_n(&s_mailbox_tail, __ATOMIC_ACQUIRE);
+	uint32_t pos = head % MQTT_SUB_MAILBOX_SIZE;
+	uint32_t pad = pos + need > MQTT_SUB_MAILBOX_SIZE ? MQTT_SUB_MAILBOX_SIZE - pos : 0;
+	if (MQTT_SUB_MAILBOX_SIZE - (head - tail) < pad + need)
+	{
+		s_mailbox_dropped++;
+		return false;
+	}
+	if (pad > 0)
+	{
+		uint16_t marker[2] = {MAILBOX_PAD, 0};
+		memcpy(&s_mailbox[pos], marker, MAILBOX_HDR);
+		pos = 0;
+	}
+	uint8_t *rec = &s_mailbox[pos];
+	uint16_t hdr[2] = {(uint16_t)topic_len, (uint16_t)len};
+	memcpy(rec, hdr, MAILBOX_HDR);
+	memcpy(rec + MAILBOX_HDR, topic, topic_len);
+	rec[MAILBOX_HDR + topic_len] = '\0';
+	memcpy(rec + MAILBOX_HDR + topic_len + 1, payload, len);
+	rec[MAILBOX_HDR + topic_len + 1 + len] = '\0';
+	__atomic_store_n(&s_mailbox_head, head + pad + need, __ATOMIC_RELEASE);
+	xSemaphoreGive(s_mailbox_sem);
+	return true;
+}
+
+bool mqtt_sub_mailbox_take(mqtt_sub_msg_t *msg, TickType_t wait)
+{
+	for (;;)
+	{
+		uint32_t tail = s_mailbox_tail;
+		if (__atomic_load_n(&s_mailbox_head, __ATOMIC_ACQUIRE) == tail)
+		{
+			// The producer gives the semaphore after every record, re-check the ring after each wake-up
+			if (xSemaphoreTake(s_mailbox_sem, wait) != pdTRUE)
+				return false;
+			continue;
+		}
+		uint32_t pos = tail % MQTT_SUB_MAILBOX_SIZE;
+		uint16_t hdr[2];
+		memcpy(hdr, &s_mailbox[pos], MAILBOX_HDR);
+		if (hdr[0] == MAILBOX_PAD)
+		{
+			__atomic_store_n(&s_mailbox_tail, tail + (MQTT_SUB_MAILBOX_SIZE - pos), __ATOMIC_RELEASE);
+			continue;
+		}
+		msg->topic = (const char *)&s_mailbox[pos + MAILBOX_HDR];
+		msg->payload = msg->topic + hdr[0] + 1;
+		msg->len = hdr[1];
+		s_mailbox_taken = MAILBOX_ALIGN(MAILBOX_HDR + hdr[0] + 1 + hdr[1] + 1);
+		return true;
+	}
+}
+
+void mqtt_sub_mailbox_release(void)
+{
+	__atomic_store_n(&s_mailbox_tail, s_mailbox_tail + s_mailbox_taken, __ATOMIC_RELEASE);
+	s_mailbox_taken = 0;
+}
+
+uint32_t mqtt_sub_mailbox_dropped(void)
+{
+	return s_mailbox_dropped;
+}
+
 
 #if CONFIG_SUBSCRIBE
 
-static const char *sub_topic = "topic_output";
+static const char *sub_topic = MQTT_SUB_TOPIC;
+static const char *sub_port_topic = MQTT_SUB_TOPIC "/+";
 static const char *will_topic = "WILL";
 
 static EventGroupHandle_t s_wifi_event_group;
 /* The event group allows multiple bits for each event, but we only care about one event
  * - are we connected to the MQTT? */
 static int MQTT_CONNECTED_BIT = BIT0;
-extern QueueHandle_t mqttSubQueue;
 
 static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
   if (ev == MG_EV_ERROR) {
@@ -61,16 +155,9 @@ static void fn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
 	// 			  (int) mm->topic.len, mm->topic.ptr);
 	// printf(" MQTT RECEIVED %.*s <- %.*s", (int) mm->data.len, mm->data.ptr,
 	// 			  (int) mm->topic.len, mm->topic.ptr);
-	MQTTMessage mqttMsg;
-	strncpy(mqttMsg.topic, mm->topic.ptr, mm->topic.len);  // 复制主题
-	mqttMsg.topic[mm->topic.len] = '\0';  // 确保字符串结尾
-	
-	strncpy(mqttMsg.message, mm->data.ptr, mm->data.len);  // 复制消息内容
-	mqttMsg.message[mm->data.len] = '\0';  // 确保字符串结尾
-	
-	// 将消息放入队列
-	if (xQueueSend(mqttSubQueue, &mqttMsg, 0) != pdPASS) {
-		ESP_LOGE(pcTaskGetName(NULL), "Failed to send message to queue");
+	// Copied straight from the receive buffer into the mailbox, only the real length
+	if (!mqtt_sub_mailbox_post(mm->topic.ptr, mm->topic.len, mm->data.ptr, mm->data.len)) {
+		ESP_LOGE(pcTaskGetName(NULL), "Command dropped (%u bytes), mailbox full or too large", (unsigned)mm->data.len);
 	}
   }
 
@@ -137,6 +224,8 @@ void mqtt_subscriber(void *pvParameters)
 			//for Ver7.6
 			mg_mqtt_sub(mgc, topic, 0);
 			printf("MQTT GET:%.*s\n",(int) topic.len, topic.ptr);
+			// Raw per-port frames (WS2812), kept out of JSON
+			mg_mqtt_sub(mgc, mg_str(sub_port_topic), 0);
 			// ESP_LOGI(pcTaskGetName(NULL), "SUBSCRIBED to %.*s", );
 		}
 		mg_mgr_poll(&mgr, 0);
@@ -6,17 +6,41 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "mongoose.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
-#define MAX_MQTT_PAYLOAD_LEN 1024
+// Topic of JSON commands; <topic>/p<n> carries raw binary data for IO port n
+#define MQTT_SUB_TOPIC "topic_output"
+
+// Command mailbox: a byte ring of length-prefixed records between the subscriber (single
+// producer) and the command handler (single consumer). A command costs its real size, the
+// consumer reads it in place and releases it when done.
+#ifndef MQTT_SUB_MAILBOX_SIZE
+#define MQTT_SUB_MAILBOX_SIZE 8192
+#endif
+// Largest topic + payload a record can hold, half the ring so a record always fits once drained
+#define MQTT_SUB_MSG_MAX (MQTT_SUB_MAILBOX_SIZE / 2 - 8)
+
+// A command taken from the mailbox, pointing into the ring until mqtt_sub_mailbox_release()
 typedef struct {
-    char topic[32];
-    char message[MAX_MQTT_PAYLOAD_LEN];
-} MQTTMessage;
+    const char *topic;   // '\0' terminated
+    const char *payload; // '\0' terminated
+    size_t len;
+} mqtt_sub_msg_t;
+
+bool mqtt_sub_mailbox_init(void);
+// Copy a command into the ring, false if it is too large or the ring is full (the command is dropped)
+bool mqtt_sub_mailbox_post(const char *topic, size_t topic_len, const char *payload, size_t len);
+// Wait for the next command, false on timeout
+bool mqtt_sub_mailbox_take(mqtt_sub_msg_t *msg, TickType_t wait);
+// Free the command returned by the last mqtt_sub_mailbox_take()
+void mqtt_sub_mailbox_release(void);
+// Commands dropped because they were too large or the ring was full
+uint32_t mqtt_sub_mailbox_dropped(void);
 
 void mqtt_subscriber(void *pvParameters);
 #ifdef __cplusplus
@@ -143,7 +143,17 @@ void USB_MSC::setup()
         "P4: output\n"
         "P5: servo180\n"
         "P6: servo180\n"
-        "State_LED: on\n";
+        "State_LED: on\n"
+        "Rate_Limit_Msgs: 50/s\n"
+        "Rate_Limit_Bytes: 32768/s\n"
+        "Report_Mode: all\n"
+        "Deadband_Default: 0, 10s\n"
+        "Topic_Mode: aggregate\n"
+        "Payload_Format: json\n"
+        "Batch_Default: 0\n"
+        "Adaptive_Rate: on\n"
+        "Poll_Mode: demand\n"
+        "NTP_Server: pool.ntp.org\n";
     const char *configMessage = config.c_str();
     writeFile(FFat, "/config.txt", configMessage);
   }
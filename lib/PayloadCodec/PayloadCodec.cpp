@@ -0,0 +1,201 @@
+/**
+ * @file    PayloadCodec.cpp
+ * @brief   传感器负载编码模块实现
+ */
+#include "PayloadCodec.h"
+#include <algorithm>
+
+static_assert(PAYLOAD_IO_PORT_NUM == IO_PORT_NUM, "PAYLOAD_IO_PORT_NUM must match IO_PORT_NUM");
+
+static const char *formatName(PayloadFormat format) {
+  switch (format) {
+  case PAYLOAD_MSGPACK:
+    return "msgpack";
+  case PAYLOAD_CBOR:
+    return "cbor";
+  default:
+    return "json";
+  }
+}
+
+PayloadCodec::PayloadCodec() : _format(PAYLOAD_JSON), _nextId(PAYLOAD_DYNAMIC_FIELD_BASE), _dirty(true) {
+  _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief 从配置键值对读取负载格式
+ */
+void PayloadCodec::config(KeyValue *kv_pairs, int count) {
+  PayloadFormat format = PAYLOAD_JSON;
+  const char *val = get_value_case_insensitive(kv_pairs, count, "Payload_Format");
+  if (val != NULL) {
+    if (strcasecmp(val, "msgpack") == 0 || strcasecmp(val, "messagepack") == 0) {
+      format = PAYLOAD_MSGPACK;
+    } else if (strcasecmp(val, "cbor") == 0) {
+      format = PAYLOAD_CBOR;
+    } else if (strcasecmp(val, "json") != 0) {
+      printf("[Info]Payload_Format invalid: %s, use json\n", val);
+    }
+  }
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _format = format;
+  _dirty = true;
+  xSemaphoreGive(_mutex);
+  printf("[Info]Payload_Format: %s\n", formatName(format));
+}
+
+/**
+ * @brief 查找字段ID，表外字段按出现顺序分配新ID
+ *
+ * @param path 字段路径，如 "Temperature"、"acc.x"、"p1_input_val"
+ * @return uint16_t 字段ID
+ */
+uint16_t PayloadCodec::_fieldId(const char *path) {
+  uint16_t fixed = _fields.find(path);
+  if (fixed != 0) {
+    return fixed;
+  }
+  auto it = std::lower_bound(_dynamic.begin(), _dynamic.end(), path,
+                             [](const DynamicField &f, const char *key) { return strcmp(f.name, key) < 0; });
+  if (it != _dynamic.end() && strcmp(it->name, path) == 0) {
+    return it->id;
+  }
+  DynamicField field;
+  strncpy(field.name, path, sizeof(field.name) - 1);
+  field.name[sizeof(field.name) - 1] = '\0';
+  field.id = _nextId++;
+  _dynamic.insert(it, field);
+  _dirty = true;
+  return field.id;
+}
+
+size_t PayloadCodec::_countLeaves(JsonObjectConst obj) {
+  size_t n = 0;
+  for (JsonPairConst kv : obj) {
+    if (kv.value().is<JsonObjectConst>()) {
+      n += _countLeaves(kv.value().as<JsonObjectConst>());
+    } else {
+      n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief 写入单个值
+ *
+ * @details 整数值（含"12.00"这类小数部分为0的值）按最短整数编码，其余数值为单精度浮点，
+ *          数组（批量上报的列）逐个元素编码
+ */
+void PayloadCodec::_writeValue(PayloadWriter &w, JsonVariantConst v) {
+  if (v.is<bool>()) {
+    w.boolean(v.as<bool>());
+  } else if (v.is<uint64_t>() && !v.is<uint32_t>()) {
+    // 超出32位的整数（UTC毫秒时间戳）
+    w.uint64(v.as<uint64_t>());
+  } else if (v.is<double>()) {
+    double d = v.as<double>();
+    if (d >= INT32_MIN && d <= INT32_MAX && d == (double)(int32_t)d) {
+      w.sint((int32_t)d);
+    } else {
+      w.real((float)d);
+    }
+  } else if (v.is<const char *>()) {
+    const char *s = v.as<const char *>();
+    w.str(s, strlen(s));
+  } else if (v.is<JsonArrayConst>()) {
+    JsonArrayConst arr = v.as<JsonArrayConst>();
+    w.array(arr.size());
+    for (JsonVariantConst item : arr) {
+      _writeValue(w, item);
+    }
+  } else {
+    w.nil();
+  }
+}
+
+/**
+ * @brief 写入对象的所有叶子字段
+ *
+ * @param path 路径缓冲区（PAYLOAD_PATH_MAX字节），前len字节为上一级路径
+ * @param len 上一级路径长度，顶层为0
+ * @details 路径在栈上的缓冲区中逐级拼接，不为每个字段分配String
+ */
+void PayloadCodec::_writeObject(PayloadWriter &w, JsonObjectConst obj, char *path, size_t len) {
+  for (JsonPairConst kv : obj) {
+    size_t n = len;
+    if (n > 0 && n < PAYLOAD_PATH_MAX - 1) {
+      path[n++] = '.';
+    }
+    const char *key = kv.key().c_str();
+    while (*key && n < PAYLOAD_PATH_MAX - 1) {
+      path[n++] = *key++;
+    }
+    path[n] = '\0';
+    if (kv.value().is<JsonObjectConst>()) {
+      _writeObject(w, kv.value().as<JsonObjectConst>(), path, n);
+      continue;
+    }
+    w.uint(_fieldId(path));
+    _writeValue(w, kv.value());
+  }
+}
+
+/**
+ * @brief 把JSON对象编码为 {字段ID: 值} 映射
+ */
+size_t PayloadCodec::encode(JsonObjectConst obj, uint8_t *buf, size_t cap) {
+  PayloadWriter w(buf, cap, _format);
+  char path[PAYLOAD_PATH_MAX];
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  w.map(_countLeaves(obj));
+  _writeObject(w, obj, path, 0);
+  xSemaphoreGive(_mutex);
+  return w.overflow() ? 0 : w.size();
+}
+
+/**
+ * @brief 编码单个值
+ */
+size_t PayloadCodec::encodeValue(JsonVariantConst v, uint8_t *buf, size_t cap) {
+  PayloadWriter w(buf, cap, _format);
+  _writeValue(w, v);
+  return w.overflow() ? 0 : w.size();
+}
+
+/**
+ * @brief 获取待发布的字段描述
+ */
+bool PayloadCodec::takeSchema(String &out) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  if (!_dirty) {
+    xSemaphoreGive(_mutex);
+    return false;
+  }
+  JsonDocument doc;
+  doc["format"] = formatName(_format);
+  JsonObject fields = doc["fields"].to<JsonObject>();
+  char id[8];
+  for (size_t i = 1; i < kPayloadFieldCount; i++) {
+    snprintf(id, sizeof(id), "%u", (unsigned)i);
+    fields[String(id)] = kPayloadFieldNames[i];
+  }
+  for (size_t b = 0; b < kPayloadIOFieldBlockCount; b++) {
+    const PayloadIOFieldBlock &block = kPayloadIOFieldBlocks[b];
+    for (int port = 0; port < IO_PORT_NUM; port++) {
+      for (uint8_t i = 0; i < block.count; i++) {
+        snprintf(id, sizeof(id), "%u", (unsigned)(block.base + port * block.stride + i));
+        fields[String(id)] = String("p" + String(port + 1) + "_" + block.names[i]);
+      }
+    }
+  }
+  for (const auto &field : _dynamic) {
+    snprintf(id, sizeof(id), "%u", (unsigned)field.id);
+    fields[String(id)] = field.name;
+  }
+  _dirty = false;
+  xSemaphoreGive(_mutex);
+  out = "";
+  serializeJson(doc, out);
+  return true;
+}
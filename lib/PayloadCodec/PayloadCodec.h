@@ -0,0 +1,82 @@
+/**
+ * @file    PayloadCodec.h
+ * @brief   传感器负载编码模块头文件
+ *
+ * @details 把传感器JSON数据编码为MessagePack或CBOR，映射的键为字段ID而非字段名：
+ *          - 1~127：I2C传感器字段，固定表，只追加不修改
+ *          - 128~175：IO口字段，128 + (端口号-1)*8 + 字段序号
+ *          - 176~187：IO口扩展字段（每口8个已用满后追加的字段），176 + (端口号-1)*2 + 字段序号
+ *          - 256起：表外字段，按出现顺序分配
+ *          嵌套字段展开为"."连接的路径（如"acc.x"），编码结果为扁平映射 {字段ID: 值}。
+ *          字段ID与名称的对应关系以JSON描述发布到保留主题 <前缀>/schema。
+ *          配置项（config.txt）：Payload_Format: json | msgpack | cbor，默认json。
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "ArduinoJson.h"
+#include "PayloadWriter.h"
+#include "PayloadFields.h"
+
+#define PAYLOAD_FRAME_MAX 4096      ///< 单条编码负载最大长度（含批量上报）
+#define PAYLOAD_PATH_MAX 64         ///< 字段路径最大长度（含结束符），超长路径截断
+
+class PayloadCodec {
+public:
+    PayloadCodec();
+
+    /**
+     * @brief 从配置键值对读取负载格式
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     * @details 重新配置后描述信息需重新发布
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /** @brief 当前负载格式 */
+    PayloadFormat format() const { return _format; }
+
+    /** @brief 是否使用二进制格式 */
+    bool binary() const { return _format != PAYLOAD_JSON; }
+
+    /**
+     * @brief 把JSON对象编码为 {字段ID: 值} 映射
+     * @param obj 传感器数据对象
+     * @param buf 输出缓冲区
+     * @param cap 缓冲区容量
+     * @return size_t 编码长度，缓冲区不足时返回0
+     */
+    size_t encode(JsonObjectConst obj, uint8_t *buf, size_t cap);
+
+    /**
+     * @brief 编码单个值（按字段发布时使用）
+     * @return size_t 编码长度，缓冲区不足时返回0
+     */
+    size_t encodeValue(JsonVariantConst v, uint8_t *buf, size_t cap);
+
+    /**
+     * @brief 获取待发布的字段描述
+     * @param out 输出：{"format":..,"fields":{"ID":"名称",...}}
+     * @return true 描述有更新（首次、格式变化或新增表外字段），需发布
+     */
+    bool takeSchema(String &out);
+
+private:
+    /** @brief 表外字段，按名称排序存放，查找时不分配内存 */
+    struct DynamicField {
+        char name[PAYLOAD_PATH_MAX];
+        uint16_t id;
+    };
+
+    PayloadFormat _format;
+    std::vector<DynamicField> _dynamic; ///< 表外字段ID
+    PayloadFieldIndex _fields;          ///< 固定字段ID查找
+    uint16_t _nextId;
+    bool _dirty;
+    SemaphoreHandle_t _mutex;
+
+    uint16_t _fieldId(const char *path);
+    size_t _countLeaves(JsonObjectConst obj);
+    void _writeObject(PayloadWriter &w, JsonObjectConst obj, char *path, size_t len);
+    static void _writeValue(PayloadWriter &w, JsonVariantConst v);
+};
@@ -0,0 +1,97 @@
+/**
+ * @file    PayloadFields.cpp
+ * @brief   负载字段ID表实现
+ */
+#include "PayloadFields.h"
+#include <algorithm>
+#include <string.h>
+
+/**
+ * @brief I2C传感器字段表，下标即字段ID（0保留）
+ * @note 只允许在末尾追加，已发布的ID不可修改
+ */
+const char *const kPayloadFieldNames[] = {
+    "",
+    // GestureFaceDetection / GR10_30
+    "FaceX", "FaceY", "GestureType", "Gesture",
+    // BME280
+    "Temperature", "Pressure", "Altitude", "Humidity",
+    // URM09 / TCS34725 / VEML7700
+    "UltrasonicSensor", "R", "G", "B", "Lux",
+    // LIS2DH12 / C4001 / UV
+    "x", "y", "z", "motion", "UV",
+    // BMX160
+    "mag.x", "mag.y", "mag.z", "gyr.x", "gyr.y", "gyr.z", "acc.x", "acc.y", "acc.z",
+    // ENS160 / MAX30102 / SCD4X
+    "ens160_TVOC", "ens160_ECO2", "ens160_AQI", "max30102_SPO2", "max30102_HeartRate", "scd4x_CO2ppm",
+    // BMI160
+    "bmi160_gyr_x", "bmi160_gyr_y", "bmi160_gyr_z", "bmi160_acc_x", "bmi160_acc_y", "bmi160_acc_z",
+    // 批量上报：首个样本时间、样本时间差
+    "t0", "dt",
+    // 采样时间戳（UTC毫秒）
+    "ts",
+};
+const size_t kPayloadFieldCount = sizeof(kPayloadFieldNames) / sizeof(kPayloadFieldNames[0]);
+
+/**
+ * @brief IO口字段表，字段名为 "p<端口号>_<名称>"
+ * @note 已用满PAYLOAD_IO_FIELD_STRIDE，新字段追加到kIOExtFieldNames
+ */
+static const char *const kIOFieldNames[] = {
+    "input_val", "dht11_humi", "dht11_temp", "ds18b20_temp", "emg_env", "emg_rms", "hr_bpm", "hr_quality",
+};
+
+/**
+ * @brief IO口扩展字段表，ID在IO口字段之后另起一段，原有ID不变
+ * @note 只允许在末尾追加，长度不能超过PAYLOAD_IO_EXT_FIELD_STRIDE
+ */
+static const char *const kIOExtFieldNames[] = {
+    "dht22_humi", "dht22_temp",
+};
+
+const PayloadIOFieldBlock kPayloadIOFieldBlocks[] = {
+    {PAYLOAD_IO_FIELD_BASE, PAYLOAD_IO_FIELD_STRIDE, kIOFieldNames, sizeof(kIOFieldNames) / sizeof(kIOFieldNames[0])},
+    {PAYLOAD_IO_EXT_FIELD_BASE, PAYLOAD_IO_EXT_FIELD_STRIDE, kIOExtFieldNames,
+     sizeof(kIOExtFieldNames) / sizeof(kIOExtFieldNames[0])},
+};
+const size_t kPayloadIOFieldBlockCount = sizeof(kPayloadIOFieldBlocks) / sizeof(kPayloadIOFieldBlocks[0]);
+
+static_assert(sizeof(kPayloadFieldNames) / sizeof(kPayloadFieldNames[0]) <= PAYLOAD_IO_FIELD_BASE,
+              "kPayloadFieldNames overlaps the IO field range");
+static_assert(sizeof(kIOFieldNames) / sizeof(kIOFieldNames[0]) <= PAYLOAD_IO_FIELD_STRIDE,
+              "kIOFieldNames exceeds PAYLOAD_IO_FIELD_STRIDE");
+static_assert(sizeof(kIOExtFieldNames) / sizeof(kIOExtFieldNames[0]) <= PAYLOAD_IO_EXT_FIELD_STRIDE,
+              "kIOExtFieldNames exceeds PAYLOAD_IO_EXT_FIELD_STRIDE");
+static_assert(PAYLOAD_IO_FIELD_BASE + PAYLOAD_IO_PORT_NUM * PAYLOAD_IO_FIELD_STRIDE <= PAYLOAD_IO_EXT_FIELD_BASE,
+              "IO field ids overlap the IO extension range");
+static_assert(PAYLOAD_IO_EXT_FIELD_BASE + PAYLOAD_IO_PORT_NUM * PAYLOAD_IO_EXT_FIELD_STRIDE <=
+                  PAYLOAD_DYNAMIC_FIELD_BASE,
+              "IO extension field ids overlap the dynamic field range");
+
+PayloadFieldIndex::PayloadFieldIndex() {
+  for (size_t i = 1; i < kPayloadFieldCount; i++) {
+    _order.push_back((uint8_t)i);
+  }
+  std::sort(_order.begin(), _order.end(),
+            [](uint8_t a, uint8_t b) { return strcmp(kPayloadFieldNames[a], kPayloadFieldNames[b]) < 0; });
+}
+
+uint16_t PayloadFieldIndex::find(const char *path) const {
+  // IO口字段 "p<端口号>_<名称>"
+  if (path[0] == 'p' && path[1] >= '1' && path[1] < '1' + PAYLOAD_IO_PORT_NUM && path[2] == '_') {
+    for (size_t b = 0; b < kPayloadIOFieldBlockCount; b++) {
+      const PayloadIOFieldBlock &block = kPayloadIOFieldBlocks[b];
+      for (uint8_t i = 0; i < block.count; i++) {
+        if (strcmp(path + 3, block.names[i]) == 0) {
+          return block.base + (path[1] - '1') * block.stride + i;
+        }
+      }
+    }
+  }
+  auto fixed = std::lower_bound(_order.begin(), _order.end(), path,
+                                [](uint8_t i, const char *key) { return strcmp(kPayloadFieldNames[i], key) < 0; });
+  if (fixed != _order.end() && strcmp(kPayloadFieldNames[*fixed], path) == 0) {
+    return *fixed;
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    PayloadFields.h
+ * @brief   负载字段ID表头文件
+ *
+ * @details 二进制负载中字段名到固定字段ID的对应关系，ID分段见PayloadCodec.h。
+ *          不依赖Arduino，主机端基准测试直接使用同一份字段表。
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define PAYLOAD_IO_PORT_NUM 6       ///< IO口数量，与IO_PORT_NUM一致
+#define PAYLOAD_IO_FIELD_BASE 128   ///< IO口字段ID起点
+#define PAYLOAD_IO_FIELD_STRIDE 8   ///< 每个IO口预留的字段ID数
+#define PAYLOAD_IO_EXT_FIELD_BASE 176 ///< IO口扩展字段ID起点
+#define PAYLOAD_IO_EXT_FIELD_STRIDE 2 ///< 每个IO口预留的扩展字段ID数
+#define PAYLOAD_DYNAMIC_FIELD_BASE 256 ///< 表外字段ID起点
+
+/** @brief IO口字段ID段：ID = base + (端口号-1)*stride + 字段序号 */
+struct PayloadIOFieldBlock {
+    uint16_t base;
+    uint8_t stride;
+    const char *const *names;
+    uint8_t count;
+};
+
+extern const char *const kPayloadFieldNames[];       ///< I2C传感器字段表，下标即字段ID（0保留）
+extern const size_t kPayloadFieldCount;              ///< kPayloadFieldNames长度（含0号）
+extern const PayloadIOFieldBlock kPayloadIOFieldBlocks[]; ///< IO口字段ID段
+extern const size_t kPayloadIOFieldBlockCount;       ///< kPayloadIOFieldBlocks长度
+
+/**
+ * @brief 固定字段ID查找
+ *
+ * @details 构造时把I2C字段表按名称排序，查找时二分，不分配内存
+ */
+class PayloadFieldIndex {
+public:
+    PayloadFieldIndex();
+
+    /**
+     * @brief 查找固定字段ID
+     * @param path 字段路径，如 "Temperature"、"acc.x"、"p1_input_val"
+     * @return uint16_t 字段ID，不在固定表中时返回0
+     */
+    uint16_t find(const char *path) const;
+
+private:
+    std::vector<uint8_t> _order; ///< 固定字段表按名称排序的下标
+};
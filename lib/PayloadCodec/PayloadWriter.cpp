@@ -0,0 +1,148 @@
+/**
+ * @file    PayloadWriter.cpp
+ * @brief   MessagePack/CBOR编码器实现
+ *
+ * @details 整数按取值选择最短编码，浮点数统一为4字节单精度，多字节数值为大端序。
+ */
+#include "PayloadWriter.h"
+
+void PayloadWriter::_put(uint8_t b) {
+  if (_len < _cap) {
+    _buf[_len++] = b;
+  } else {
+    _overflow = true;
+  }
+}
+
+void PayloadWriter::_putBE(uint32_t v, uint8_t bytes) {
+  while (bytes-- > 0) {
+    _put((uint8_t)(v >> (bytes * 8)));
+  }
+}
+
+/**
+ * @brief 写入CBOR数据项头
+ *
+ * @param major 主类型（0无符号整数、1负整数、3字符串、4数组、5映射）
+ * @param v 参数值（整数值、长度或元素个数）
+ */
+void PayloadWriter::_head(uint8_t major, uint32_t v) {
+  major <<= 5;
+  if (v < 24) {
+    _put(major | v);
+  } else if (v <= 0xff) {
+    _put(major | 24);
+    _put((uint8_t)v);
+  } else if (v <= 0xffff) {
+    _put(major | 25);
+    _putBE(v, 2);
+  } else {
+    _put(major | 26);
+    _putBE(v, 4);
+  }
+}
+
+void PayloadWriter::map(size_t n) {
+  if (_cbor) {
+    _head(5, (uint32_t)n);
+  } else if (n < 16) {
+    _put(0x80 | n);
+  } else {
+    _put(0xde);
+    _putBE((uint32_t)n, 2);
+  }
+}
+
+void PayloadWriter::array(size_t n) {
+  if (_cbor) {
+    _head(4, (uint32_t)n);
+  } else if (n < 16) {
+    _put(0x90 | n);
+  } else {
+    _put(0xdc);
+    _putBE((uint32_t)n, 2);
+  }
+}
+
+void PayloadWriter::uint(uint32_t v) {
+  if (_cbor) {
+    _head(0, v);
+  } else if (v < 0x80) {
+    _put((uint8_t)v);
+  } else if (v <= 0xff) {
+    _put(0xcc);
+    _put((uint8_t)v);
+  } else if (v <= 0xffff) {
+    _put(0xcd);
+    _putBE(v, 2);
+  } else {
+    _put(0xce);
+    _putBE(v, 4);
+  }
+}
+
+void PayloadWriter::uint64(uint64_t v) {
+  if (v <= 0xffffffffULL) {
+    uint((uint32_t)v);
+    return;
+  }
+  _put(_cbor ? 0x1b : 0xcf);
+  _putBE((uint32_t)(v >> 32), 4);
+  _putBE((uint32_t)v, 4);
+}
+
+void PayloadWriter::sint(int32_t v) {
+  if (v >= 0) {
+    uint((uint32_t)v);
+  } else if (_cbor) {
+    _head(1, (uint32_t)(-1 - v));
+  } else if (v >= -32) {
+    _put((uint8_t)v);
+  } else if (v >= -128) {
+    _put(0xd0);
+    _put((uint8_t)v);
+  } else if (v >= -32768) {
+    _put(0xd1);
+    _putBE((uint16_t)v, 2);
+  } else {
+    _put(0xd2);
+    _putBE((uint32_t)v, 4);
+  }
+}
+
+void PayloadWriter::real(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  _put(_cbor ? 0xfa : 0xca);
+  _putBE(bits, 4);
+}
+
+void PayloadWriter::str(const char *s, size_t len) {
+  if (_cbor) {
+    _head(3, (uint32_t)len);
+  } else if (len < 32) {
+    _put(0xa0 | len);
+  } else if (len <= 0xff) {
+    _put(0xd9);
+    _put((uint8_t)len);
+  } else {
+    _put(0xda);
+    _putBE((uint32_t)len, 2);
+  }
+  if (_len + len <= _cap) {
+    memcpy(_buf + _len, s, len);
+    _len += len;
+  } else {
+    _overflow = true;
+  }
+}
+
+void PayloadWriter::boolean(bool b) {
+  if (_cbor) {
+    _put(b ? 0xf5 : 0xf4);
+  } else {
+    _put(b ? 0xc3 : 0xc2);
+  }
+}
+
+void PayloadWriter::nil() { _put(_cbor ? 0xf6 : 0xc0); }
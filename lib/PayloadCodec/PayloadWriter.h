@@ -0,0 +1,67 @@
+/**
+ * @file    PayloadWriter.h
+ * @brief   MessagePack/CBOR编码器头文件
+ *
+ * @details 直接写入调用者提供的输出缓冲区，不分配内存、不使用String，
+ *          空间不足时停止写入并置溢出标志。
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief 负载编码格式
+ */
+typedef enum {
+    PAYLOAD_JSON,    ///< JSON文本（默认，兼容原有格式）
+    PAYLOAD_MSGPACK, ///< MessagePack
+    PAYLOAD_CBOR     ///< CBOR（RFC 8949）
+} PayloadFormat;
+
+class PayloadWriter {
+public:
+    /**
+     * @brief 构造编码器
+     * @param buf 输出缓冲区
+     * @param cap 缓冲区容量
+     * @param format 编码格式，仅支持PAYLOAD_MSGPACK和PAYLOAD_CBOR
+     */
+    PayloadWriter(uint8_t *buf, size_t cap, PayloadFormat format)
+        : _buf(buf), _cap(cap), _len(0), _overflow(false), _cbor(format == PAYLOAD_CBOR) {}
+
+    /** @brief 写入映射头，后跟n组键值 */
+    void map(size_t n);
+    /** @brief 写入数组头，后跟n个元素 */
+    void array(size_t n);
+    /** @brief 写入无符号整数 */
+    void uint(uint32_t v);
+    /** @brief 写入64位无符号整数（用于毫秒时间戳） */
+    void uint64(uint64_t v);
+    /** @brief 写入有符号整数 */
+    void sint(int32_t v);
+    /** @brief 写入单精度浮点数 */
+    void real(float v);
+    /** @brief 写入UTF-8字符串 */
+    void str(const char *s, size_t len);
+    /** @brief 写入布尔值 */
+    void boolean(bool b);
+    /** @brief 写入空值 */
+    void nil();
+
+    /** @brief 已写入字节数 */
+    size_t size() const { return _len; }
+    /** @brief 缓冲区是否不足 */
+    bool overflow() const { return _overflow; }
+
+private:
+    uint8_t *_buf;
+    size_t _cap;
+    size_t _len;
+    bool _overflow;
+    bool _cbor;
+
+    void _put(uint8_t b);
+    void _putBE(uint32_t v, uint8_t bytes);
+    void _head(uint8_t major, uint32_t v);
+};
@@ -0,0 +1,78 @@
+/**
+ * @file    PublishPacer.cpp
+ * @brief   自适应发布节奏模块实现
+ */
+#include "PublishPacer.h"
+#include "mqtt_server.h"
+#include "mqtt_publisher.h"
+
+PublishPacer::PublishPacer()
+    : skipped(0), stretched(0), _enabled(true), _limit(PACER_BACKLOG_LIMIT_DEFAULT), _stretch(1),
+      _intervalMs(0), _backlog(0) {}
+
+/**
+ * @brief 从配置键值对读取自适应参数
+ */
+void PublishPacer::config(KeyValue *kv_pairs, int count) {
+  const char *mode = get_value_case_insensitive(kv_pairs, count, "Adaptive_Rate");
+  _enabled = (mode == NULL || strcasecmp(mode, "off") != 0);
+
+  _limit = PACER_BACKLOG_LIMIT_DEFAULT;
+  const char *limit = get_value_case_insensitive(kv_pairs, count, "Backlog_Limit");
+  if (limit != NULL && atoi(limit) > 0) {
+    _limit = atoi(limit);
+  }
+  _stretch = 1;
+  printf("[Info]Adaptive_Rate: %s, backlog limit %u bytes\n", _enabled ? "on" : "off", (unsigned)_limit);
+}
+
+bool PublishPacer::wanted(const char *topic) {
+  if (!_enabled || mqtt_server_has_subscriber(topic)) {
+    return true;
+  }
+  skipped++;
+  return false;
+}
+
+/**
+ * @brief 计算下一次发布前的等待时间
+ *
+ * @details 积压超过阈值或队列过半时放大倍数加倍，积压低于阈值1/4且队列为空时减半，
+ *          两者之间保持不变，避免在阈值附近来回切换。
+ */
+uint32_t PublishPacer::next(uint32_t baseMs, uint32_t backlog, uint32_t queued) {
+  _backlog = backlog;
+  uint8_t last = _stretch;
+  if (!_enabled) {
+    _stretch = 1;
+  } else if (backlog > _limit || queued >= PACER_QUEUE_HIGH) {
+    if (_stretch < PACER_MAX_STRETCH) {
+      _stretch *= 2;
+    }
+  } else if (backlog < _limit / 4 && queued == 0 && _stretch > 1) {
+    _stretch /= 2;
+  }
+  if (_stretch != last) {
+    printf("[Info]Publish interval x%u (backlog %u bytes, %u queued)\n", _stretch, (unsigned)backlog,
+           (unsigned)queued);
+  }
+  if (_stretch > 1) {
+    stretched++;
+  }
+
+  _intervalMs = baseMs * _stretch;
+  // 放大后不超过上限，但不缩短配置本身就更长的间隔
+  if (_stretch > 1 && _intervalMs > PACER_MAX_INTERVAL_MS) {
+    _intervalMs = baseMs > PACER_MAX_INTERVAL_MS ? baseMs : PACER_MAX_INTERVAL_MS;
+  }
+  return _intervalMs;
+}
+
+void PublishPacer::stats(String &out) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "{\"stretch\":%u,\"interval_ms\":%u,\"backlog\":%u,\"skipped\":%u,\"stretched\":%u,\"dropped\":%u}",
+           _stretch, (unsigned)_intervalMs, (unsigned)_backlog, (unsigned)skipped, (unsigned)stretched,
+           (unsigned)mqtt_pub_pool_dropped());
+  out = buf;
+}
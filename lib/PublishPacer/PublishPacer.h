@@ -0,0 +1,68 @@
+/**
+ * @file    PublishPacer.h
+ * @brief   自适应发布节奏模块头文件
+ *
+ * @details 根据Broker的订阅情况和发送积压调整mqttPublishTask的发布：
+ *          - 没有订阅匹配的主题本周期不编码、不入队
+ *          - 客户端发送缓冲区或发布队列积压时发布间隔逐次加倍（最多PACER_MAX_STRETCH倍），
+ *            积压消除后逐次减半，回到配置的上报间隔
+ *          配置项（config.txt）：
+ *          - Adaptive_Rate: on | off，默认on
+ *          - Backlog_Limit: 触发拉长间隔的发送缓冲区字节数，默认8192，低于其1/4时恢复
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+
+#define PACER_BACKLOG_LIMIT_DEFAULT 8192 ///< 默认积压阈值（字节）
+#define PACER_MAX_STRETCH 8              ///< 发布间隔最大放大倍数
+#define PACER_MAX_INTERVAL_MS 10000      ///< 放大后的发布间隔上限（毫秒）
+#define PACER_QUEUE_HIGH 4               ///< 发布队列中待发送消息数达到该值视为积压
+
+class PublishPacer {
+public:
+    PublishPacer();
+
+    /**
+     * @brief 从配置键值对读取自适应参数
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /**
+     * @brief 主题是否有订阅者
+     * @param topic 发布主题，以"/#"结尾时表示该前缀及其下任意主题
+     * @return true 需要发布；未启用自适应时总是true
+     */
+    bool wanted(const char *topic);
+
+    /**
+     * @brief 根据积压情况计算本周期结束后的等待时间
+     * @param baseMs 配置的上报间隔
+     * @param backlog Broker客户端发送缓冲区最大积压（字节）
+     * @param queued 发布队列中待发送的消息数
+     * @return uint32_t 实际等待时间（毫秒）
+     */
+    uint32_t next(uint32_t baseMs, uint32_t backlog, uint32_t queued);
+
+    /** @brief 当前间隔放大倍数 */
+    uint8_t stretch() const { return _stretch; }
+
+    /**
+     * @brief 输出统计信息
+     * @param out 输出：{"stretch":..,"interval_ms":..,"backlog":..,"skipped":..,"stretched":..,"dropped":..}
+     *            dropped为发布帧池满时被挤掉的消息数
+     */
+    void stats(String &out);
+
+    uint32_t skipped;   ///< 因无订阅者跳过的发布次数
+    uint32_t stretched; ///< 以放大间隔运行的周期数
+
+private:
+    bool _enabled;
+    uint32_t _limit;
+    uint8_t _stretch;
+    uint32_t _intervalMs;
+    uint32_t _backlog;
+};
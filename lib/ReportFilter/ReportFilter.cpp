@@ -0,0 +1,244 @@
+/**
+ * @file    ReportFilter.cpp
+ * @brief   变化上报（死区过滤）模块实现
+ */
+#include "ReportFilter.h"
+
+ReportFilter::ReportFilter()
+    : framesIn(0), framesOut(0), fieldsIn(0), fieldsOut(0), _enabled(false), _frame(0) {
+  _default = {0.0f, 0.0f, REPORT_HEARTBEAT_DEFAULT_MS};
+  _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief 解析死区规则字符串
+ *
+ * @param value 规则字符串，如 "0.5, 2%, 30s"
+ * @param rule 输出规则（未出现的项保持原值）
+ * @return bool 全部项解析成功返回true
+ */
+bool ReportFilter::_parseRule(const char *value, DeadbandRule &rule) {
+  char buffer[MAX_VALUE_LEN];
+  strncpy(buffer, value, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+
+  bool ok = true;
+  for (char *tok = strtok(buffer, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    tok = trim(tok);
+    size_t len = strlen(tok);
+    if (len == 0) {
+      continue;
+    }
+    char *end = NULL;
+    float val = strtof(tok, &end);
+    if (end == tok || val < 0) {
+      ok = false;
+      continue;
+    }
+    if (strcasecmp(end, "%") == 0) {
+      rule.relBand = val / 100.0f;
+    } else if (strcasecmp(end, "ms") == 0) {
+      rule.heartbeatMs = (uint32_t)val;
+    } else if (strcasecmp(end, "s") == 0) {
+      rule.heartbeatMs = (uint32_t)(val * 1000.0f);
+    } else if (*end == '\0') {
+      rule.absBand = val;
+    } else {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+/**
+ * @brief 从配置键值对读取上报模式及死区规则
+ */
+void ReportFilter::config(KeyValue *kv_pairs, int count) {
+  const char prefix[] = "Deadband_";
+  const size_t prefixLen = sizeof(prefix) - 1;
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _rules.clear();
+  _fields.clear();
+  _default = {0.0f, 0.0f, REPORT_HEARTBEAT_DEFAULT_MS};
+
+  const char *mode = get_value_case_insensitive(kv_pairs, count, "Report_Mode");
+  _enabled = (mode != NULL && strcasecmp(mode, "change") == 0);
+
+  const char *def = get_value_case_insensitive(kv_pairs, count, "Deadband_Default");
+  if (def != NULL && !_parseRule(def, _default)) {
+    printf("[Info]Deadband_Default invalid: %s\n", def);
+  }
+
+  for (int i = 0; i < count; i++) {
+    const char *key = kv_pairs[i].key;
+    if (strncasecmp(key, prefix, prefixLen) != 0 || strcasecmp(key, "Deadband_Default") == 0) {
+      continue;
+    }
+    // 单字段规则以默认规则为基础，未指定的项沿用默认值
+    DeadbandRule rule = _default;
+    if (!_parseRule(kv_pairs[i].value, rule)) {
+      printf("[Info]%s invalid: %s\n", key, kv_pairs[i].value);
+      continue;
+    }
+    String field = String(key + prefixLen);
+    field.toLowerCase();
+    _rules[field] = rule;
+  }
+  xSemaphoreGive(_mutex);
+  printf("[Info]Report_Mode: %s, %u deadband rules\n", _enabled ? "change" : "all", (unsigned)_rules.size());
+}
+
+/**
+ * @brief 查找字段规则
+ *
+ * @param path 字段完整路径，如 "acc.x"
+ * @param key 字段名，如 "x"
+ * @return DeadbandRule 先按完整路径匹配，再按字段名匹配，均未配置时返回默认规则
+ */
+DeadbandRule ReportFilter::_ruleFor(const String &path, const char *key) {
+  String name = path;
+  name.toLowerCase();
+  auto it = _rules.find(name);
+  if (it == _rules.end() && path != key) {
+    name = key;
+    name.toLowerCase();
+    it = _rules.find(name);
+  }
+  return it != _rules.end() ? it->second : _default;
+}
+
+/**
+ * @brief 判断字段是否需要上报，需要时更新上报状态
+ *
+ * @details 数值字段：变化量达到 max(绝对死区, 相对死区×|上次值|) 时上报，
+ *          两者均为0时任何变化都上报；其他字段内容变化即上报；
+ *          超过心跳周期未上报的字段强制上报。
+ */
+bool ReportFilter::_changed(FieldState &st, JsonVariantConst v, uint32_t nowMs) {
+  bool changed;
+  if (v.is<double>()) {
+    double x = v.as<double>();
+    if (!st.isNum) {
+      changed = true;
+    } else {
+      double band = st.rule.absBand;
+      double rel = st.rule.relBand * fabs(st.num);
+      if (rel > band) {
+        band = rel;
+      }
+      changed = band > 0 ? fabs(x - st.num) >= band : x != st.num;
+    }
+    if (changed || (st.rule.heartbeatMs > 0 && nowMs - st.sentAt >= st.rule.heartbeatMs)) {
+      st.num = x;
+      st.isNum = true;
+      st.sentAt = nowMs;
+      return true;
+    }
+    return false;
+  }
+
+  String text;
+  serializeJson(v, text);
+  changed = st.isNum || text != st.text;
+  if (changed || (st.rule.heartbeatMs > 0 && nowMs - st.sentAt >= st.rule.heartbeatMs)) {
+    st.text = text;
+    st.isNum = false;
+    st.sentAt = nowMs;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief 递归遍历JSON对象，把需要上报的字段按原层级复制到输出
+ */
+void ReportFilter::_walk(JsonObjectConst in, JsonObject out, const String &prefix, uint32_t nowMs) {
+  for (JsonPairConst kv : in) {
+    const char *key = kv.key().c_str();
+    String path = prefix.length() > 0 ? prefix + "." + key : String(key);
+    JsonVariantConst v = kv.value();
+
+    if (v.is<JsonObjectConst>()) {
+      JsonObject child = out[key].to<JsonObject>();
+      _walk(v.as<JsonObjectConst>(), child, path, nowMs);
+      if (child.size() == 0) {
+        out.remove(key);
+      }
+      continue;
+    }
+
+    fieldsIn++;
+    auto it = _fields.find(path);
+    if (it == _fields.end()) {
+      // 新出现的字段（含重新插入的设备）立即上报
+      FieldState st;
+      st.num = 0;
+      st.isNum = false;
+      st.sentAt = nowMs;
+      st.rule = _ruleFor(path, key);
+      if (v.is<double>()) {
+        st.num = v.as<double>();
+        st.isNum = true;
+      } else {
+        serializeJson(v, st.text);
+      }
+      it = _fields.emplace(path, st).first;
+      it->second.seen = _frame;
+      out[key] = v;
+      fieldsOut++;
+      continue;
+    }
+
+    it->second.seen = _frame;
+    if (_changed(it->second, v, nowMs)) {
+      out[key] = v;
+      fieldsOut++;
+    }
+  }
+}
+
+/**
+ * @brief 过滤一帧传感器数据
+ */
+bool ReportFilter::filter(const String &frame, String &out, uint32_t nowMs) {
+  JsonDocument in;
+  if (deserializeJson(in, frame) || !in.is<JsonObject>()) {
+    out = frame;
+    return out.length() > 0;
+  }
+
+  JsonDocument res;
+  JsonObject root = res.to<JsonObject>();
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _frame++;
+  framesIn++;
+  _walk(in.as<JsonObjectConst>(), root, String(), nowMs);
+  // 清理本帧未出现的字段，设备重新接入后其字段会立即上报
+  for (auto it = _fields.begin(); it != _fields.end();) {
+    if (it->second.seen != _frame) {
+      it = _fields.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  xSemaphoreGive(_mutex);
+
+  if (root.size() == 0) {
+    return false;
+  }
+  framesOut++;
+  out = "";
+  serializeJson(res, out);
+  return true;
+}
+
+void ReportFilter::stats(String &out) {
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "{\"enabled\":%s,\"frames_in\":%u,\"frames_out\":%u,\"fields_in\":%u,\"fields_out\":%u}",
+           _enabled ? "true" : "false", (unsigned)framesIn, (unsigned)framesOut, (unsigned)fieldsIn,
+           (unsigned)fieldsOut);
+  out = buf;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file    ReportFilter.h
+ * @brief   变化上报（死区过滤）模块头文件
+ *
+ * @details 按字段比较传感器数据与上次上报值，只输出超出死区的字段，
+ *          并以最长静默时间（心跳）强制重发未变化的字段。
+ *          配置项（config.txt）：
+ *          - Report_Mode: all | change，默认all（整帧上报）
+ *          - Deadband_Default: 默认规则，如 "0, 10s"
+ *          - Deadband_<字段名>: 单字段规则，如 "Deadband_Temperature: 0.2, 60s"、
+ *            "Deadband_Humidity: 2%"，嵌套字段用"."连接，如 "Deadband_acc.x: 0.05"
+ *          规则由逗号分隔：纯数字为绝对死区，"%"结尾为相对死区，"s"/"ms"结尾为心跳周期。
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "ArduinoJson.h"
+
+#define REPORT_HEARTBEAT_DEFAULT_MS 10000 ///< 默认最长静默时间（毫秒）
+
+/**
+ * @brief 单字段死区规则
+ */
+typedef struct {
+    float absBand;        ///< 绝对死区，变化量达到该值才上报
+    float relBand;        ///< 相对死区（比例，0.02即2%），以上次上报值为基准
+    uint32_t heartbeatMs; ///< 最长静默时间，0表示不强制重发
+} DeadbandRule;
+
+class ReportFilter {
+public:
+    ReportFilter();
+
+    /**
+     * @brief 从配置键值对读取上报模式及死区规则
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     * @details 重新配置后清空字段状态，下一帧全部字段重新上报一次
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /**
+     * @brief 是否启用变化上报
+     * @return true 仅上报变化字段；false 整帧上报
+     */
+    bool enabled() const { return _enabled; }
+
+    /**
+     * @brief 过滤一帧传感器数据
+     * @param frame 完整JSON帧
+     * @param out 输出：仅包含需要上报字段的JSON
+     * @param nowMs 当前时间（毫秒）
+     * @return true 有字段需要上报；false 本帧无需上报
+     * @note JSON解析失败时原样输出整帧
+     */
+    bool filter(const String &frame, String &out, uint32_t nowMs);
+
+    /**
+     * @brief 输出统计信息
+     * @param out 输出：{"enabled":..,"frames_in":..,"frames_out":..,"fields_in":..,"fields_out":..}
+     *            fields_out/fields_in 即变化上报节省的比例
+     */
+    void stats(String &out);
+
+    uint32_t framesIn;      ///< 输入帧数
+    uint32_t framesOut;     ///< 实际上报帧数
+    uint32_t fieldsIn;      ///< 输入字段数
+    uint32_t fieldsOut;     ///< 实际上报字段数
+
+private:
+    /** @brief 字段上次上报状态 */
+    struct FieldState {
+        double num;         ///< 数值字段上次上报值
+        String text;        ///< 非数值字段上次上报内容
+        bool isNum;
+        uint32_t sentAt;    ///< 上次上报时间
+        uint32_t seen;      ///< 最近出现的帧序号，用于清理已拔出设备的字段
+        DeadbandRule rule;
+    };
+
+    std::map<String, FieldState> _fields;
+    std::map<String, DeadbandRule> _rules; ///< 键为小写字段名
+    DeadbandRule _default;
+    bool _enabled;
+    uint32_t _frame;
+    SemaphoreHandle_t _mutex;
+
+    void _walk(JsonObjectConst in, JsonObject out, const String &prefix, uint32_t nowMs);
+    bool _changed(FieldState &st, JsonVariantConst v, uint32_t nowMs);
+    DeadbandRule _ruleFor(const String &path, const char *key);
+    static bool _parseRule(const char *value, DeadbandRule &rule);
+};
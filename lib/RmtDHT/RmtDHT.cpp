@@ -0,0 +1,201 @@
+/**
+ * @file    RmtDHT.cpp
+ * @brief   RMT接收DHT11/DHT22温湿度传感器模块实现
+ */
+#include "RmtDHT.h"
+
+RmtDHT rmtDHT;
+
+RmtDHT::RmtDHT() : reads(0), errors(0), _count(0), _running(false), _task(NULL), _lock(NULL) {
+  _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void RmtDHT::reset() {
+  if (_lock == NULL) {
+    _lock = xSemaphoreCreateMutex();
+  }
+  // 读取任务在持锁期间最多阻塞一次握手加DHT_RX_TIMEOUT_MS
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  if (_running) {
+    for (int i = 0; i < _count; i++) {
+      rmt_driver_uninstall(_sensors[i].channel);
+    }
+    _running = false;
+  }
+  _count = 0;
+  xSemaphoreGive(_lock);
+}
+
+int RmtDHT::add(uint8_t pin, RmtDHTType type) {
+  if (_count >= RMT_DHT_MAX || _running) {
+    return -1;
+  }
+  Sensor &s = _sensors[_count];
+  memset(&s, 0, sizeof(s));
+  s.pin = pin;
+  s.type = type;
+  s.channel = (rmt_channel_t)(RMT_DHT_FIRST_CHANNEL + _count);
+  s.temperature = NAN;
+  s.humidity = NAN;
+  return _count++;
+}
+
+/**
+ * @brief 配置RMT接收通道
+ *
+ * @details rmt_config()把引脚设为输入并接入RMT，之后改为开漏输入输出，
+ *          同一引脚既由GPIO拉低触发，又由RMT记录应答。
+ */
+void RmtDHT::begin() {
+  if (_count == 0 || _running) {
+    return;
+  }
+  for (int i = 0; i < _count; i++) {
+    Sensor &s = _sensors[i];
+    rmt_config_t cfg = RMT_DEFAULT_CONFIG_RX((gpio_num_t)s.pin, s.channel);
+    cfg.clk_div = 80; // 1µs分辨率
+    cfg.mem_block_num = 1;
+    cfg.rx_config.filter_en = true;
+    cfg.rx_config.filter_ticks_thresh = 100; // 滤除约1µs以下的毛刺（APB时钟周期）
+    cfg.rx_config.idle_threshold = DHT_IDLE_US;
+    if (rmt_config(&cfg) != ESP_OK || rmt_driver_install(s.channel, 512, 0) != ESP_OK) {
+      printf("[Error]DHT: RMT channel %d on GPIO%u failed\n", (int)s.channel, s.pin);
+      s.rb = NULL;
+      continue;
+    }
+    rmt_get_ringbuf_handle(s.channel, &s.rb);
+    gpio_set_level((gpio_num_t)s.pin, 1);
+    gpio_set_direction((gpio_num_t)s.pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode((gpio_num_t)s.pin, GPIO_PULLUP_ONLY);
+  }
+  _running = true;
+
+  if (_task == NULL) {
+    xTaskCreate(_reader, "dht", 3072, this, 2, &_task);
+  } else {
+    xTaskNotifyGive(_task);
+  }
+}
+
+/**
+ * @brief 解码一帧应答
+ *
+ * @details 帧为：应答低80µs、高80µs，然后40位每位低约50µs加高电平（宽度区分0/1），
+ *          最后低约50µs后释放。结束时的空闲高电平时长记为0，不计入；
+ *          开头的应答可能因接收启动稍晚而不完整，因此只取最后40个高电平。
+ */
+bool RmtDHT::_decode(const rmt_item32_t *items, size_t count, uint8_t data[5]) {
+  uint16_t highs[40];
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint16_t width = 0;
+    if (items[i].level0 == 1 && items[i].duration0 > 0) {
+      width = items[i].duration0;
+    } else if (items[i].level1 == 1 && items[i].duration1 > 0) {
+      width = items[i].duration1;
+    } else {
+      continue;
+    }
+    highs[n % 40] = width;
+    n++;
+  }
+  if (n < 40) {
+    return false;
+  }
+  memset(data, 0, 5);
+  for (int bit = 0; bit < 40; bit++) {
+    if (highs[(n + bit) % 40] > DHT_BIT_ONE_US) {
+      data[bit / 8] |= 0x80 >> (bit % 8);
+    }
+  }
+  return (uint8_t)(data[0] + data[1] + data[2] + data[3]) == data[4];
+}
+
+/**
+ * @brief 读取一个传感器，在读取任务中执行
+ */
+void RmtDHT::_read(Sensor &s) {
+  if (s.rb == NULL) {
+    return;
+  }
+  // 清掉上次超时后迟到的数据
+  size_t len = 0;
+  void *stale;
+  while ((stale = xRingbufferReceive(s.rb, &len, 0)) != NULL) {
+    vRingbufferReturnItem(s.rb, stale);
+  }
+
+  gpio_set_level((gpio_num_t)s.pin, 0);
+  vTaskDelay(pdMS_TO_TICKS(s.type == RMT_DHT22 ? 2 : 20));
+  gpio_set_level((gpio_num_t)s.pin, 1);
+  rmt_rx_start(s.channel, true);
+  rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(s.rb, &len, pdMS_TO_TICKS(DHT_RX_TIMEOUT_MS));
+  rmt_rx_stop(s.channel);
+
+  uint8_t data[5];
+  bool ok = false;
+  if (items != NULL) {
+    ok = _decode(items, len / sizeof(rmt_item32_t), data);
+    vRingbufferReturnItem(s.rb, items);
+  }
+  if (!ok) {
+    errors++;
+    return;
+  }
+
+  float humidity, temperature;
+  if (s.type == RMT_DHT22) {
+    humidity = ((data[0] << 8) | data[1]) * 0.1f;
+    temperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+    if (data[2] & 0x80) {
+      temperature = -temperature;
+    }
+  } else {
+    humidity = data[0] + data[1] * 0.1f;
+    temperature = data[2] + (data[3] & 0x7F) * 0.1f;
+    if (data[3] & 0x80) {
+      temperature = -temperature;
+    }
+  }
+  if (humidity > 100.0f) {
+    errors++;
+    return;
+  }
+  portENTER_CRITICAL(&_mux);
+  s.humidity = humidity;
+  s.temperature = temperature;
+  s.okMs = millis() | 1; // 0保留为从未成功
+  portEXIT_CRITICAL(&_mux);
+  reads++;
+}
+
+void RmtDHT::_reader(void *arg) {
+  RmtDHT *self = (RmtDHT *)arg;
+  while (1) {
+    if (!self->_running) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    for (int i = 0; i < RMT_DHT_MAX; i++) {
+      xSemaphoreTake(self->_lock, portMAX_DELAY);
+      if (self->_running && i < self->_count) {
+        self->_read(self->_sensors[i]);
+      }
+      xSemaphoreGive(self->_lock);
+    }
+    vTaskDelay(pdMS_TO_TICKS(DHT_PERIOD_MS));
+  }
+}
+
+bool RmtDHT::get(int slot, float *temperature, float *humidity) {
+  if (slot < 0 || slot >= _count) {
+    return false;
+  }
+  Sensor &s = _sensors[slot];
+  portENTER_CRITICAL(&_mux);
+  uint32_t okMs = s.okMs;
+  *temperature = s.temperature;
+  *humidity = s.humidity;
+  portEXIT_CRITICAL(&_mux);
+  return okMs != 0 && millis() - okMs < DHT_STALE_MS;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file    RmtDHT.h
+ * @brief   RMT接收DHT11/DHT22温湿度传感器模块头文件
+ *
+ * @details 原有三种DHT实现都在调用者任务中逐位轮询电平，时序受调度影响，
+ *          需要把传感器任务临时提到最高优先级，期间阻塞WiFi和Broker。
+ *          这里由独立任务按DHT_PERIOD_MS轮流读取所有登记的传感器：
+ *          - 拉低数据线（DHT11 20ms，DHT22 2ms，期间任务休眠）后释放
+ *          - RMT接收通道以1µs分辨率记录传感器应答的脉冲宽度，空闲超过DHT_IDLE_US视为结束，
+ *            由驱动中断写入环形缓冲区，任务阻塞等待，不占用CPU
+ *          - 取最后40个高电平脉宽解码（>DHT_BIT_ONE_US为1），校验和正确后保存结果
+ *          传感器任务采集时只读取最近的结果，超过DHT_STALE_MS没有有效读数时视为无效。
+ *          ESP32-S3的RMT接收通道为4~7，最多支持4个传感器。
+ */
+#pragma once
+#include "global.h"
+#include "driver/rmt.h"
+#include "driver/gpio.h"
+#include "freertos/ringbuf.h"
+
+#define RMT_DHT_MAX 4                 ///< 最多传感器数（RMT接收通道数）
+#define RMT_DHT_FIRST_CHANNEL RMT_CHANNEL_4
+#define DHT_PERIOD_MS 2000            ///< 读取周期，DHT22要求不小于2秒
+#define DHT_STALE_MS 4000             ///< 超过该时间没有有效读数时输出NAN
+#define DHT_IDLE_US 200               ///< 电平保持超过该时间视为一帧结束（最长脉冲约80µs）
+#define DHT_BIT_ONE_US 40             ///< 数据位高电平宽度阈值（0约27µs，1约70µs）
+#define DHT_RX_TIMEOUT_MS 10          ///< 释放数据线后等待应答的时间（一帧约5ms）
+
+typedef enum {
+    RMT_DHT11,
+    RMT_DHT22,
+} RmtDHTType;
+
+class RmtDHT {
+public:
+    RmtDHT();
+
+    /**
+     * @brief 停止读取并释放RMT通道，重新配置IO口前调用
+     */
+    void reset();
+
+    /**
+     * @brief 登记一个传感器
+     * @param pin GPIO编号
+     * @param type 传感器型号
+     * @return int 槽号，RMT接收通道用完时返回-1
+     */
+    int add(uint8_t pin, RmtDHTType type);
+
+    /**
+     * @brief 配置RMT通道并启动读取任务，没有登记传感器时不启动
+     */
+    void begin();
+
+    /**
+     * @brief 读取最近的结果
+     * @param slot add()返回的槽号
+     * @param temperature 输出：温度（℃）
+     * @param humidity 输出：相对湿度（%）
+     * @return false 最近DHT_STALE_MS内没有有效读数
+     */
+    bool get(int slot, float *temperature, float *humidity);
+
+    uint32_t reads;  ///< 成功读数次数
+    uint32_t errors; ///< 无应答或校验错误次数
+
+private:
+    struct Sensor {
+        uint8_t pin;
+        RmtDHTType type;
+        rmt_channel_t channel;
+        RingbufHandle_t rb;
+        float temperature;
+        float humidity;
+        uint32_t okMs; // 最近一次有效读数的时刻，0为从未成功
+    };
+
+    Sensor _sensors[RMT_DHT_MAX];
+    uint8_t _count;
+    bool _running;
+    TaskHandle_t _task;
+    SemaphoreHandle_t _lock; // 串行化读取与停止
+    portMUX_TYPE _mux;       // 保护读数
+
+    void _read(Sensor &s);
+    static bool _decode(const rmt_item32_t *items, size_t count, uint8_t data[5]);
+    static void _reader(void *arg);
+};
+
+extern RmtDHT rmtDHT;
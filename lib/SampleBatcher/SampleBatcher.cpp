@@ -0,0 +1,279 @@
+/**
+ * @file    SampleBatcher.cpp
+ * @brief   多样本批量上报模块实现
+ */
+#include "SampleBatcher.h"
+
+SampleBatcher::SampleBatcher() : samplesIn(0), batchesOut(0), batchesDropped(0), _active(false) {
+  _default = {0, 0};
+  _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief 解析批量规则字符串
+ *
+ * @param value 规则字符串，如 "50"、"50, 1s"、"0, 500ms"
+ * @param rule 输出规则
+ * @return bool 解析成功返回true
+ */
+bool SampleBatcher::_parseRule(const char *value, BatchRule &rule) {
+  char buffer[MAX_VALUE_LEN];
+  strncpy(buffer, value, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+
+  rule = {0, 0};
+  for (char *tok = strtok(buffer, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    tok = trim(tok);
+    char *end = NULL;
+    float val = strtof(tok, &end);
+    if (end == tok || val < 0) {
+      return false;
+    }
+    if (strcasecmp(end, "ms") == 0) {
+      rule.windowMs = (uint32_t)val;
+    } else if (strcasecmp(end, "s") == 0) {
+      rule.windowMs = (uint32_t)(val * 1000.0f);
+    } else if (*end == '\0') {
+      rule.samples = val > BATCH_MAX_SAMPLES ? BATCH_MAX_SAMPLES : (uint16_t)val;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 从配置键值对读取批量规则
+ */
+void SampleBatcher::config(KeyValue *kv_pairs, int count) {
+  const char prefix[] = "Batch_";
+  const size_t prefixLen = sizeof(prefix) - 1;
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _rules.clear();
+  _batches.clear();
+  _ready.clear();
+  _immediate.clear();
+  _default = {0, 0};
+
+  for (int i = 0; i < count; i++) {
+    const char *key = kv_pairs[i].key;
+    const char *value = kv_pairs[i].value;
+    if (strncasecmp(key, prefix, prefixLen) != 0) {
+      continue;
+    }
+    if (strcasecmp(key, "Batch_Immediate") == 0) {
+      char buffer[MAX_VALUE_LEN];
+      strncpy(buffer, value, sizeof(buffer) - 1);
+      buffer[sizeof(buffer) - 1] = '\0';
+      for (char *tok = strtok(buffer, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        tok = trim(tok);
+        if (*tok) {
+          _immediate.push_back(String(tok));
+        }
+      }
+      continue;
+    }
+    BatchRule rule;
+    if (!_parseRule(value, rule)) {
+      printf("[Info]%s invalid: %s\n", key, value);
+      continue;
+    }
+    if (strcasecmp(key, "Batch_Default") == 0) {
+      _default = rule;
+    } else {
+      String topic = String(key + prefixLen);
+      topic.toLowerCase();
+      _rules[topic] = rule;
+    }
+  }
+
+  // 全部规则都为0时不启用
+  _active = (_default.samples > 0 || _default.windowMs > 0);
+  for (const auto &kv : _rules) {
+    _active = _active || kv.second.samples > 0 || kv.second.windowMs > 0;
+  }
+  xSemaphoreGive(_mutex);
+  printf("[Info]Batch: %s, %u topic rules, %u immediate fields\n", _active ? "on" : "off", (unsigned)_rules.size(),
+         (unsigned)_immediate.size());
+}
+
+/**
+ * @brief 查找主题规则，未单独配置时使用默认规则
+ *
+ * @return bool 主题启用批量上报返回true
+ */
+bool SampleBatcher::_ruleFor(const char *topic, BatchRule &rule) {
+  String name = topic;
+  name.toLowerCase();
+  auto it = _rules.find(name);
+  rule = it != _rules.end() ? it->second : _default;
+  return rule.samples > 0 || rule.windowMs > 0;
+}
+
+bool SampleBatcher::batched(const char *topic) {
+  if (!_active) {
+    return false;
+  }
+  BatchRule rule;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ret = _ruleFor(topic, rule);
+  xSemaphoreGive(_mutex);
+  return ret;
+}
+
+bool SampleBatcher::_isImmediate(const char *key, const String &path) {
+  for (const auto &name : _immediate) {
+    if (name.equalsIgnoreCase(key) || name.equalsIgnoreCase(path)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief 把样本的每个字段追加到对应列，新出现的列先补齐前面样本的null
+ */
+void SampleBatcher::_append(Batch &b, JsonObjectConst sample, const String &prefix) {
+  for (JsonPairConst kv : sample) {
+    const char *key = kv.key().c_str();
+    String path = prefix.length() > 0 ? prefix + "." + key : String(key);
+    if (kv.value().is<JsonObjectConst>()) {
+      _append(b, kv.value().as<JsonObjectConst>(), path);
+      continue;
+    }
+    if (_isImmediate(key, path) || path == "t0" || path == "dt") {
+      continue;
+    }
+    JsonArray col = b.doc[path].as<JsonArray>();
+    if (col.isNull()) {
+      col = b.doc[path].to<JsonArray>();
+      for (uint16_t i = 0; i < b.n; i++) {
+        col.add(nullptr);
+      }
+    }
+    col.add(kv.value());
+  }
+}
+
+/**
+ * @brief 提交批次到待发布队列
+ */
+void SampleBatcher::_flush(const String &topic, Batch &b) {
+  if (_ready.size() >= BATCH_READY_MAX) {
+    _ready.pop_front();
+    batchesDropped++;
+  }
+  _ready.emplace_back(topic, std::move(b.doc));
+  b.doc = JsonDocument();
+  b.n = 0;
+  batchesOut++;
+}
+
+/**
+ * @brief 加入一个样本
+ */
+void SampleBatcher::add(const char *topic, const String &json, uint32_t seq, uint64_t tsMs) {
+  if (!_active) {
+    return;
+  }
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  BatchRule rule;
+  if (!_ruleFor(topic, rule)) {
+    xSemaphoreGive(_mutex);
+    return;
+  }
+  auto it = _batches.find(topic);
+  if (it == _batches.end()) {
+    it = _batches.emplace(String(topic), Batch()).first;
+    it->second.n = 0;
+    it->second.hasSeq = false;
+  }
+  Batch &b = it->second;
+  b.rule = rule;
+  if (b.hasSeq && b.seq == seq) {
+    xSemaphoreGive(_mutex);
+    return;
+  }
+  b.seq = seq;
+  b.hasSeq = true;
+
+  JsonDocument sample;
+  if (deserializeJson(sample, json) || !sample.is<JsonObject>()) {
+    xSemaphoreGive(_mutex);
+    return;
+  }
+
+  uint32_t now = millis();
+  if (b.n == 0) {
+    b.doc.clear();
+    b.t0 = tsMs;
+    b.last = tsMs;
+    b.opened = now;
+    b.doc["t0"] = tsMs;
+    b.doc["dt"].to<JsonArray>();
+  }
+  // 校时可能使时间戳回退，差值保留符号
+  b.doc["dt"].add((int32_t)(int64_t)(tsMs - b.last));
+  b.last = tsMs;
+  _append(b, sample.as<JsonObjectConst>(), String());
+  b.n++;
+  samplesIn++;
+
+  // 本样本缺少的字段补null，保证各列长度一致
+  for (JsonPair kv : b.doc.as<JsonObject>()) {
+    if (kv.value().is<JsonArray>() && kv.value().as<JsonArray>().size() < b.n) {
+      kv.value().as<JsonArray>().add(nullptr);
+    }
+  }
+
+  uint16_t limit = rule.samples > 0 ? rule.samples : BATCH_MAX_SAMPLES;
+  if (b.n >= limit || (rule.windowMs > 0 && now - b.opened >= rule.windowMs) || measureJson(b.doc) >= BATCH_MAX_BYTES) {
+    _flush(it->first, b);
+  }
+  xSemaphoreGive(_mutex);
+}
+
+/**
+ * @brief 取出一个已完成的批次
+ */
+bool SampleBatcher::take(uint32_t nowMs, String &topic, JsonDocument &doc) {
+  if (!_active) {
+    return false;
+  }
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  // 采样停止或变慢时，按时间窗口提交未满的批次
+  for (auto &kv : _batches) {
+    Batch &b = kv.second;
+    if (b.n > 0 && b.rule.windowMs > 0 && (int32_t)(nowMs - b.opened) >= (int32_t)b.rule.windowMs) {
+      _flush(kv.first, b);
+    }
+  }
+  bool ret = !_ready.empty();
+  if (ret) {
+    topic = _ready.front().first;
+    doc = std::move(_ready.front().second);
+    _ready.pop_front();
+  }
+  xSemaphoreGive(_mutex);
+  return ret;
+}
+
+/**
+ * @brief 只保留低延迟字段
+ */
+bool SampleBatcher::keepImmediate(JsonObject obj) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  std::vector<String> drop;
+  for (JsonPair kv : obj) {
+    const char *key = kv.key().c_str();
+    if (!_isImmediate(key, String(key))) {
+      drop.push_back(String(key));
+    }
+  }
+  for (const auto &key : drop) {
+    obj.remove(key);
+  }
+  xSemaphoreGive(_mutex);
+  return obj.size() > 0;
+}
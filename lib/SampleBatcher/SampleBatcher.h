@@ -0,0 +1,113 @@
+/**
+ * @file    SampleBatcher.h
+ * @brief   多样本批量上报模块头文件
+ *
+ * @details 在采集侧累积每一次采样，攒够N个样本或T毫秒后合并为一条消息，
+ *          采集频率高于发布频率时也不会丢样本。消息为按列存放的数组：
+ *          {"t0":首个样本时间(ms),"dt":[与上一样本的时间差...],"Temperature":[...],...}
+ *          t0为UTC毫秒（SNTP同步前为开机后的毫秒数），dt为有符号毫秒数。
+ *          嵌套字段展开为"."连接的路径，某个样本缺少的字段填null。
+ *          配置项（config.txt）：
+ *          - Batch_Default: 所有主题的默认规则，如 "10, 500ms"
+ *          - Batch_<主题名>: 单主题规则，主题名为aggregate（topic_input整帧）或设备名，
+ *            如 "Batch_bmi160: 50, 1s"；规则为 "样本数[, 时间窗口]"，任一达到即发送，
+ *            批次JSON超过BATCH_MAX_BYTES时提前发送
+ *          - Batch_Immediate: 逗号分隔的低延迟字段，如 "Gesture, motion"，
+ *            这些字段不进入批次，仍按原方式即时发布
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "ArduinoJson.h"
+
+#define BATCH_MAX_SAMPLES 100    ///< 单批最大样本数
+#define BATCH_MAX_BYTES 6144     ///< 单批JSON最大长度，须小于Broker的最大报文长度
+#define BATCH_READY_MAX 8        ///< 等待发布的批次上限，超出时丢弃最旧批次
+#define BATCH_AGGREGATE "aggregate" ///< 整帧主题（topic_input）的规则名
+
+/**
+ * @brief 单主题批量规则
+ */
+typedef struct {
+    uint16_t samples;  ///< 每批样本数，0表示只按时间窗口
+    uint32_t windowMs; ///< 时间窗口，0表示只按样本数
+} BatchRule;
+
+class SampleBatcher {
+public:
+    SampleBatcher();
+
+    /**
+     * @brief 从配置键值对读取批量规则
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     * @details 重新配置时丢弃未完成的批次
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /** @brief 是否有主题启用批量上报 */
+    bool active() const { return _active; }
+
+    /**
+     * @brief 主题是否启用批量上报
+     * @param topic 主题名（aggregate或设备名）
+     */
+    bool batched(const char *topic);
+
+    /**
+     * @brief 加入一个样本（采集侧调用）
+     * @param topic 主题名（aggregate或设备名）
+     * @param json 样本JSON对象
+     * @param seq 样本序号，与上次相同时视为同一样本不重复加入
+     * @param tsMs 采样时间戳（毫秒，见TimeSync::stampMs）
+     * @details 时间窗口按本地开机时间计算，不受校时影响
+     */
+    void add(const char *topic, const String &json, uint32_t seq, uint64_t tsMs);
+
+    /**
+     * @brief 取出一个已完成的批次（发布侧调用）
+     * @param nowMs 当前时间，时间窗口到期的批次在此提交
+     * @param topic 输出：主题名
+     * @param doc 输出：批次数据
+     * @return true 取到批次
+     */
+    bool take(uint32_t nowMs, String &topic, JsonDocument &doc);
+
+    /**
+     * @brief 只保留低延迟字段
+     * @param obj 样本对象，非低延迟字段被移除
+     * @return true 仍有字段需要即时发布
+     */
+    bool keepImmediate(JsonObject obj);
+
+    uint32_t samplesIn;   ///< 加入批次的样本数
+    uint32_t batchesOut;  ///< 提交的批次数
+    uint32_t batchesDropped; ///< 发布不及时被丢弃的批次数
+
+private:
+    /** @brief 正在累积的批次 */
+    struct Batch {
+        BatchRule rule;
+        uint64_t t0;     ///< 首个样本时间戳
+        uint64_t last;   ///< 上一样本时间戳
+        uint32_t opened; ///< 批次开始的开机时间（毫秒），用于时间窗口
+        uint16_t n;      ///< 已累积样本数
+        uint32_t seq;    ///< 上一样本序号
+        bool hasSeq;
+        JsonDocument doc;
+    };
+
+    std::map<String, Batch> _batches;
+    std::map<String, BatchRule> _rules; ///< 键为小写主题名
+    BatchRule _default;
+    std::vector<String> _immediate;
+    std::deque<std::pair<String, JsonDocument>> _ready;
+    bool _active;
+    SemaphoreHandle_t _mutex;
+
+    bool _ruleFor(const char *topic, BatchRule &rule);
+    bool _isImmediate(const char *key, const String &path);
+    void _append(Batch &b, JsonObjectConst sample, const String &prefix);
+    void _flush(const String &topic, Batch &b);
+    static bool _parseRule(const char *value, BatchRule &rule);
+};
@@ -172,16 +172,28 @@ void I2CDeviceManager::searchI2CDevices()
  * 
  * @details 1. 遍历设备队列，通过互斥锁保证同一时间只有一个设备访问总线
  *          2. 调用传感器回调函数获取数据，并拼接成JSON格式字符串
+ *          3. 按设备保存采样片段及序号，供按设备发布主题使用
+ *          4. 设置了需求查询时，无人使用的设备不访问总线，沿用上次数据
  */
 void I2CDeviceManager::process()
 {
     String tempStr = "";
+    samples.clear();
     for (auto device : deviceQueue)
     {
         if (xSemaphoreTake(mutex, portMAX_DELAY)) //  申请锁
         {
-            device->callback();
-            tempStr += device->getResStr() + ",";
+            if (demand == NULL || demand(device->getTopicName()))
+            {
+                device->callback();
+            }
+            else
+            {
+                pollsSkipped++;
+            }
+            String res = device->getResStr();
+            tempStr += res + ",";
+            samples.push_back({device->getTopicName(), res, device->getSeq(), device->getReadUs()});
             xSemaphoreGive(mutex); //  释放锁
         }
     }
@@ -213,6 +225,14 @@ uint8_t I2CDeviceManager::getI2cCNT()
     return static_cast<uint8_t>(deviceQueue.size());
 }
 
+void I2CDeviceManager::stats(String &out)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"devices\":%u,\"polls_skipped\":%u}", (unsigned)getI2cCNT(),
+             (unsigned)pollsSkipped);
+    out = buf;
+}
+
 /**
  * @brief 获取设备地址的字符串表示（如"0X50,0X51"）
  * 
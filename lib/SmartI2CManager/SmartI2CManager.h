@@ -24,6 +24,14 @@ struct DeviceWrapper
     uint8_t fail_count;
 };
 
+/**
+ * @brief 设备需求查询函数
+ *
+ * @param topicName 设备主题名，如 "bme280"
+ * @return true 设备数据有人使用，需要采集
+ */
+typedef bool (*DeviceDemandFn)(const char *topicName);
+
 /**
  * @brief I2C设备管理类
  *
@@ -60,10 +68,17 @@ public:
      * @brief 处理所有已注册设备的数据采集
      *
      * @details 遍历设备队列，调用每个传感器的回调函数获取数据，
-     *          并将结果拼接为JSON格式字符串存储在JsonStr中。
+     *          并将结果拼接为JSON格式字符串存储在JsonStr中，同时按设备保存到samples。
      */
     void process();
 
+    /**
+     * @brief 设置设备需求查询函数
+     *
+     * @param fn 查询函数，返回false的设备本轮不读取，沿用上次数据；NULL表示全部读取
+     */
+    void setDemand(DeviceDemandFn fn) { demand = fn; }
+
     /**
      * @brief 获取所有已注册设备的I2C地址
      *
@@ -88,6 +103,18 @@ public:
     /** @brief 存储所有传感器数据的JSON格式字符串 */
     String JsonStr;
 
+    /** @brief 按设备拆分的采样数据，用于按设备发布主题 */
+    std::vector<DeviceSample> samples;
+
+    /** @brief 因无人使用而跳过的设备读取次数 */
+    uint32_t pollsSkipped = 0;
+
+    /**
+     * @brief 输出统计信息
+     * @param out 输出：{"devices":..,"polls_skipped":..}
+     */
+    void stats(String &out);
+
 private:
     /** @brief 设备映射表（键：I2C地址，值：设备包装结构体） */
     std::map<uint8_t, DeviceWrapper> deviceMap;
@@ -98,6 +125,9 @@ private:
     /** @brief 互斥锁（用于保护多线程环境下的共享资源） */
     SemaphoreHandle_t mutex;
 
+    /** @brief 设备需求查询函数 */
+    DeviceDemandFn demand = NULL;
+
     // 预定义需要扫描的设备地址列表
     const std::vector<uint8_t> kTargetDevices = {
         GestureFaceDetectionI2CHub::addr,
@@ -1,6 +1,11 @@
 #include "SmartIOManager.h"
+#include "mqtt_subscriber.h"
 
-SmartIOManager::SmartIOManager() {}
+SmartIOManager::SmartIOManager() {
+  for (int io_idx = 1; io_idx <= IO_PORT_NUM; io_idx++) {
+    this->_portLock[io_idx] = xSemaphoreCreateMutex();
+  }
+}
 
 SmartIOManager::~SmartIOManager() {
   for (auto &iohub : iohubs) {
@@ -20,6 +25,7 @@ void SmartIOManager::configIOhub(KeyValue *kv_pairs) {
 
     if (tempStr == NULL) {
       this->iohubs.push_back(new NanIOHub(ioPin, ioIdx));
+      this->_ports[ioIdx] = this->iohubs.back();
       continue;
     }
 
@@ -30,13 +36,34 @@ void SmartIOManager::configIOhub(KeyValue *kv_pairs) {
     // 根据类型设置不同的 IOHub 实例
     switch (name) {
     case IO_DIGITAL_OUT:
-      this->iohubs.push_back(new DigitalOutIOHub(ioPin, ioIdx));
+    case IO_PWM:
+    case IO_PATTERN:
+      this->iohubs.push_back(new DigitalOutIOHub(ioPin, ioIdx, name));
+      break;
+    case IO_ANALOG: {
+      AnalogIOHub *analog = new AnalogIOHub(ioPin, ioIdx);
+      // 取值方式：P<n>_Filter
+      sprintf(tempKey, "P%d_Filter", i + 1);
+      const char *filter = get_value_case_insensitive(kv_pairs, MAX_ENTRIES, tempKey);
+      analog->setFilter(AnalogSampler::parseFilter(filter));
+      this->iohubs.push_back(analog);
       break;
-    case IO_ANALOG:
-      this->iohubs.push_back(new AnalogIOHub(ioPin, ioIdx));
+    }
+    case IO_EMG: {
+      EMGIOHub *emg = new EMGIOHub(ioPin, ioIdx);
+      // 工频：P<n>_Notch
+      sprintf(tempKey, "P%d_Notch", i + 1);
+      const char *notch = get_value_case_insensitive(kv_pairs, MAX_ENTRIES, tempKey);
+      emg->setNotch(notch != NULL && atoi(notch) == 60 ? NOTCH_FREQ_60HZ : NOTCH_FREQ_50HZ);
+      this->iohubs.push_back(emg);
+      break;
+    }
+    case IO_HEARTRATE:
+      this->iohubs.push_back(new HeartRateIOHub(ioPin, ioIdx));
       break;
     case IO_DHT11:
-      this->iohubs.push_back(new DHT11EspIOHub(ioPin, ioIdx));
+    case IO_DHT22:
+      this->iohubs.push_back(new RmtDHTIOHub(ioPin, ioIdx, name));
       break;
     case IO_DS18B20:
       this->iohubs.push_back(new DS18B20IOHub(ioPin, ioIdx));
@@ -47,9 +74,17 @@ void SmartIOManager::configIOhub(KeyValue *kv_pairs) {
     case IO_SERVO360:
       this->iohubs.push_back(new Servo360IOHub(ioPin, ioIdx));
       break;
-    case IO_WS2812:
-      this->iohubs.push_back(new WS2812IOHub(ioPin, ioIdx));
+    case IO_WS2812: {
+      WS2812IOHub *strip = new WS2812IOHub(ioPin, ioIdx);
+      // 灯珠数：P<n>_Pixels
+      sprintf(tempKey, "P%d_Pixels", i + 1);
+      const char *pixels = get_value_case_insensitive(kv_pairs, MAX_ENTRIES, tempKey);
+      if (pixels != NULL && atoi(pixels) > 0) {
+        strip->setPixels(atoi(pixels));
+      }
+      this->iohubs.push_back(strip);
       break;
+    }
     case IO_SERVO300:
       this->iohubs.push_back(new Servo300IOHub(ioPin, ioIdx));
       break;
@@ -57,6 +92,7 @@ void SmartIOManager::configIOhub(KeyValue *kv_pairs) {
       this->iohubs.push_back(new NanIOHub(ioPin, ioIdx));
       break;
     }
+    this->_ports[ioIdx] = this->iohubs.back();
   }
 }
 
@@ -64,9 +100,14 @@ void SmartIOManager::configIOhub(KeyValue *kv_pairs) {
  * @brief 初始化所有 IOHub 实例
  */
 void SmartIOManager::init() {
+  // 模拟输入和DHT在init()中登记DMA/RMT通道，全部登记后统一启动
+  analogSampler.reset();
+  rmtDHT.reset();
   for (auto &iohub : iohubs) {
     iohub->init();
   }
+  analogSampler.begin();
+  rmtDHT.begin();
   // for (auto &iohub : ioConhubs) {
   //   iohub->init();
   // }
@@ -77,15 +118,22 @@ void SmartIOManager::init() {
  */
 void SmartIOManager::process() {
   String tempStr = "";
+  samples.clear();
+  _seq++;
   for (auto &iohub : iohubs) {
     // if (iohub->getName() == IO_DHT11 || iohub->getName() == IO_DS18B20 ||
     //     iohub->getName() == IO_ANALOG) {
     if(iohub->getType() == IO_GRAB){
       iohub->callback();
+      int64_t readUs = esp_timer_get_time();
       oled.setStaus(iohub->getIOIdx()-1, true);
+      String res = iohub->getDataJsonStr();
       if (tempStr.length() > 0)
         tempStr += ",";
-      tempStr += iohub->getDataJsonStr();
+      tempStr += res;
+      if (res.length() > 0) {
+        samples.push_back({"p" + String(iohub->getIOIdx()), res, _seq, readUs});
+      }
     }
   }
   if (tempStr.endsWith(",")) {
@@ -105,75 +153,302 @@ void SmartIOManager::process() {
 //     this->conJsonStr = tempStr;
 // }
 
+/**
+ * @brief 处理订阅到的消息
+ *
+ * @details MQTT_SUB_TOPIC 上为JSON指令；MQTT_SUB_TOPIC/p<n> 上为发给该IO口的原始二进制数据，
+ *          直接在信箱内交给 IOHub，不经过JSON解析。
+ */
+void SmartIOManager::handleMQTTMessage(const char *topic, const char *payload, size_t len) {
+  int64_t rxUs = esp_timer_get_time();
+  size_t base = strlen(MQTT_SUB_TOPIC);
+  if (strncmp(topic, MQTT_SUB_TOPIC, base) != 0 || topic[base] != '/') {
+    this->handleMQTTMessage(payload);
+    return;
+  }
+  int io_idx = this->_portIndex(topic + base + 1);
+  if (io_idx < 0 || this->_ports[io_idx] == nullptr) {
+    return;
+  }
+  oled.setStaus(io_idx - 1, true);
+  xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+  portENTER_CRITICAL(&this->_setpointMux);
+  this->_setpoints[io_idx].kind = Setpoint::SP_NONE;
+  portEXIT_CRITICAL(&this->_setpointMux);
+  this->_ports[io_idx]->setFrame((const uint8_t *)payload, len);
+  xSemaphoreGive(this->_portLock[io_idx]);
+  this->_recordLatency(rxUs);
+}
+
 /**
  * @brief 处理 MQTT 消息，解析 JSON 并调用相应的 IOHub 方法
  * @param json MQTT 消息的 JSON 字符串
  */
 void SmartIOManager::handleMQTTMessage(const char *json) {
+  int64_t rxUs = esp_timer_get_time();
   ArduinoJson::StaticJsonDocument<512> doc;
   DeserializationError error = deserializeJson(doc, json);
   if (error) {
     printf("JSON decode failed.\n");
     return;
   }
-  this->_handleMQTTMessage(doc);
+  this->_handleMQTTMessage(doc, rxUs);
 }
 
-void SmartIOManager::_handleMQTTMessage(JsonDocument &doc) {
-  for (auto &iohub : iohubs) {
-    char key[8];
-    uint8_t io_idx = iohub->getIOIdx();
-    sprintf(key, "p%d", io_idx);
-    if (!doc.containsKey(key)) {
-      sprintf(key, "P%d", io_idx);
-      if (!doc.containsKey(key)) {
+/**
+ * @brief 分发控制指令
+ *
+ * @details 只遍历一次JSON对象，键直接换算为IO口编号查表，
+ *          值按类型调用 IOHub 的类型化接口，不做字符串转换；不接受控制的IO口忽略指令。
+ *          数值（包括纯数字字符串）和运动指令 {"target":..,"speed":..,"accel":..}
+ *          写入设定值槽由执行器任务执行；灯带效果指令 {"fx":..} 交给效果任务渲染；
+ *          其他对象指令（如PWM {"duty":..,"freq":..}）由 IOHub::setObject 直接执行；其他字符串（文本命令、灯带数据）直接执行，
+ *          并清除该IO口更早的待执行数值，保持最新指令生效。直接执行时持有该IO口的互斥锁，
+ *          与执行器任务、效果任务不会同时驱动同一个IOHub。
+ */
+void SmartIOManager::_handleMQTTMessage(JsonDocument &doc, int64_t rxUs) {
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    int io_idx = this->_portIndex(kv.key().c_str());
+    if (io_idx < 0 || this->_ports[io_idx] == nullptr) {
+      continue;
+    }
+    IOHub *iohub = this->_ports[io_idx];
+    oled.setStaus(io_idx - 1, true);
+
+    JsonVariant value = kv.value();
+    Setpoint sp = {};
+    sp.rxUs = rxUs;
+    if (value.is<int32_t>()) {
+      sp.kind = Setpoint::SP_INT;
+      sp.i = value.as<int32_t>();
+      this->_post(io_idx, sp);
+    } else if (value.is<float>()) {
+      sp.kind = Setpoint::SP_FLOAT;
+      sp.f = value.as<float>();
+      this->_post(io_idx, sp);
+    } else if (value["fx"].is<const char *>()) {
+      LedEffect fx;
+      if (!fx.parse(value.as<JsonObjectConst>())) {
         continue;
       }
+      xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+      bool started = iohub->setEffect(fx);
+      xSemaphoreGive(this->_portLock[io_idx]);
+      if (started && this->_effectTask != NULL) {
+        xTaskNotifyGive(this->_effectTask);
+      }
+    } else if (value.is<JsonObject>()) {
+      JsonObject motion = value.as<JsonObject>();
+      if (!motion["target"].is<float>()) {
+        // IO口特有的对象指令（PWM、闪烁等）直接执行
+        xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+        portENTER_CRITICAL(&this->_setpointMux);
+        this->_setpoints[io_idx].kind = Setpoint::SP_NONE;
+        portEXIT_CRITICAL(&this->_setpointMux);
+        iohub->setObject(motion);
+        xSemaphoreGive(this->_portLock[io_idx]);
+        this->_recordLatency(rxUs);
+        continue;
+      }
+      sp.kind = Setpoint::SP_MOTION;
+      sp.motion.target = motion["target"].as<float>();
+      sp.motion.speed = motion["speed"] | 0.0f;
+      sp.motion.accel = motion["accel"] | 0.0f;
+      this->_post(io_idx, sp);
+    } else if (value.is<const char *>()) {
+      JsonString str = value.as<JsonString>();
+      char *end;
+      sp.f = strtof(str.c_str(), &end);
+      if (str.size() > 0 && end == str.c_str() + str.size()) {
+        sp.kind = Setpoint::SP_FLOAT;
+        this->_post(io_idx, sp);
+        continue;
+      }
+      xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+      portENTER_CRITICAL(&this->_setpointMux);
+      this->_setpoints[io_idx].kind = Setpoint::SP_NONE;
+      portEXIT_CRITICAL(&this->_setpointMux);
+      iohub->setBytes(str.c_str(), str.size());
+      xSemaphoreGive(this->_portLock[io_idx]);
+      this->_recordLatency(rxUs);
     }
+  }
+}
 
-    SensorName name = iohub->getName();
-    uint8_t pin = iohub->getPin();
-
-    oled.setStaus(io_idx - 1, true);
+/**
+ * @brief 写入设定值槽，覆盖尚未执行的旧值并唤醒执行器任务
+ */
+void SmartIOManager::_post(int io_idx, const Setpoint &sp) {
+  if (this->_actuatorTask == NULL) {
+    this->_setpoints[io_idx] = sp;
+    this->applySetpoints();
+    return;
+  }
+  portENTER_CRITICAL(&this->_setpointMux);
+  if (this->_setpoints[io_idx].kind != Setpoint::SP_NONE) {
+    this->coalesced++;
+  }
+  this->_setpoints[io_idx] = sp;
+  portEXIT_CRITICAL(&this->_setpointMux);
+  xTaskNotifyGive(this->_actuatorTask);
+}
 
-    if (name == IO_WS2812) {
-      const char *value = doc[key];
-      iohub->callback(value);
+/**
+ * @brief 执行所有IO口待执行的设定值
+ *
+ * @details 每个IO口在互斥锁内取走设定值并执行，接收任务直接执行的文本、对象指令
+ *          不会插在取值和执行之间，被更早的设定值覆盖
+ */
+void SmartIOManager::applySetpoints() {
+  for (int io_idx = 1; io_idx <= IO_PORT_NUM; io_idx++) {
+    IOHub *iohub = this->_ports[io_idx];
+    if (iohub == nullptr) {
+      continue;
+    }
+    xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+    portENTER_CRITICAL(&this->_setpointMux);
+    Setpoint sp = this->_setpoints[io_idx];
+    this->_setpoints[io_idx].kind = Setpoint::SP_NONE;
+    portEXIT_CRITICAL(&this->_setpointMux);
+    if (sp.kind == Setpoint::SP_NONE) {
+      xSemaphoreGive(this->_portLock[io_idx]);
+      continue;
+    }
+    if (sp.kind == Setpoint::SP_INT) {
+      iohub->setInt(sp.i);
+    } else if (sp.kind == Setpoint::SP_FLOAT) {
+      iohub->setFloat(sp.f);
     } else {
-      // 处理其他类型控制命令
-      std::string valueStr;
-      printf("tests %s\n", doc[key]);
-      // 根据JSON值类型转换为字符串
-      if (doc[key].is<const char *>())
-        valueStr = doc[key].as<const char *>();
-      else if (doc[key].is<int>())
-        valueStr = std::to_string(doc[key].as<int>());
-      else if (doc[key].is<float>()) {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%.2f", doc[key].as<float>());
-        valueStr = buf;
-      } else
+      iohub->setMotion(sp.motion.target, sp.motion.speed, sp.motion.accel);
+    }
+    xSemaphoreGive(this->_portLock[io_idx]);
+    this->applied++;
+    this->_recordLatency(sp.rxUs);
+  }
+}
+
+/**
+ * @brief 记录一条指令从开始处理到写入IO口输出的延迟
+ *
+ * @param rxUs 开始处理指令的时刻（esp_timer微秒）
+ */
+void SmartIOManager::_recordLatency(int64_t rxUs) {
+  uint32_t us = (uint32_t)(esp_timer_get_time() - rxUs);
+  portENTER_CRITICAL(&this->_setpointMux);
+  this->_latencyLast = us;
+  if (us > this->_latencyMax) {
+    this->_latencyMax = us;
+  }
+  this->_latencySum += us;
+  this->_latencyCount++;
+  portEXIT_CRITICAL(&this->_setpointMux);
+}
+
+/**
+ * @brief 推进所有IO口的运动曲线
+ * @return true 仍有IO口在运动
+ */
+bool SmartIOManager::_updateMotion() {
+  bool moving = false;
+  int64_t now = esp_timer_get_time();
+  for (int io_idx = 1; io_idx <= IO_PORT_NUM; io_idx++) {
+    if (this->_ports[io_idx] == nullptr) {
+      continue;
+    }
+    xSemaphoreTake(this->_portLock[io_idx], portMAX_DELAY);
+    moving |= this->_ports[io_idx]->update(now);
+    xSemaphoreGive(this->_portLock[io_idx]);
+  }
+  return moving;
+}
+
+/**
+ * @brief 执行器任务
+ *
+ * @details 空闲时阻塞等待，收到新设定值立即执行，之后至少间隔ACTUATOR_TICK_MS再执行下一轮，
+ *          期间同一IO口的多次指令只执行最后一次。
+ *          有舵机在运动时以ACTUATOR_TICK_MS为周期推进运动曲线并更新PWM输出。
+ */
+void SmartIOManager::_actuator(void *arg) {
+  SmartIOManager *self = (SmartIOManager *)arg;
+  bool moving = false;
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    if (!moving) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      lastWake = xTaskGetTickCount();
+    }
+    self->applySetpoints();
+    moving = self->_updateMotion();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ACTUATOR_TICK_MS));
+  }
+}
+
+void SmartIOManager::beginActuator() {
+  xTaskCreate(_actuator, "actuator", 4096, this, 8, &this->_actuatorTask);
+}
+
+/**
+ * @brief 灯带效果任务
+ *
+ * @details 没有运行中的效果时阻塞等待，否则每FX_FRAME_MS渲染一帧。
+ *          优先级低于传感器任务，LiteLED刷新灯带的等待不影响采集。
+ */
+void SmartIOManager::_effects(void *arg) {
+  SmartIOManager *self = (SmartIOManager *)arg;
+  bool running = false;
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    if (!running) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      lastWake = xTaskGetTickCount();
+    }
+    running = false;
+    uint32_t now = millis();
+    for (int io_idx = 1; io_idx <= IO_PORT_NUM; io_idx++) {
+      if (self->_ports[io_idx] == nullptr) {
         continue;
-      const char *valCStr = valueStr.c_str();
-      printf("str: %s\n", valCStr);
-      switch (name) {
-      case IO_SERVO180:
-        iohub->callback(valCStr);
-        break;
-      case IO_SERVO300:
-        iohub->callback(valCStr);
-        break;
-      case IO_SERVO360:
-        iohub->callback(valCStr);
-        break;
-      case IO_DIGITAL_OUT:
-        iohub->callback(valCStr);
-        break;
-      default:
-        break;
       }
+      xSemaphoreTake(self->_portLock[io_idx], portMAX_DELAY);
+      running |= self->_ports[io_idx]->animate(now);
+      xSemaphoreGive(self->_portLock[io_idx]);
     }
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(FX_FRAME_MS));
+  }
+}
+
+void SmartIOManager::beginEffects() {
+  xTaskCreate(_effects, "ledfx", 4096, this, 3, &this->_effectTask);
+}
+
+void SmartIOManager::stats(String &out) {
+  portENTER_CRITICAL(&this->_setpointMux);
+  uint32_t last = this->_latencyLast;
+  uint32_t max = this->_latencyMax;
+  uint32_t avg = this->_latencyCount > 0 ? (uint32_t)(this->_latencySum / this->_latencyCount) : 0;
+  this->_latencyMax = 0;
+  this->_latencySum = 0;
+  this->_latencyCount = 0;
+  portEXIT_CRITICAL(&this->_setpointMux);
+  char buf[192];
+  snprintf(buf, sizeof(buf),
+           "{\"applied\":%u,\"coalesced\":%u,\"dropped\":%u,\"latency_us\":{\"last\":%u,\"avg\":%u,\"max\":%u}}",
+           (unsigned)this->applied, (unsigned)this->coalesced, (unsigned)mqtt_sub_mailbox_dropped(), (unsigned)last,
+           (unsigned)avg, (unsigned)max);
+  out = buf;
+}
+
+/**
+ * @brief 指令键换算为IO口编号
+ *
+ * @param key "p1"~"p6"，不区分大小写
+ * @return int IO口编号，不是IO口的键返回-1
+ */
+int SmartIOManager::_portIndex(const char *key) {
+  if ((key[0] != 'p' && key[0] != 'P') || key[1] < '1' || key[1] > '0' + IO_PORT_NUM || key[2] != '\0') {
+    return -1;
   }
+  return key[1] - '0';
 }
 
 /**
@@ -210,10 +485,20 @@ SensorName SmartIOManager::_getIOModeFromString(char *val) {
     return IO_ANALOG;
   } else if (strcmp(val, "output") == 0) {
     return IO_DIGITAL_OUT;
+  } else if (strcmp(val, "pwm") == 0) {
+    return IO_PWM;
+  } else if (strcmp(val, "pattern") == 0) {
+    return IO_PATTERN;
+  } else if (strcmp(val, "emg") == 0) {
+    return IO_EMG;
+  } else if (strcmp(val, "heartrate") == 0) {
+    return IO_HEARTRATE;
   } else if (strcmp(val, "ws2812") == 0) {
     return IO_WS2812;
   } else if (strcmp(val, "dht11") == 0) {
     return IO_DHT11;
+  } else if (strcmp(val, "dht22") == 0) {
+    return IO_DHT22;
   } else if (strcmp(val, "ds18b20") == 0) {
     return IO_DS18B20;
   } else if (strcmp(val, "servo180") == 0) {
@@ -6,10 +6,34 @@
 
 #include "IOHub.h"
 #include "Display.h"
+#include "esp_timer.h"
 
 /** @brief 外部声明的OLED显示屏对象 */
 extern ScreenDisplay oled;
 
+#define ACTUATOR_TICK_MS 20 ///< 执行器更新周期（舵机PWM周期，50Hz），期间到达的设定值只保留最新的
+
+/**
+ * @brief IO口设定值槽
+ *
+ * @details 数值及运动指令只写入对应IO口的槽，执行器任务每个周期取走最新值执行，
+ *          未执行的旧值被新值覆盖（合并）。文本、对象指令由接收任务直接执行，
+ *          两者都在该IO口的互斥锁内完成取值（或清槽）到执行，后到的指令总是最后生效。
+ */
+typedef struct {
+    enum : uint8_t { SP_NONE, SP_INT, SP_FLOAT, SP_MOTION } kind;
+    union {
+        int32_t i;
+        float f;
+        struct {
+            float target;
+            float speed; ///< <=0 使用默认值
+            float accel; ///< <=0 使用默认值
+        } motion;
+    };
+    int64_t rxUs; ///< 开始处理该指令的时刻（esp_timer微秒），用于统计指令到输出的延迟
+} Setpoint;
+
 class SmartIOManager {
 public:
     SmartIOManager();
@@ -44,14 +68,78 @@ public:
      */
     void handleMQTTMessage(const char *json);
 
+    /**
+     * @brief 处理订阅到的消息，按主题区分JSON指令和IO口原始数据
+     * @param topic 消息主题
+     * @param payload 消息内容（可能为二进制）
+     * @param len 消息长度
+     */
+    void handleMQTTMessage(const char *topic, const char *payload, size_t len);
+
+    /**
+     * @brief 启动执行器任务，之后数值及运动指令经设定值槽合并执行，舵机运动曲线由该任务推进
+     */
+    void beginActuator();
+
+    /**
+     * @brief 启动灯带效果任务
+     */
+    void beginEffects();
+
+    /**
+     * @brief 执行所有IO口待执行的设定值
+     */
+    void applySetpoints();
+
+    /**
+     * @brief 输出指令统计
+     * @param out 输出：{"applied":..,"coalesced":..,"dropped":..,"latency_us":{"last":..,"avg":..,"max":..}}，
+     *            dropped为指令信箱满或过长被丢弃的指令数；latency_us为开始处理指令到写入IO口输出的耗时，
+     *            avg和max统计自上次输出以来的指令，输出后清零
+     */
+    void stats(String &out);
+
+    uint32_t applied = 0;   ///< 已执行的设定值数
+    uint32_t coalesced = 0; ///< 执行前被新值覆盖的设定值数
+
     String JsonStr;
     String conJsonStr;
+
+    /** @brief 按IO口拆分的采样数据（设备名为"p1"~"p6"），用于按设备发布主题 */
+    std::vector<DeviceSample> samples;
 private:
     std::vector<IOHub *> iohubs; // 存储 IOHub 实例的指针数组
 
     std::vector<IOHub *> ioConhubs; // 存储持续运行的 IOHub 实例的指针数组
 
-    void _handleMQTTMessage(JsonDocument &doc);
+    IOHub *_ports[IO_PORT_NUM + 1] = {nullptr}; // 按IO口编号（1~IO_PORT_NUM）索引的 IOHub，用于指令分发
+
+    Setpoint _setpoints[IO_PORT_NUM + 1] = {};  // 按IO口编号索引的待执行设定值
+    SemaphoreHandle_t _portLock[IO_PORT_NUM + 1] = {}; // 按IO口编号索引的互斥锁，驱动IOHub输出（取设定值到执行完成）期间持有
+    portMUX_TYPE _setpointMux = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t _actuatorTask = NULL;
+    TaskHandle_t _effectTask = NULL;
+
+    uint32_t _seq = 0; // 采集轮次，IO 传感器每轮都产生新数据
+
+    uint32_t _latencyLast = 0;  // 最近一条指令的延迟（微秒）
+    uint32_t _latencyMax = 0;   // 统计周期内的最大延迟
+    uint64_t _latencySum = 0;   // 统计周期内的延迟总和
+    uint32_t _latencyCount = 0; // 统计周期内的指令数
+
+    void _handleMQTTMessage(JsonDocument &doc, int64_t rxUs);
+
+    void _recordLatency(int64_t rxUs);
+
+    int _portIndex(const char *key);
+
+    void _post(int io_idx, const Setpoint &sp);
+
+    bool _updateMotion();
+
+    static void _actuator(void *arg);
+
+    static void _effects(void *arg);
 
     char *_str_to_lower_copy(const char *src, char *dst, size_t dstSize);
 
@@ -15,6 +15,16 @@
 // #include "ioSensor.h"
 #include "Display.h"
 #include "mqtt_subscriber.h"
+#include "mqtt_publisher.h"
+#include "mqtt_server.h"
+#include "mqtt_bridge.h"
+#include "ReportFilter.h"
+#include "TopicRouter.h"
+#include "PayloadCodec.h"
+#include "SampleBatcher.h"
+#include "PublishPacer.h"
+#include "TimeSync.h"
+#include "AnalogSampler.h"
 
 #include "SmartIOManager.h"
 
@@ -27,6 +37,8 @@ TaskHandle_t main_handle, wifiConfig_handle, flushConfig_handle, display_handle,
     mqttPublish_handle;
 
 String JsonSensorData = "";
+int64_t JsonSensorTime = 0;                 // 整帧数据读取完成时刻（esp_timer微秒，受JsonDataMutex保护）
+std::vector<DeviceSample> DeviceSensorData; // 按设备拆分的传感器数据（受JsonDataMutex保护）
 SemaphoreHandle_t JsonDataMutex = xSemaphoreCreateMutex(); // MQTT互斥锁
 
 // 全局实例化组件对象
@@ -39,17 +51,21 @@ extern USB_MSC msc;
 KeyValue keyValue[MAX_ENTRIES];         // 键值对数组（存储配置文件内容）
 SystemState sys_state = {0};            // 系统状态结构体（含互斥锁）
 QueueHandle_t xSystemEventQueue = NULL; // 系统事件队列（任务间通信）
-QueueHandle_t jsonPtrQueue;             // JSON数据队列（存储传感器数据）
 
 SemaphoreHandle_t mqtt_mutex = xSemaphoreCreateMutex(); // MQTT互斥锁
 // IOSensorHub ioSensorHub;                                // IO传感器中枢实例
 SmartIOManager smartIOManager; // 智能IO管理器实例
+ReportFilter reportFilter;     // 变化上报过滤器
+TopicRouter topicRouter;       // 按设备/字段发布主题
+PayloadCodec payloadCodec;     // 负载编码（JSON/MessagePack/CBOR）
+SampleBatcher sampleBatcher;   // 多样本批量上报
+PublishPacer publishPacer;     // 自适应发布节奏
+extern uint32_t chipId;
 
 float UpdateIntervalTime = 1.0; // 数据上报间隔（秒）
 
 bool lastButtonState = HIGH;                                // 上一次按钮状态
 SemaphoreHandle_t wakeSemaphore = xSemaphoreCreateBinary(); // 唤醒信号量
-QueueHandle_t mqttSubQueue;                                 // MQTT消息队列
 bool StateLED = true;                                       // 状态灯
 
 static char *str_to_lower(const char *src, char *dst, size_t dstSize) {
@@ -63,39 +79,204 @@ static char *str_to_lower(const char *src, char *dst, size_t dstSize) {
 
 
 
+/**
+ * @brief 把一条消息交给MQTT发布任务
+ *
+ * @param topic 发布主题，NULL表示默认主题topic_input
+ * @param payload 消息内容（JSON文本或二进制编码）
+ * @param len 消息长度
+ * @param retain 是否作为保留消息发布
+ */
+static void enqueueMessage(const char *topic, const char *payload, size_t len, bool retain) {
+  if (!sys_state.mqtt_running) {
+    return;
+  }
+  // 从发布帧池取帧，池满时丢弃最旧的未发送消息，发布任务不会阻塞在拥塞的Broker后面
+  mqtt_pub_msg_t *msg = mqtt_pub_msg_new(topic, payload, len);
+  if (msg != NULL) {
+    msg->retain = retain;
+    // LOG_INFO("%s/n", msg->payload);
+    mqtt_pub_msg_send(msg);
+  } else {
+    // 超过大帧长度（Broker最大报文长度）或所有帧都在使用中
+    LOG_ERROR("[Error]Publish frame unavailable: %u bytes\n", (unsigned)len);
+  }
+}
+
+static void enqueuePublish(const char *topic, const char *payload, size_t len) {
+  enqueueMessage(topic, payload, len, false);
+}
+
+#define PUBLISH_STATS_INTERVAL_MS 5000 // 发布统计的上报周期
+
+/**
+ * @brief 按当前负载格式编码并发布一个JSON对象
+ *
+ * @param topic 发布主题，NULL表示默认主题topic_input
+ * @param doc 传感器数据
+ * @details 二进制格式直接编码进发布帧池的帧中，不经过中间缓冲区再拷贝
+ */
+static void publishDocument(const char *topic, const JsonDocument &doc) {
+  if (payloadCodec.binary()) {
+    if (!sys_state.mqtt_running) {
+      return;
+    }
+    // 二进制格式：按字段ID编码为MessagePack/CBOR
+    // 按JSON文本长度预留帧，编码结果通常更短；个别帧超出时改用最大长度重新编码
+    size_t hint = measureJson(doc);
+    size_t len = 0;
+    mqtt_pub_msg_t *msg = NULL;
+    for (size_t want : {hint < PAYLOAD_FRAME_MAX ? hint : (size_t)PAYLOAD_FRAME_MAX, (size_t)PAYLOAD_FRAME_MAX}) {
+      msg = mqtt_pub_msg_reserve(topic, want);
+      if (msg == NULL) {
+        LOG_ERROR("[Error]Publish frame unavailable: %u bytes\n", (unsigned)want);
+        return;
+      }
+      len = payloadCodec.encode(doc.as<JsonObjectConst>(), (uint8_t *)msg->payload, mqtt_pub_msg_room(msg));
+      if (len > 0) {
+        break;
+      }
+      mqtt_pub_msg_free(msg);
+      msg = NULL;
+    }
+    if (msg == NULL) {
+      return;
+    }
+    msg->payload[len] = '\0';
+    msg->len = len;
+    mqtt_pub_msg_send(msg);
+  } else {
+    String json;
+    serializeJson(doc, json);
+    enqueuePublish(topic, json.c_str(), json.length());
+  }
+}
+
+/**
+ * @brief 在整帧JSON开头加入采样时间戳"ts"（UTC毫秒），未校时不加
+ *
+ * @param json 整帧JSON，如 {"Temperature":25.3}
+ * @param monoUs 读取完成时刻（esp_timer微秒）
+ */
+static void stampFrame(String &json, int64_t monoUs) {
+  if (!timeSync.synced() || !json.startsWith("{")) {
+    return;
+  }
+  char ts[32];
+  snprintf(ts, sizeof(ts), "{\"ts\":%llu%s", (unsigned long long)timeSync.utcMs(monoUs), json.length() > 2 ? "," : "");
+  json = ts + json.substring(1);
+}
+
 /**
  * @brief mqtt发布数据
  * 
  * @param pvParameters 
  */
 void mqttPublishTask(void *pvParameters) {
+  uint32_t statsAt = 0;
   while (1) {
     if (sys_state.mqtt_running) {
       // printf("%s\n", resStr.c_str());
       String resStr = "";
-      char *jsonPtr = NULL;
+      int64_t frameUs = 0;
+      std::vector<DeviceSample> samples;
+      // 没有订阅者的主题不拷贝、不编码；按设备发布时由TopicRouter逐个设备主题判断
+      bool aggregate = topicRouter.aggregate() && publishPacer.wanted(MQTT_PUB_TOPIC);
+      bool perDevice = topicRouter.perDevice();
       if (xSemaphoreTake(JsonDataMutex, portMAX_DELAY)) {
-        jsonPtr = (char *)malloc(JsonSensorData.length() + 1);
-        resStr = JsonSensorData;
+        if (aggregate) {
+          resStr = JsonSensorData;
+          frameUs = JsonSensorTime;
+        }
+        if (perDevice) {
+          samples = DeviceSensorData;
+        }
         xSemaphoreGive(JsonDataMutex);
       }
 
-      if (jsonPtr != NULL && sys_state.mqtt_running) {
-        strcpy(jsonPtr, resStr.c_str());
-        // LOG_INFO("%s/n", jsonPtr);
-        xQueueSend(jsonPtrQueue, &jsonPtr, portMAX_DELAY);
-
-      } else {
-        LOG_ERROR("[Error]JSON\n");
+      if (aggregate) {
+        // 变化上报模式：只发送超出死区或到达心跳周期的字段，无变化时本周期不发送
+        bool send = true;
+        if (sampleBatcher.batched(BATCH_AGGREGATE)) {
+          // 整帧已批量上报，这里只即时发送低延迟字段
+          JsonDocument doc;
+          send = !deserializeJson(doc, resStr) && sampleBatcher.keepImmediate(doc.as<JsonObject>());
+          resStr = "";
+          serializeJson(doc, resStr);
+        }
+        if (send && reportFilter.enabled()) {
+          String changed;
+          send = reportFilter.filter(resStr, changed, millis());
+          resStr = changed;
+        }
+        // 时间戳在过滤之后加入，不参与变化判断
+        if (send && payloadCodec.binary()) {
+          // 二进制格式只解析一次，时间戳直接加入文档，不再拼接JSON文本
+          JsonDocument doc;
+          if (!deserializeJson(doc, resStr)) {
+            if (timeSync.synced()) {
+              doc["ts"] = timeSync.utcMs(frameUs);
+            }
+            publishDocument(NULL, doc);
+          }
+        } else if (send) {
+          stampFrame(resStr, frameUs);
+          enqueuePublish(NULL, resStr.c_str(), resStr.length());
+        }
+      }
+      if (perDevice) {
+        // 按设备/字段发布到 <前缀>/<设备>[/<字段>]
+        topicRouter.route(samples, millis(), payloadCodec, sampleBatcher, publishPacer, enqueuePublish);
+      }
+      // 发布已攒满或时间窗口到期的批次
+      String batchName;
+      JsonDocument batch;
+      while (sampleBatcher.take(millis(), batchName, batch)) {
+        if (batchName == BATCH_AGGREGATE) {
+          if (publishPacer.wanted(MQTT_PUB_TOPIC)) {
+            publishDocument(NULL, batch);
+          }
+        } else {
+          String topic = String(topicRouter.prefix()) + "/" + batchName;
+          if (publishPacer.wanted(topic.c_str())) {
+            publishDocument(topic.c_str(), batch);
+          }
+        }
+      }
+      // 字段ID描述作为保留消息发布，首次及新增字段时更新
+      String schema;
+      if (payloadCodec.binary() && payloadCodec.takeSchema(schema)) {
+        String topic = String(topicRouter.prefix()) + "/schema";
+        enqueueMessage(topic.c_str(), schema.c_str(), schema.length(), true);
       }
       // 限制上报间隔在有效范围内（0.1-10秒）
       if (UpdateIntervalTime < 0.02f || UpdateIntervalTime > 10.0f) {
         UpdateIntervalTime = 1.0f;
       }
 
+      // 自适应、指令、变化上报及I2C轮询统计作为保留消息定期发布
+      if ((int32_t)(millis() - statsAt) >= PUBLISH_STATS_INTERVAL_MS) {
+        statsAt = millis();
+        String stats;
+        publishPacer.stats(stats);
+        String topic = String(topicRouter.prefix()) + "/stats/publish";
+        enqueueMessage(topic.c_str(), stats.c_str(), stats.length(), true);
+        smartIOManager.stats(stats);
+        topic = String(topicRouter.prefix()) + "/stats/commands";
+        enqueueMessage(topic.c_str(), stats.c_str(), stats.length(), true);
+        reportFilter.stats(stats);
+        topic = String(topicRouter.prefix()) + "/stats/report";
+        enqueueMessage(topic.c_str(), stats.c_str(), stats.length(), true);
+        i2cDeviceManager.stats(stats);
+        topic = String(topicRouter.prefix()) + "/stats/i2c";
+        enqueueMessage(topic.c_str(), stats.c_str(), stats.length(), true);
+      }
+
       int16_t IntervalTime = 1000 * UpdateIntervalTime;
       // LOG_DEBUG("IntervalTime:%d\n", IntervalTime);
-      vTaskDelay(pdTICKS_TO_MS(IntervalTime));
+      // Broker发送缓冲区或发布队列积压时拉长间隔，积压消除后恢复
+      uint32_t waitMs = publishPacer.next(IntervalTime, mqtt_server_backlog(), mqtt_pub_pool_queued());
+      vTaskDelay(pdMS_TO_TICKS(waitMs));
     } else {
       vTaskDelay(pdMS_TO_TICKS(1000));
     }
@@ -113,9 +294,7 @@ void mqttPublishTask(void *pvParameters) {
 void start_task(void) {
   firmwareUpdater.performUpdate("/firmware.bin");
   // 检查并执行固件升级（从文件系统加载/firmware.bin）
-  jsonPtrQueue = xQueueCreate(8, sizeof(char *));
-  mqttSubQueue = xQueueCreate(8, sizeof(MQTTMessage));
-  if (!jsonPtrQueue) {
+  if (!mqtt_sub_mailbox_init()) {
     printf("Queue or mutex creation failed!\n");
     esp_restart();
   }
@@ -135,8 +314,14 @@ void start_task(void) {
   vTaskDelay(5);
   xTaskCreate(mqttPublishTask, "mqttPublishTask", 4096 * 4, NULL, 7, &mqttPublish_handle);
   vTaskDelay(5);
+  timeSync.begin();
+  vTaskDelay(5);
   xTaskCreate(mqttHandlerTask, "SubTask", 4096 * 5, NULL, 8, &mqttJson_handle);
   vTaskDelay(5);
+  smartIOManager.beginActuator();
+  vTaskDelay(5);
+  smartIOManager.beginEffects();
+  vTaskDelay(5);
   xTaskCreate(buttonPollTask, "buttonPollTask", 2048, NULL, 2, NULL);
   vTaskDelay(5);
   xTaskCreate(datLedTask, "datLedTask", 2048, NULL, 1, NULL);
@@ -181,6 +366,24 @@ void app_main(void *args) {
         uint8_t cnt = parse_kv(str.c_str(), keyValue, MAX_ENTRIES);
         // 设置数据上报间隔
         setUpdateInterval();
+        // 设置Broker单客户端发布限速
+        setBrokerRateLimit();
+        // 设置上游桥接
+        setBridgeConfig();
+        // 设置变化上报模式及字段死区
+        reportFilter.config(keyValue, cnt);
+        // 设置按设备/字段发布主题
+        topicRouter.config(keyValue, cnt, chipId);
+        // 设置负载编码格式
+        payloadCodec.config(keyValue, cnt);
+        // 设置多样本批量上报
+        sampleBatcher.config(keyValue, cnt);
+        // 设置SNTP校时
+        timeSync.config(keyValue, cnt);
+        // 设置自适应发布节奏
+        publishPacer.config(keyValue, cnt);
+        // 设置模拟输入DMA采样率
+        analogSampler.config(keyValue, cnt);
         char *ssid = get_value_case_insensitive(keyValue, cnt, "WiFi_Name");
         char *passwd = get_value_case_insensitive(keyValue, cnt, "WiFi_Password");
         if (ssid != NULL && passwd != NULL) {
@@ -244,6 +447,110 @@ void display_task(void *args) {
   }
 }
 
+static char fxDevices[IO_PORT_NUM][FX_SOURCE_LEN]; // sensor效果最近读取的设备（每个灯带一个）
+static uint32_t fxDeviceAt[IO_PORT_NUM];            // 对应设备最近被读取的时刻
+static portMUX_TYPE fxDeviceMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 记录sensor效果正在使用的设备，按需采集时该设备照常采集
+ */
+static void fxUseDevice(const char *device) {
+  uint32_t now = millis();
+  int slot = 0;
+  portENTER_CRITICAL(&fxDeviceMux);
+  for (int i = 0; i < IO_PORT_NUM; i++) {
+    if (strcasecmp(fxDevices[i], device) == 0) {
+      slot = i;
+      break;
+    }
+    // 否则替换最久未使用的记录
+    if (now - fxDeviceAt[i] > now - fxDeviceAt[slot]) {
+      slot = i;
+    }
+  }
+  strncpy(fxDevices[slot], device, FX_SOURCE_LEN - 1);
+  fxDevices[slot][FX_SOURCE_LEN - 1] = '\0';
+  fxDeviceAt[slot] = now;
+  portEXIT_CRITICAL(&fxDeviceMux);
+}
+
+/**
+ * @brief 设备最近FX_SOURCE_HOLD_MS内是否被sensor效果读取过
+ */
+static bool fxUsesDevice(const char *device) {
+  uint32_t now = millis();
+  bool used = false;
+  portENTER_CRITICAL(&fxDeviceMux);
+  for (int i = 0; i < IO_PORT_NUM && !used; i++) {
+    used = fxDevices[i][0] != '\0' && now - fxDeviceAt[i] < FX_SOURCE_HOLD_MS && strcasecmp(fxDevices[i], device) == 0;
+  }
+  portEXIT_CRITICAL(&fxDeviceMux);
+  return used;
+}
+
+/**
+ * @brief 灯带sensor效果的数据源：在对应设备的最新采样中查找字段值
+ *
+ * @param source "<设备>.<字段>"，设备为主题名（如 "bme280"、"p1"），不区分大小写；
+ *               字段可为嵌套路径（如 "acc.x"），也可省略设备名前缀（"p1.input_val" 即 "p1_input_val"）
+ * @param value 输出：字段值
+ * @details 只在指定设备的数据中查找，不同设备的同名字段（如 "Temperature"）互不混淆
+ */
+static bool fxSensorValue(const char *source, float *value) {
+  const char *dot = strchr(source, '.');
+  if (dot == NULL || dot == source || dot - source >= FX_SOURCE_LEN) {
+    return false;
+  }
+  char device[FX_SOURCE_LEN];
+  memcpy(device, source, dot - source);
+  device[dot - source] = '\0';
+  fxUseDevice(device);
+
+  String json;
+  bool found = false;
+  if (xSemaphoreTake(JsonDataMutex, pdMS_TO_TICKS(5))) {
+    for (const auto &sample : DeviceSensorData) {
+      if (sample.name.equalsIgnoreCase(device)) {
+        json = "{" + sample.json + "}";
+        found = true;
+        break;
+      }
+    }
+    xSemaphoreGive(JsonDataMutex);
+  }
+  JsonDocument doc;
+  if (!found || deserializeJson(doc, json)) {
+    return false;
+  }
+
+  // 逐级按"."查找嵌套字段
+  JsonVariantConst v = doc.as<JsonVariantConst>();
+  char path[FX_SOURCE_LEN];
+  strncpy(path, dot + 1, sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+  bool first = true;
+  for (char *seg = strtok(path, "."); seg != NULL; seg = strtok(NULL, ".")) {
+    JsonVariantConst next = v[seg];
+    if (next.isNull() && first) {
+      char prefixed[FX_SOURCE_LEN * 2];
+      snprintf(prefixed, sizeof(prefixed), "%s_%s", device, seg);
+      next = v[(const char *)prefixed];
+    }
+    v = next;
+    first = false;
+  }
+  if (!v.is<float>()) {
+    return false;
+  }
+  *value = v.as<float>();
+  return true;
+}
+
+/**
+ * @brief I2C设备是否有订阅者或被灯带sensor效果使用（按需采集）
+ */
+static bool i2cDemanded(const char *topicName) { return fxUsesDevice(topicName) || topicRouter.demanded(topicName); }
+
 /**
  * @brief 传感器中枢任务（数据采集与JSON生成）
  *
@@ -255,8 +562,11 @@ void SensorHub_Task(void *arg) {
   vTaskDelay(pdMS_TO_TICKS(2345));
   Wire1.setPins(1, 2);
   Wire1.begin();
+  i2cDeviceManager.setDemand(i2cDemanded);
+  LedEffect::setSource(fxSensorValue);
   const TickType_t xMinInterval = pdMS_TO_TICKS(20);
   TickType_t xLastWakeTime = xTaskGetTickCount();
+  uint32_t frameSeq = 0; // 整帧序号，批量上报去重用
 
   while (1) {
     TickType_t xStartTime = xTaskGetTickCount();
@@ -265,6 +575,7 @@ void SensorHub_Task(void *arg) {
     // 处理IO传感器数据
     // ioSensorHub.process();
     smartIOManager.process();
+    int64_t frameUs = TimeSync::monotonicUs();
     String resStr = i2cDeviceManager.JsonStr + smartIOManager.JsonStr;
     if (resStr.startsWith(",")) {
       resStr.remove(0);
@@ -281,11 +592,33 @@ void SensorHub_Task(void *arg) {
     vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
     if (xSemaphoreTake(JsonDataMutex, portMAX_DELAY)) {
       JsonSensorData = resStr;
+      JsonSensorTime = frameUs;
+      // 按设备发布或灯带sensor效果需要按设备的数据
+      if (topicRouter.perDevice() || LedEffect::sourceActive(millis())) {
+        DeviceSensorData = i2cDeviceManager.samples;
+        DeviceSensorData.insert(DeviceSensorData.end(), smartIOManager.samples.begin(), smartIOManager.samples.end());
+      }
       xSemaphoreGive(JsonDataMutex);
     }
     // 4. 恢复原始优先级
     vTaskPrioritySet(NULL, original_priority);
 
+    // 5. 批量上报：每次采样都在采集侧入批，采样快于发布时也不丢样本
+    if (sampleBatcher.active()) {
+      // 时间戳取各设备读取完成的时刻，批次内以t0加dt表示
+      if (topicRouter.aggregate() && sampleBatcher.batched(BATCH_AGGREGATE)) {
+        sampleBatcher.add(BATCH_AGGREGATE, resStr, ++frameSeq, timeSync.stampMs(frameUs));
+      }
+      if (topicRouter.perDevice()) {
+        for (const auto &s : i2cDeviceManager.samples) {
+          sampleBatcher.add(s.name.c_str(), "{" + s.json + "}", s.seq, timeSync.stampMs(s.monoUs));
+        }
+        for (const auto &s : smartIOManager.samples) {
+          sampleBatcher.add(s.name.c_str(), "{" + s.json + "}", s.seq, timeSync.stampMs(s.monoUs));
+        }
+      }
+    }
+
     // 计算实际耗时
     TickType_t xExecutionTime = xTaskGetTickCount() - xStartTime;
 
@@ -354,14 +687,15 @@ void MQTT_ServerTask(void *arg) {
  * @brief MQTT消息处理任务
  *
  * @param pvParameters NULL
- * @details 阻塞式接收MQTT消息队列，调用传感器中枢处理指令
+ * @details 阻塞式接收MQTT指令信箱，直接在信箱内解析指令，处理完再释放
  */
 void mqttHandlerTask(void *pvParameters) {
-  MQTTMessage msg;
+  mqtt_sub_msg_t msg;
   for (;;) {
-    if (xQueueReceive(mqttSubQueue, &msg, portMAX_DELAY)) {
-      // ioSensorHub.handleMQTTMessage(msg.message);
-      smartIOManager.handleMQTTMessage(msg.message);
+    if (mqtt_sub_mailbox_take(&msg, portMAX_DELAY)) {
+      // ioSensorHub.handleMQTTMessage(msg.payload);
+      smartIOManager.handleMQTTMessage(msg.topic, msg.payload, msg.len);
+      mqtt_sub_mailbox_release();
     }
   }
 }
@@ -437,6 +771,52 @@ bool setUpdateInterval() {
   return false;
 }
 
+/**
+ * @brief 设置Broker单客户端发布限速（从配置中读取）
+ *
+ * @details Rate_Limit_Msgs为每秒发布条数，Rate_Limit_Bytes为每秒发布字节数，
+ *          允许带"/s"后缀，0表示不限速，未配置时使用默认值
+ */
+void setBrokerRateLimit() {
+  const char *keys[] = {"Rate_Limit_Msgs", "Rate_Limit_Bytes"};
+  uint32_t limits[] = {MQTT_SERVER_RATE_MSGS_DEFAULT, MQTT_SERVER_RATE_BYTES_DEFAULT};
+  for (int i = 0; i < 2; i++) {
+    char *res = get_value_case_insensitive(keyValue, MAX_ENTRIES, keys[i]);
+    if (res != NULL) {
+      char *end = NULL;
+      long val = strtol(res, &end, 10);
+      // 仅接受非负整数，可带"/s"后缀
+      if (end != res && val >= 0 && (*end == '\0' || strcasecmp(end, "/s") == 0)) {
+        limits[i] = (uint32_t)val;
+      } else {
+        printf("[Info]%s invalid, defaultVal %u\n", keys[i], limits[i]);
+      }
+    }
+  }
+  mqtt_server_set_rate_limit(limits[0], limits[1]);
+}
+
+/**
+ * @brief 设置上游桥接（从配置中读取）
+ *
+ * @details Bridge_URL为上游Broker地址，未配置则不启用桥接；
+ *          Bridge_Out为转发到上游的本地主题，Bridge_In为从上游订阅的主题，均以逗号分隔；
+ *          Bridge_Rate为断线恢复后补发缓存消息的速率（条/秒）
+ */
+void setBridgeConfig() {
+  const char *url = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_URL");
+  const char *out = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_Out");
+  const char *in = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_In");
+  const char *user = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_User");
+  const char *pass = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_Password");
+  const char *rate = get_value_case_insensitive(keyValue, MAX_ENTRIES, "Bridge_Rate");
+  uint32_t rateVal = MQTT_BRIDGE_RATE_DEFAULT;
+  if (rate != NULL) {
+    rateVal = (uint32_t)strtoul(rate, NULL, 10);
+  }
+  mqtt_bridge_config(url, out != NULL ? out : "topic_input", in != NULL ? in : "topic_output", user, pass, rateVal);
+}
+
 /**
  * @brief I2C设备扫描任务
  *
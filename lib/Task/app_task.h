@@ -107,6 +107,20 @@ void mqttHandlerTask(void *pvParameters);
  */
 bool setUpdateInterval();
 
+/**
+ * @brief 设置Broker限速函数
+ * 
+ * @details 从配置文件读取单客户端每秒发布条数/字节数上限并应用到Broker。
+ */
+void setBrokerRateLimit();
+
+/**
+ * @brief 设置上游桥接函数
+ * 
+ * @details 从配置文件读取上游Broker地址及转发主题，未配置地址时不启动桥接。
+ */
+void setBridgeConfig();
+
 /**
  * @brief 按钮轮询任务
  * 
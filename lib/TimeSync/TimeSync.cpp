@@ -0,0 +1,145 @@
+/**
+ * @file    TimeSync.cpp
+ * @brief   SNTP时间同步与采样时间戳模块实现
+ */
+#include "TimeSync.h"
+#include <WiFi.h>
+#include "mongoose.h"
+
+TimeSync timeSync;
+
+TimeSync::TimeSync()
+    : syncCount(0), lastErrorMs(0), driftPpm(0.0f), _synced(false), _baseMono(0), _baseUtc(0),
+      _intervalMs(TIME_SYNC_INTERVAL_DEFAULT_S * 1000) {
+  strncpy(_server, TIME_SYNC_SERVER_DEFAULT, sizeof(_server) - 1);
+  _server[sizeof(_server) - 1] = '\0';
+  _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+/**
+ * @brief 从配置键值对读取SNTP服务器及同步周期
+ */
+void TimeSync::config(KeyValue *kv_pairs, int count) {
+  const char *server = get_value_case_insensitive(kv_pairs, count, "NTP_Server");
+  if (server != NULL) {
+    // 只写主机名时补全协议和端口
+    if (strstr(server, "://") == NULL) {
+      snprintf(_server, sizeof(_server), "udp://%s:123", server);
+    } else {
+      strncpy(_server, server, sizeof(_server) - 1);
+      _server[sizeof(_server) - 1] = '\0';
+    }
+  }
+  const char *interval = get_value_case_insensitive(kv_pairs, count, "NTP_Interval");
+  _intervalMs = TIME_SYNC_INTERVAL_DEFAULT_S * 1000;
+  if (interval != NULL && atoi(interval) >= 60) {
+    _intervalMs = (uint32_t)atoi(interval) * 1000;
+  }
+  printf("[Info]NTP: %s every %u s\n", _server, (unsigned)(_intervalMs / 1000));
+}
+
+uint64_t TimeSync::utcMs(int64_t monoUs) {
+  portENTER_CRITICAL(&_mux);
+  bool synced = _synced;
+  int64_t baseMono = _baseMono;
+  uint64_t baseUtc = _baseUtc;
+  float ppm = driftPpm;
+  portEXIT_CRITICAL(&_mux);
+  if (!synced) {
+    return 0;
+  }
+  int64_t elapsed = monoUs - baseMono;
+  elapsed += (int64_t)((double)elapsed * ppm * 1e-6);
+  return baseUtc + elapsed / 1000;
+}
+
+uint64_t TimeSync::stampMs(int64_t monoUs) {
+  uint64_t utc = utcMs(monoUs);
+  return utc != 0 ? utc : (uint64_t)(monoUs / 1000);
+}
+
+/**
+ * @brief 记录一次SNTP应答
+ *
+ * @details 与上一次同步点比较得到本段的实测漂移，超过TIME_SYNC_MAX_PPM的视为异常应答不采用；
+ *          漂移估计按1/2系数低通滤波。之后以本次应答为新的基准点。
+ */
+void TimeSync::onTime(uint64_t utc, int64_t monoUs) {
+  if (_synced) {
+    int64_t span = monoUs - _baseMono;
+    lastErrorMs = (int32_t)((int64_t)utc - (int64_t)utcMs(monoUs));
+    if (span >= TIME_SYNC_MIN_SPAN_US) {
+      double measured = ((double)((int64_t)utc - (int64_t)_baseUtc) * 1000.0 / (double)span - 1.0) * 1e6;
+      if (measured > -TIME_SYNC_MAX_PPM && measured < TIME_SYNC_MAX_PPM) {
+        float ppm = syncCount > 1 ? driftPpm + 0.5f * ((float)measured - driftPpm) : (float)measured;
+        portENTER_CRITICAL(&_mux);
+        driftPpm = ppm;
+        portEXIT_CRITICAL(&_mux);
+      } else {
+        printf("[Info]NTP: drift %.1f ppm rejected\n", measured);
+      }
+    }
+  }
+  portENTER_CRITICAL(&_mux);
+  _baseMono = monoUs;
+  _baseUtc = utc;
+  _synced = true;
+  portEXIT_CRITICAL(&_mux);
+  syncCount++;
+  printf("[Info]NTP: synced #%u, error %d ms, drift %.1f ppm\n", (unsigned)syncCount, (int)lastErrorMs, driftPpm);
+}
+
+static void sntpFn(struct mg_connection *c, int ev, void *ev_data, void *fn_data) {
+  if (ev == MG_EV_SNTP_TIME) {
+    // mongoose已按往返时延修正，此刻的单调时钟即对应该时间
+    int64_t mono = esp_timer_get_time();
+    ((TimeSync *)fn_data)->onTime(*(uint64_t *)ev_data, mono);
+    c->is_closing = 1;
+  } else if (ev == MG_EV_ERROR) {
+    printf("[Info]NTP: %s\n", (char *)ev_data);
+  }
+}
+
+/**
+ * @brief SNTP同步任务
+ *
+ * @details 使用独立的mongoose事件管理器，WiFi连接后按周期发起请求。
+ *          有连接时阻塞在mg_mgr_poll中等待应答，应答到达即处理，避免轮询间隔引入误差。
+ *          同一时刻只保留一个请求：应答丢失时连接在TIME_SYNC_TIMEOUT_MS后关闭，
+ *          并按重试周期再次请求，避免每次丢包泄漏一个UDP连接。
+ */
+void TimeSync::_task(void *arg) {
+  TimeSync *self = (TimeSync *)arg;
+  struct mg_mgr mgr;
+  mg_mgr_init(&mgr);
+  uint32_t nextAt = millis();
+  struct mg_connection *pending = NULL; // 等待应答的请求
+  uint32_t sentAt = 0;
+  while (1) {
+    if (pending == NULL && WiFi.isConnected() && (int32_t)(millis() - nextAt) >= 0) {
+      pending = mg_sntp_connect(&mgr, self->_server, sntpFn, self);
+      sentAt = millis();
+      nextAt = sentAt + (self->_synced ? self->_intervalMs : TIME_SYNC_RETRY_MS);
+    }
+    mg_mgr_poll(&mgr, 50);
+    if (pending != NULL) {
+      // 应答到达或出错后连接已被mongoose释放
+      bool open = false;
+      for (struct mg_connection *c = mgr.conns; c != NULL && !open; c = c->next) {
+        open = (c == pending);
+      }
+      if (!open) {
+        pending = NULL;
+      } else if (millis() - sentAt >= TIME_SYNC_TIMEOUT_MS && !pending->is_closing) {
+        printf("[Info]NTP: no reply in %u ms\n", (unsigned)TIME_SYNC_TIMEOUT_MS);
+        pending->is_closing = 1;
+        nextAt = millis() + TIME_SYNC_RETRY_MS;
+      }
+    }
+    if (mgr.conns == NULL) {
+      vTaskDelay(pdMS_TO_TICKS(200));
+    }
+  }
+}
+
+void TimeSync::begin() { xTaskCreate(_task, "sntp", 4096, this, 2, NULL); }
@@ -0,0 +1,83 @@
+/**
+ * @file    TimeSync.h
+ * @brief   SNTP时间同步与采样时间戳模块头文件
+ *
+ * @details 采样时记录单调时钟esp_timer_get_time()（微秒），发布时换算为UTC毫秒：
+ *          utc = 基准UTC + (mono - 基准mono) * (1 + 漂移)
+ *          每次SNTP应答得到一组 (mono, UTC) 对应点，相邻两点估算本地晶振漂移（ppm），
+ *          低通滤波后用于两次同步之间的外推，同步间隔内的误差远小于直接用millis()。
+ *          同步由独立任务使用mongoose自带的SNTP客户端完成。
+ *          配置项（config.txt）：
+ *          - NTP_Server: SNTP服务器，默认 "udp://pool.ntp.org:123"
+ *          - NTP_Interval: 同步周期（秒），默认900；未同步时每10秒重试
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "esp_timer.h"
+
+#define TIME_SYNC_SERVER_DEFAULT "udp://pool.ntp.org:123" ///< 默认SNTP服务器
+#define TIME_SYNC_INTERVAL_DEFAULT_S 900                   ///< 默认同步周期（秒）
+#define TIME_SYNC_RETRY_MS 10000                           ///< 未同步时的重试周期（毫秒）
+#define TIME_SYNC_TIMEOUT_MS 5000                          ///< 等待应答的超时（毫秒），超时关闭连接
+#define TIME_SYNC_MAX_PPM 500.0f                           ///< 漂移估计上限，超出视为异常应答
+#define TIME_SYNC_MIN_SPAN_US 60000000LL                   ///< 估算漂移所需的最短同步间隔（微秒）
+
+class TimeSync {
+public:
+    TimeSync();
+
+    /**
+     * @brief 从配置键值对读取SNTP服务器及同步周期
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     */
+    void config(KeyValue *kv_pairs, int count);
+
+    /**
+     * @brief 启动同步任务
+     */
+    void begin();
+
+    /** @brief 单调时钟（微秒），用于记录采样时刻 */
+    static int64_t monotonicUs() { return esp_timer_get_time(); }
+
+    /** @brief 是否已完成至少一次同步 */
+    bool synced() const { return _synced; }
+
+    /**
+     * @brief 单调时钟换算为UTC
+     * @param monoUs 采样时刻的单调时钟（微秒）
+     * @return uint64_t 自1970年起的毫秒数，未同步时返回0
+     */
+    uint64_t utcMs(int64_t monoUs);
+
+    /**
+     * @brief 采样时间戳：已同步时为UTC毫秒，否则为开机后的毫秒数
+     * @param monoUs 采样时刻的单调时钟（微秒）
+     */
+    uint64_t stampMs(int64_t monoUs);
+
+    /**
+     * @brief 记录一次SNTP应答
+     * @param utc 服务器时间（毫秒，已按往返时延修正）
+     * @param monoUs 收到应答时的单调时钟（微秒）
+     */
+    void onTime(uint64_t utc, int64_t monoUs);
+
+    uint32_t syncCount;   ///< 成功同步次数
+    int32_t lastErrorMs;  ///< 最近一次同步时外推值与服务器时间之差
+    float driftPpm;       ///< 当前漂移估计（正值表示本地时钟偏慢）
+
+private:
+    bool _synced;
+    int64_t _baseMono;
+    uint64_t _baseUtc;
+    char _server[MAX_VALUE_LEN];
+    uint32_t _intervalMs;
+    portMUX_TYPE _mux;
+
+    static void _task(void *arg);
+};
+
+extern TimeSync timeSync;
@@ -0,0 +1,243 @@
+/**
+ * @file    TopicRouter.cpp
+ * @brief   按设备/字段拆分发布主题模块实现
+ */
+#include "TopicRouter.h"
+#include "mqtt_server.h"
+#include "mqtt_publisher.h"
+#include "TimeSync.h"
+
+TopicRouter::TopicRouter() : _aggregate(true), _device(false), _field(false), _lazy(true) {
+  _prefix[0] = '\0';
+  _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief 从配置键值对读取主题模式及前缀
+ */
+void TopicRouter::config(KeyValue *kv_pairs, int count, uint32_t chipId) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _aggregate = true;
+  _device = false;
+  _field = false;
+
+  const char *mode = get_value_case_insensitive(kv_pairs, count, "Topic_Mode");
+  if (mode != NULL) {
+    char buffer[MAX_VALUE_LEN];
+    strncpy(buffer, mode, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    _aggregate = false;
+    for (char *tok = strtok(buffer, ","); tok != NULL; tok = strtok(NULL, ",")) {
+      tok = trim(tok);
+      if (strcasecmp(tok, "aggregate") == 0) {
+        _aggregate = true;
+      } else if (strcasecmp(tok, "device") == 0) {
+        _device = true;
+      } else if (strcasecmp(tok, "field") == 0) {
+        _field = true;
+      } else {
+        printf("[Info]Topic_Mode unknown: %s\n", tok);
+      }
+    }
+    // 无有效模式时退回整帧上报，避免数据完全不发布
+    if (!_aggregate && !_device && !_field) {
+      _aggregate = true;
+    }
+  }
+
+  const char *prefix = get_value_case_insensitive(kv_pairs, count, "Topic_Prefix");
+  if (prefix != NULL) {
+    strncpy(_prefix, prefix, sizeof(_prefix) - 1);
+    _prefix[sizeof(_prefix) - 1] = '\0';
+    // 去掉末尾的"/"
+    size_t len = strlen(_prefix);
+    while (len > 0 && _prefix[len - 1] == '/') {
+      _prefix[--len] = '\0';
+    }
+  } else {
+    snprintf(_prefix, sizeof(_prefix), "dfr1234/%u", (unsigned)chipId);
+  }
+
+  const char *poll = get_value_case_insensitive(kv_pairs, count, "Poll_Mode");
+  _lazy = (poll == NULL || strcasecmp(poll, "all") != 0);
+  _pollAlways.clear();
+  const char *always = get_value_case_insensitive(kv_pairs, count, "Poll_Always");
+  if (always != NULL) {
+    char buffer[MAX_VALUE_LEN];
+    strncpy(buffer, always, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    for (char *tok = strtok(buffer, ","); tok != NULL; tok = strtok(NULL, ",")) {
+      tok = trim(tok);
+      if (*tok) {
+        _pollAlways.push_back(String(tok));
+      }
+    }
+  }
+
+  _lastSeq.clear();
+  _filter.config(kv_pairs, count);
+  xSemaphoreGive(_mutex);
+  printf("[Info]Topic_Mode:%s%s%s, prefix %s, poll %s\n", _aggregate ? " aggregate" : "", _device ? " device" : "",
+         _field ? " field" : "", _prefix, _lazy ? "on demand" : "all");
+}
+
+/**
+ * @brief 设备数据是否有人使用
+ *
+ * @details 向Broker的订阅表查询，通配符订阅（如 "dfr1234/+/bme280/#"、"#"）同样计入
+ */
+bool TopicRouter::demanded(const char *device) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ret = !_lazy;
+  for (size_t i = 0; !ret && i < _pollAlways.size(); i++) {
+    ret = _pollAlways[i].equalsIgnoreCase(device);
+  }
+  if (!ret && _aggregate) {
+    ret = mqtt_server_has_subscriber(MQTT_PUB_TOPIC);
+  }
+  if (!ret && (_device || _field)) {
+    char topic[TOPIC_PREFIX_LEN + 32];
+    snprintf(topic, sizeof(topic), "%s/%s/#", _prefix, device);
+    ret = mqtt_server_has_subscriber(topic);
+  }
+  xSemaphoreGive(_mutex);
+  return ret;
+}
+
+/**
+ * @brief 按字段发布设备数据
+ *
+ * @param base 设备主题，如 "dfr1234/123/bme280"
+ * @param device 设备名，字段名带有"<设备名>_"前缀时去掉前缀
+ * @param obj 设备数据对象，嵌套对象展开为下一级主题
+ * @details 字段主题统一为小写；JSON格式下字符串值不带引号直接发布，
+ *          二进制格式下每个值单独编码
+ */
+void TopicRouter::_sendFields(const String &base, const char *device, JsonObjectConst obj, PayloadCodec &codec,
+                              TopicSendFn send) {
+  size_t devLen = strlen(device);
+  for (JsonPairConst kv : obj) {
+    const char *key = kv.key().c_str();
+    if (strncasecmp(key, device, devLen) == 0 && key[devLen] == '_' && key[devLen + 1] != '\0') {
+      key += devLen + 1;
+    }
+    String field = key;
+    field.toLowerCase();
+    String topic = base + "/" + field;
+
+    JsonVariantConst v = kv.value();
+    if (v.is<JsonObjectConst>()) {
+      _sendFields(topic, "", v.as<JsonObjectConst>(), codec, send);
+    } else if (codec.binary()) {
+      size_t len = codec.encodeValue(v, _buf, sizeof(_buf));
+      if (len > 0) {
+        send(topic.c_str(), (const char *)_buf, len);
+      }
+    } else if (v.is<const char *>()) {
+      const char *str = v.as<const char *>();
+      send(topic.c_str(), str, strlen(str));
+    } else {
+      String payload;
+      serializeJson(v, payload);
+      send(topic.c_str(), payload.c_str(), payload.length());
+    }
+  }
+}
+
+/**
+ * @brief 按设备/字段发布一轮采样数据
+ *
+ * @details 1. 启用变化上报时把所有设备组成 {"设备":{...}} 交给过滤器，只发布变化的字段；
+ *             否则只发布采样序号有更新的设备
+ *          2. 按设备发布整个设备对象，按字段发布每个字段的值；
+ *             启用批量上报的设备由SampleBatcher发布，此处只发布其低延迟字段；
+ *             按设备发布的消息附带时间戳"ts"，按字段发布的消息为裸值，不带时间戳
+ *          3. 逐个设备查询订阅者：按设备发布查 <前缀>/<设备>，按字段发布查 <前缀>/<设备>/#，
+ *             都没有订阅者的设备不参与过滤和编码
+ */
+void TopicRouter::route(const std::vector<DeviceSample> &samples, uint32_t nowMs, PayloadCodec &codec,
+                        SampleBatcher &batcher, PublishPacer &pacer, TopicSendFn send) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool filtered = _filter.enabled();
+  String frame = "{";
+  bool any = false;
+  // 各设备需要发布的模式：bit0按设备，bit1按字段
+  std::vector<uint8_t> modes(samples.size(), 0);
+  for (size_t i = 0; i < samples.size(); i++) {
+    const auto &sample = samples[i];
+    char topic[TOPIC_PREFIX_LEN + 32];
+    if (_device) {
+      snprintf(topic, sizeof(topic), "%s/%s", _prefix, sample.name.c_str());
+      modes[i] |= pacer.wanted(topic) ? 1 : 0;
+    }
+    if (_field) {
+      snprintf(topic, sizeof(topic), "%s/%s/#", _prefix, sample.name.c_str());
+      modes[i] |= pacer.wanted(topic) ? 2 : 0;
+    }
+    if (modes[i] == 0) {
+      continue;
+    }
+    auto it = _lastSeq.find(sample.name);
+    bool fresh = (it == _lastSeq.end() || it->second != sample.seq);
+    if (!fresh && !filtered) {
+      continue;
+    }
+    _lastSeq[sample.name] = sample.seq;
+    if (any) {
+      frame += ",";
+    }
+    frame += "\"" + sample.name + "\":{" + sample.json + "}";
+    any = true;
+  }
+  frame += "}";
+
+  if (any && filtered) {
+    String changed;
+    any = _filter.filter(frame, changed, nowMs);
+    frame = changed;
+  }
+
+  JsonDocument doc;
+  if (!any || deserializeJson(doc, frame)) {
+    xSemaphoreGive(_mutex);
+    return;
+  }
+
+  for (JsonPair dev : doc.as<JsonObject>()) {
+    const char *name = dev.key().c_str();
+    // 已批量上报的设备只即时发布低延迟字段
+    if (batcher.batched(name) && !batcher.keepImmediate(dev.value().as<JsonObject>())) {
+      continue;
+    }
+    size_t idx = 0;
+    while (idx < samples.size() && samples[idx].name != name) {
+      idx++;
+    }
+    if (idx == samples.size()) {
+      continue;
+    }
+    String base = String(_prefix) + "/" + name;
+    if (modes[idx] & 1) {
+      // 设备消息带读取完成时刻（UTC毫秒），未校时不带
+      JsonObject obj = dev.value().as<JsonObject>();
+      if (timeSync.synced()) {
+        obj["ts"] = timeSync.utcMs(samples[idx].monoUs);
+      }
+      if (codec.binary()) {
+        size_t len = codec.encode(dev.value().as<JsonObjectConst>(), _buf, sizeof(_buf));
+        if (len > 0) {
+          send(base.c_str(), (const char *)_buf, len);
+        }
+      } else {
+        String payload;
+        serializeJson(dev.value(), payload);
+        send(base.c_str(), payload.c_str(), payload.length());
+      }
+      obj.remove("ts");
+    }
+    if (modes[idx] & 2) {
+      _sendFields(base, name, dev.value().as<JsonObjectConst>(), codec, send);
+    }
+  }
+  xSemaphoreGive(_mutex);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file    TopicRouter.h
+ * @brief   按设备/字段拆分发布主题模块头文件
+ *
+ * @details 把传感器数据按设备发布到 <前缀>/<设备>，或按字段发布到 <前缀>/<设备>/<字段>，
+ *          订阅者可用通配符只订阅需要的数据，如 "dfr1234/+/bme280/#"。
+ *          配置项（config.txt）：
+ *          - Topic_Mode: aggregate | device | field，可用逗号组合，默认aggregate（原topic_input整帧）
+ *          - Topic_Prefix: 主题前缀，默认 "dfr1234/<chipId>"
+ *          - Poll_Mode: demand | all，默认demand，只采集有订阅者的设备
+ *          - Poll_Always: 逗号分隔的设备名，无订阅者时也始终采集（如需本地记录的设备）
+ *          未启用变化上报时，设备只在产生新数据后发布，发布频率跟随设备自身的更新节奏。
+ */
+#pragma once
+#include "global.h"
+#include "ConfigParser.h"
+#include "ArduinoJson.h"
+#include "ReportFilter.h"
+#include "PayloadCodec.h"
+#include "SampleBatcher.h"
+#include "PublishPacer.h"
+
+#define TOPIC_PREFIX_LEN 48 ///< 主题前缀最大长度
+
+/**
+ * @brief 消息发送函数
+ *
+ * @param topic 发布主题，NULL表示默认主题（topic_input）
+ * @param payload 消息内容（JSON文本或二进制编码）
+ * @param len 消息长度
+ */
+typedef void (*TopicSendFn)(const char *topic, const char *payload, size_t len);
+
+class TopicRouter {
+public:
+    TopicRouter();
+
+    /**
+     * @brief 从配置键值对读取主题模式及前缀
+     * @param kv_pairs 配置键值对数组
+     * @param count 键值对数量
+     * @param chipId 芯片ID，用于默认主题前缀
+     * @details 按设备发布使用独立的变化上报过滤器，规则与整帧上报相同
+     */
+    void config(KeyValue *kv_pairs, int count, uint32_t chipId);
+
+    /** @brief 是否发布整帧数据到默认主题 */
+    bool aggregate() const { return _aggregate; }
+
+    /** @brief 是否按设备或字段发布 */
+    bool perDevice() const { return _device || _field; }
+
+    /** @brief 主题前缀，如 "dfr1234/123" */
+    const char *prefix() const { return _prefix; }
+
+    /**
+     * @brief 设备数据是否有人使用
+     * @param device 设备主题名，如 "bme280"
+     * @return true 需要采集：整帧主题或该设备主题（含通配符订阅）有订阅者，
+     *         或设备在Poll_Always中，或Poll_Mode为all
+     */
+    bool demanded(const char *device);
+
+    /**
+     * @brief 按设备/字段发布一轮采样数据
+     * @param samples 所有设备的采样数据
+     * @param nowMs 当前时间（毫秒）
+     * @param codec 负载编码器，二进制格式时按字段ID编码
+     * @param batcher 批量上报器，启用批量的设备此处只发布低延迟字段
+     * @param pacer 发布节奏控制，逐个设备主题查询订阅者，无订阅者的设备不编码并计入跳过次数
+     * @param send 消息发送函数
+     */
+    void route(const std::vector<DeviceSample> &samples, uint32_t nowMs, PayloadCodec &codec, SampleBatcher &batcher,
+               PublishPacer &pacer, TopicSendFn send);
+
+private:
+    bool _aggregate;
+    bool _device;
+    bool _field;
+    char _prefix[TOPIC_PREFIX_LEN];
+    bool _lazy;                            ///< 按需采集
+    std::vector<String> _pollAlways;       ///< 始终采集的设备
+    ReportFilter _filter;                  ///< 按设备发布使用的变化上报过滤器
+    std::map<String, uint32_t> _lastSeq;   ///< 各设备上次发布的采样序号
+    SemaphoreHandle_t _mutex;
+    uint8_t _buf[PAYLOAD_FRAME_MAX];       ///< 二进制编码输出缓冲区
+
+    void _sendFields(const String &base, const char *device, JsonObjectConst obj, PayloadCodec &codec,
+                     TopicSendFn send);
+};
@@ -75,5 +75,20 @@
 
 const uint8_t pin_map[IO_PORT_NUM] = {IO1_PORT, IO2_PORT, IO3_PORT, IO4_PORT, IO5_PORT, IO6_PORT};
 
+/**
+ * @brief 单个设备的采样数据
+ *
+ * @details 按设备发布主题时使用，name为主题层级中的设备名（如"bme280"、"p1"），
+ *          json为不含花括号的JSON字段片段，seq在设备产生新数据时递增，
+ *          monoUs为读取完成时的单调时钟（esp_timer，微秒），发布时换算为UTC。
+ */
+struct DeviceSample
+{
+    String name;
+    String json;
+    uint32_t seq;
+    int64_t monoUs;
+};
+
 
 #endif
@@ -3234,6 +3234,7 @@ static void mqtt_cb(struct mg_connection *c, int ev, void *ev_data,
                     void *fn_data) {
   if (ev == MG_EV_READ) {
     for (;;) {
+      if (c->is_full) break;  // Reads paused, keep the rest buffered
       uint8_t version = c->is_mqtt5 ? 5 : 4;
       struct mg_mqtt_message mm;
       int rc = mg_mqtt_parse(c->recv.buf, c->recv.len, version, &mm);